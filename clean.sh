@@ -5,6 +5,7 @@ rm -f ./Makefile.in
 rm -f ./aclocal.m4
 rm -f ./NEWS
 rm -f ./src/Makefile.in
+rm -f ./tools/harness/Makefile.in
 rm -f ./INSTALL
 rm -f ./missing
 rm -f ./install-sh
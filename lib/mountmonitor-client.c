@@ -0,0 +1,285 @@
+#include "mountmonitor-client.h"
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <gio/gunixfdlist.h>
+#include "sharedtable.h"
+
+#define MOUNT_MONITOR_BUS_NAME "org.freedesktop.MountMonitor"
+#define MOUNT_MONITOR_OBJECT_PATH "/org/freedesktop/MountMonitor"
+#define MOUNT_MONITOR_INTERFACE "org.freedesktop.MountMonitor.Base"
+
+/* Attempts at a consistent copy before the reader yields the CPU, which
+ * lets a writer that was preempted in the middle finish */
+#define SPINS_BEFORE_YIELD 64
+
+static void
+mount_monitor_client_unmap (MountMonitorClient *client)
+{
+    if (client->data == NULL)
+        return;
+
+    munmap ((gpointer) client->data, client->size);
+    client->data = NULL;
+    client->size = 0;
+}
+
+/* Asks the daemon for the current region and maps it */
+static gboolean
+mount_monitor_client_map (MountMonitorClient  *client,
+                          GError             **error)
+{
+    const SharedTableHeader *header;
+    GUnixFDList *fd_list;
+    GVariant *reply;
+    gpointer data;
+    gint32 handle;
+    gsize size;
+    int errsv;
+    int fd;
+
+    reply = g_dbus_connection_call_with_unix_fd_list_sync (client->connection,
+                                                           MOUNT_MONITOR_BUS_NAME,
+                                                           MOUNT_MONITOR_OBJECT_PATH,
+                                                           MOUNT_MONITOR_INTERFACE,
+                                                           "OpenSharedTable",
+                                                           NULL, G_VARIANT_TYPE ("(h)"),
+                                                           G_DBUS_CALL_FLAGS_NONE, -1,
+                                                           NULL, &fd_list, NULL, error);
+    if (reply == NULL)
+        return FALSE;
+
+    g_variant_get (reply, "(h)", &handle);
+    g_variant_unref (reply);
+    fd = g_unix_fd_list_get (fd_list, handle, error);
+    g_object_unref (fd_list);
+    if (fd < 0)
+        return FALSE;
+
+    /* the header tells the size of the whole region */
+    data = mmap (NULL, sizeof (SharedTableHeader), PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+        goto fail;
+    header = data;
+    size = header->size;
+    if (header->magic != SHARED_TABLE_MAGIC || header->version != SHARED_TABLE_VERSION ||
+        size < sizeof *header)
+    {
+        munmap (data, sizeof (SharedTableHeader));
+        close (fd);
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                     "The shared table is not of version %d", SHARED_TABLE_VERSION);
+        return FALSE;
+    }
+    munmap (data, sizeof (SharedTableHeader));
+
+    data = mmap (NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+        goto fail;
+    close (fd);
+
+    mount_monitor_client_unmap (client);
+    client->data = data;
+    client->size = size;
+    return TRUE;
+
+fail:
+    errsv = errno;
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                 "Error mapping the shared table: %s", g_strerror (errsv));
+    close (fd);
+    return FALSE;
+}
+
+/* Maps the daemon's shared table.  connection is the bus the daemon is
+ * on; NULL stands for the session bus.
+ */
+MountMonitorClient *
+mount_monitor_client_new (GDBusConnection  *connection,
+                          GError          **error)
+{
+    MountMonitorClient *client;
+
+    client = g_new0 (MountMonitorClient, 1);
+    if (connection != NULL)
+        client->connection = g_object_ref (connection);
+    else
+        client->connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, error);
+
+    if (client->connection == NULL || !mount_monitor_client_map (client, error))
+    {
+        mount_monitor_client_free (client);
+        return NULL;
+    }
+
+    return client;
+}
+
+void
+mount_monitor_client_free (MountMonitorClient *client)
+{
+    if (client == NULL)
+        return;
+
+    mount_monitor_client_unmap (client);
+    if (client->connection != NULL)
+        g_object_unref (client->connection);
+    g_free (client->mounts);
+    g_free (client->copy);
+    g_free (client);
+}
+
+/* Waits for the daemon to be out of a write and returns the sequence */
+static gint
+read_begin (const SharedTableHeader *header)
+{
+    gint sequence;
+    guint spins;
+
+    for (spins = 1; ; spins++)
+    {
+        sequence = g_atomic_int_get (&header->sequence);
+        if ((sequence & 1) == 0)
+            return sequence;
+        if (spins % SPINS_BEFORE_YIELD == 0)
+            g_thread_yield ();
+    }
+}
+
+/* TRUE if nothing was written since read_begin() returned sequence */
+static gboolean
+read_retry (const SharedTableHeader *header,
+            gint                     sequence)
+{
+    /* the reads of the table stay before the second look at the sequence */
+    __atomic_thread_fence (__ATOMIC_ACQUIRE);
+    return g_atomic_int_get (&header->sequence) != sequence;
+}
+
+/* Follows the daemon to its new region once the current one is full */
+static gboolean
+mount_monitor_client_check_superseded (MountMonitorClient  *client,
+                                       GError             **error)
+{
+    const SharedTableHeader *header = (const SharedTableHeader *) client->data;
+
+    if (!g_atomic_int_get ((gint *) &header->superseded))
+        return TRUE;
+
+    client->have_copy = FALSE;
+    return mount_monitor_client_map (client, error);
+}
+
+/* TRUE if the table was rewritten since the last read, which is cheap
+ * enough to poll; it also is after a change that got no new generation,
+ * such as the device info of a mount being found
+ */
+gboolean
+mount_monitor_client_has_changed (MountMonitorClient *client)
+{
+    const SharedTableHeader *header = (const SharedTableHeader *) client->data;
+
+    return !client->have_copy ||
+           g_atomic_int_get ((gint *) &header->superseded) ||
+           g_atomic_int_get (&header->sequence) != client->sequence;
+}
+
+static const gchar *
+copy_string (MountMonitorClient *client,
+             gsize               strings_offset,
+             guint32             offset)
+{
+    /* the copy ends with a NUL, and offset 0 is the empty string */
+    if (strings_offset + offset >= client->copy_size)
+        return "";
+    return client->copy + strings_offset + offset;
+}
+
+/* Returns a consistent copy of the whole table in *out_mounts, which stays
+ * valid until the next read or mount_monitor_client_free().  If the table
+ * wasn't rewritten since then the previous copy is returned.
+ */
+gboolean
+mount_monitor_client_read (MountMonitorClient             *client,
+                           const MountMonitorClientMount **out_mounts,
+                           guint                          *out_n_mounts,
+                           guint64                        *out_generation,
+                           GError                        **error)
+{
+    const SharedTableHeader *header;
+    const SharedTableMount *stored;
+    SharedTableHeader copy;
+    gsize mounts_len;
+    gsize len;
+    gint sequence;
+    guint n;
+
+    if (!mount_monitor_client_check_superseded (client, error))
+        return FALSE;
+
+    header = (const SharedTableHeader *) client->data;
+    for (;;)
+    {
+        sequence = read_begin (header);
+        if (client->have_copy && sequence == client->sequence)
+            break;
+        memcpy (&copy, header, sizeof copy);
+
+        /* torn values are caught by the retry, but must not send the copy
+         * outside the region first */
+        mounts_len = (gsize) copy.n_mounts * sizeof (SharedTableMount);
+        len = mounts_len + copy.strings_len;
+        if (copy.mounts_offset < sizeof copy ||
+            copy.strings_offset != copy.mounts_offset + mounts_len ||
+            copy.strings_offset + (gsize) copy.strings_len > client->size ||
+            copy.strings_len == 0)
+        {
+            if (read_retry (header, sequence))
+                continue;
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                         "The shared table is corrupt");
+            return FALSE;
+        }
+
+        if (len > client->copy_size)
+            client->copy = g_realloc (client->copy, len);
+        client->copy_size = len;
+        memcpy (client->copy, client->data + copy.mounts_offset, len);
+        if (read_retry (header, sequence))
+            continue;
+
+        client->copy[len - 1] = '\0';
+        client->mounts = g_renew (MountMonitorClientMount, client->mounts, MAX (copy.n_mounts, 1));
+        client->n_mounts = copy.n_mounts;
+        stored = (const SharedTableMount *) client->copy;
+        for (n = 0; n < copy.n_mounts; n++)
+        {
+            MountMonitorClientMount *mount = &client->mounts[n];
+
+            mount->ns_id = stored[n].ns_id;
+            mount->dev = stored[n].dev;
+            mount->mount_id = stored[n].mount_id;
+            mount->parent_id = stored[n].parent_id;
+            mount->is_swap = stored[n].type == SHARED_TABLE_SWAP;
+            mount->path = copy_string (client, mounts_len, stored[n].path);
+            mount->fstype = copy_string (client, mounts_len, stored[n].fstype);
+            mount->source = copy_string (client, mounts_len, stored[n].source);
+            mount->options = copy_string (client, mounts_len, stored[n].options);
+            mount->uuid = copy_string (client, mounts_len, stored[n].uuid);
+            mount->serial = copy_string (client, mounts_len, stored[n].serial);
+            mount->vendor = copy_string (client, mounts_len, stored[n].vendor);
+            mount->model = copy_string (client, mounts_len, stored[n].model);
+        }
+        client->generation = copy.generation;
+        client->sequence = sequence;
+        client->have_copy = TRUE;
+        break;
+    }
+
+    *out_mounts = client->mounts;
+    *out_n_mounts = client->n_mounts;
+    if (out_generation != NULL)
+        *out_generation = client->generation;
+    return TRUE;
+}
@@ -0,0 +1,62 @@
+#ifndef __MOUNT_MONITOR_CLIENT_H__
+#define __MOUNT_MONITOR_CLIENT_H__
+#include <gio/gio.h>
+
+/* One mount of the shared table.  The strings are never NULL and belong
+ * to the client; they stay valid until the next read.
+ */
+typedef struct _MountMonitorClientMount MountMonitorClientMount;
+struct _MountMonitorClientMount
+{
+    guint64 ns_id;
+    guint64 dev;
+    /* 0 for swaps */
+    guint64 mount_id;
+    guint64 parent_id;
+    gboolean is_swap;
+    const gchar *path;
+    const gchar *fstype;
+    const gchar *source;
+    const gchar *options;
+    const gchar *uuid;
+    const gchar *serial;
+    const gchar *vendor;
+    const gchar *model;
+};
+
+/* Reads the mount table the daemon publishes in shared memory.  It is
+ * mapped once, with one OpenSharedTable call; after that reading takes
+ * no system calls and no locks, only a copy, which is skipped when
+ * nothing changed since the last read.  The table's generation is that
+ * of the signals and GetChangesSince.  A client is not thread-safe, use
+ * one per thread.
+ */
+typedef struct _MountMonitorClient MountMonitorClient;
+struct _MountMonitorClient
+{
+    GDBusConnection *connection;
+    const gchar *data;
+    gsize size;
+
+    /* the last consistent copy, the table's sequence and generation when
+     * it was taken, and the mounts in it */
+    gboolean have_copy;
+    gint sequence;
+    guint64 generation;
+    gchar *copy;
+    gsize copy_size;
+    MountMonitorClientMount *mounts;
+    guint n_mounts;
+};
+
+MountMonitorClient            *mount_monitor_client_new            (GDBusConnection     *connection,
+                                                                   GError             **error);
+void                           mount_monitor_client_free           (MountMonitorClient  *client);
+gboolean                       mount_monitor_client_has_changed    (MountMonitorClient  *client);
+gboolean                       mount_monitor_client_read           (MountMonitorClient  *client,
+                                                                   const MountMonitorClientMount **out_mounts,
+                                                                   guint               *out_n_mounts,
+                                                                   guint64             *out_generation,
+                                                                   GError             **error);
+
+#endif
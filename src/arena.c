@@ -0,0 +1,69 @@
+#include "arena.h"
+#include <string.h>
+
+MountArena *
+mount_arena_new (gsize element_size,
+                 guint chunk_elements)
+{
+    MountArena *arena;
+
+    arena = g_new0 (MountArena, 1);
+    /* big enough for the free list link, and keeps every element aligned */
+    arena->element_size = (MAX (element_size, sizeof (gpointer)) + 7) & ~(gsize) 7;
+    arena->chunk_elements = MAX (chunk_elements, 1);
+
+    return arena;
+}
+
+/* Frees every chunk, including the elements still in use */
+void
+mount_arena_free (MountArena *arena)
+{
+    if (arena == NULL)
+        return;
+
+    g_slist_free_full (arena->chunks, g_free);
+    g_free (arena);
+}
+
+gpointer
+mount_arena_alloc0 (MountArena *arena)
+{
+    gpointer mem;
+
+    if (arena->free_list != NULL)
+    {
+        mem = arena->free_list;
+        arena->free_list = *(gpointer *) mem;
+    }
+    else
+    {
+        if (arena->next == arena->end)
+        {
+            gsize size = arena->element_size * arena->chunk_elements;
+
+            arena->next = g_malloc (size);
+            arena->end = arena->next + size;
+            arena->chunks = g_slist_prepend (arena->chunks, arena->next);
+        }
+        mem = arena->next;
+        arena->next += arena->element_size;
+    }
+
+    arena->n_used++;
+    memset (mem, 0, arena->element_size);
+
+    return mem;
+}
+
+void
+mount_arena_release (MountArena *arena,
+                     gpointer    mem)
+{
+    if (mem == NULL)
+        return;
+
+    *(gpointer *) mem = arena->free_list;
+    arena->free_list = mem;
+    arena->n_used--;
+}
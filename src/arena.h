@@ -0,0 +1,33 @@
+#ifndef __MOUNT_ARENA_H__
+#define __MOUNT_ARENA_H__
+#include <glib.h>
+
+/* Fixed-size elements carved out of large chunks, for the many small
+ * records of the mount tables.  Released elements go on a free list and
+ * are handed out again before the arena grows; the chunks themselves are
+ * only given back when the arena is freed.  Not thread-safe.
+ */
+typedef struct _MountArena MountArena;
+struct _MountArena
+{
+    gsize element_size;
+    guint chunk_elements;
+    /* every chunk, newest first */
+    GSList *chunks;
+    /* released elements, linked through their first word */
+    gpointer free_list;
+    /* the part of the newest chunk never handed out */
+    guint8 *next;
+    guint8 *end;
+    /* elements currently handed out */
+    gsize n_used;
+};
+
+MountArena *mount_arena_new     (gsize        element_size,
+                                 guint        chunk_elements);
+void        mount_arena_free    (MountArena  *arena);
+gpointer    mount_arena_alloc0  (MountArena  *arena);
+void        mount_arena_release (MountArena  *arena,
+                                 gpointer     mem);
+
+#endif
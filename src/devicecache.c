@@ -0,0 +1,171 @@
+#include "devicecache.h"
+
+DeviceIdentity *
+device_identity_new (dev_t dev)
+{
+    DeviceIdentity *identity;
+
+    identity = g_slice_new0 (DeviceIdentity);
+    identity->ref_count = 1;
+    identity->dev = dev;
+
+    return identity;
+}
+
+DeviceIdentity *
+device_identity_ref (DeviceIdentity *identity)
+{
+    identity->ref_count++;
+    return identity;
+}
+
+void
+device_identity_unref (DeviceIdentity *identity)
+{
+    if (identity == NULL || --identity->ref_count > 0)
+        return;
+
+    g_free (identity->uuid);
+    g_free (identity->drive_path);
+    g_free (identity->serial);
+    g_free (identity->vendor);
+    g_free (identity->model);
+    g_slice_free (DeviceIdentity, identity);
+}
+
+DeviceCache *
+device_cache_new (guint max_size)
+{
+    DeviceCache *cache;
+
+    cache = g_new0 (DeviceCache, 1);
+    cache->max_size = MAX (max_size, 1);
+    cache->by_dev = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                           NULL, (GDestroyNotify) device_identity_unref);
+    cache->by_uuid = g_hash_table_new (g_str_hash, g_str_equal);
+    g_queue_init (&cache->lru);
+
+    return cache;
+}
+
+void
+device_cache_free (DeviceCache *cache)
+{
+    if (cache == NULL)
+        return;
+
+    device_cache_clear (cache);
+    g_hash_table_unref (cache->by_dev);
+    g_hash_table_unref (cache->by_uuid);
+    g_free (cache);
+}
+
+static void
+device_cache_remove (DeviceCache    *cache,
+                     DeviceIdentity *identity)
+{
+    g_queue_delete_link (&cache->lru, identity->lru_link);
+    identity->lru_link = NULL;
+    /* a newer identity may have taken over the UUID */
+    if (identity->uuid != NULL && g_hash_table_lookup (cache->by_uuid, identity->uuid) == identity)
+        g_hash_table_remove (cache->by_uuid, identity->uuid);
+    g_hash_table_remove (cache->by_dev, &identity->dev);
+}
+
+/* Returns the cached identity of dev, borrowed, or NULL */
+DeviceIdentity *
+device_cache_lookup (DeviceCache *cache,
+                     dev_t        dev)
+{
+    DeviceIdentity *identity;
+    gint64 key = dev;
+
+    identity = g_hash_table_lookup (cache->by_dev, &key);
+    if (identity == NULL)
+        return NULL;
+
+    if (identity->lru_link != cache->lru.head)
+    {
+        g_queue_unlink (&cache->lru, identity->lru_link);
+        g_queue_push_head_link (&cache->lru, identity->lru_link);
+    }
+
+    return identity;
+}
+
+/* Caches identity, taking a reference, in place of whatever was cached
+ * for its dev_t and UUID
+ */
+void
+device_cache_insert (DeviceCache    *cache,
+                     DeviceIdentity *identity)
+{
+    g_return_if_fail (identity->lru_link == NULL);
+
+    device_cache_invalidate_dev (cache, identity->dev);
+    device_cache_invalidate_uuid (cache, identity->uuid);
+
+    while (g_queue_get_length (&cache->lru) >= cache->max_size)
+        device_cache_remove (cache, g_queue_peek_tail (&cache->lru));
+
+    g_queue_push_head (&cache->lru, identity);
+    identity->lru_link = cache->lru.head;
+    g_hash_table_insert (cache->by_dev, &identity->dev, device_identity_ref (identity));
+    if (identity->uuid != NULL)
+        g_hash_table_insert (cache->by_uuid, identity->uuid, identity);
+}
+
+void
+device_cache_invalidate_dev (DeviceCache *cache,
+                             dev_t        dev)
+{
+    DeviceIdentity *identity;
+    gint64 key = dev;
+
+    identity = g_hash_table_lookup (cache->by_dev, &key);
+    if (identity != NULL)
+        device_cache_remove (cache, identity);
+}
+
+/* A filesystem can show up under a new dev_t, e.g. a disk plugged in again */
+void
+device_cache_invalidate_uuid (DeviceCache *cache,
+                              const gchar *uuid)
+{
+    DeviceIdentity *identity;
+
+    if (uuid == NULL)
+        return;
+
+    identity = g_hash_table_lookup (cache->by_uuid, uuid);
+    if (identity != NULL)
+        device_cache_remove (cache, identity);
+}
+
+/* Drive changes are rare and the cache is small, so this just walks it */
+void
+device_cache_invalidate_drive (DeviceCache *cache,
+                               const gchar *drive_path)
+{
+    GList *link;
+    GList *next;
+
+    if (drive_path == NULL)
+        return;
+
+    for (link = cache->lru.head; link != NULL; link = next)
+    {
+        DeviceIdentity *identity = link->data;
+
+        next = link->next;
+        if (g_strcmp0 (identity->drive_path, drive_path) == 0)
+            device_cache_remove (cache, identity);
+    }
+}
+
+void
+device_cache_clear (DeviceCache *cache)
+{
+    while (!g_queue_is_empty (&cache->lru))
+        device_cache_remove (cache, g_queue_peek_head (&cache->lru));
+}
@@ -0,0 +1,64 @@
+#ifndef __DEVICE_CACHE_H__
+#define __DEVICE_CACHE_H__
+#include <glib.h>
+#include <sys/types.h>
+
+/* Devices kept in the cache by default */
+#define DEVICE_CACHE_DEFAULT_SIZE 256
+
+/* What UDisks said about the block device behind a dev_t and its drive.
+ * Shared between the cache and every mount of the device; the strings
+ * never change once it is created.
+ */
+typedef struct _DeviceIdentity DeviceIdentity;
+struct _DeviceIdentity
+{
+    guint ref_count;
+    dev_t dev;
+    gchar *uuid;
+    gchar *drive_path;
+    gchar *serial;
+    gchar *vendor;
+    gchar *model;
+    /* FALSE if the drive wasn't found, only complete ones are cached */
+    gboolean complete;
+    /* link in the cache's LRU queue, NULL when not cached */
+    GList *lru_link;
+};
+
+/* The identities of the most recently resolved devices, by dev_t and by
+ * filesystem UUID.  Once max_size devices are cached the least recently
+ * used one is evicted.  Entries are dropped as soon as UDisks reports
+ * that their block or drive object changed, see DeviceIndex.
+ */
+typedef struct _DeviceCache DeviceCache;
+struct _DeviceCache
+{
+    guint max_size;
+    /* dev_t -> DeviceIdentity, owns a reference to each */
+    GHashTable *by_dev;
+    /* UUID -> DeviceIdentity, for identities with a UUID */
+    GHashTable *by_uuid;
+    /* most recently used first */
+    GQueue lru;
+};
+
+DeviceIdentity *device_identity_new          (dev_t            dev);
+DeviceIdentity *device_identity_ref          (DeviceIdentity  *identity);
+void            device_identity_unref        (DeviceIdentity  *identity);
+
+DeviceCache    *device_cache_new             (guint            max_size);
+void            device_cache_free            (DeviceCache     *cache);
+DeviceIdentity *device_cache_lookup          (DeviceCache     *cache,
+                                              dev_t            dev);
+void            device_cache_insert          (DeviceCache     *cache,
+                                              DeviceIdentity  *identity);
+void            device_cache_invalidate_dev  (DeviceCache     *cache,
+                                              dev_t            dev);
+void            device_cache_invalidate_uuid (DeviceCache     *cache,
+                                              const gchar     *uuid);
+void            device_cache_invalidate_drive (DeviceCache    *cache,
+                                              const gchar     *drive_path);
+void            device_cache_clear           (DeviceCache     *cache);
+
+#endif
@@ -0,0 +1,335 @@
+#include "deviceindex.h"
+#include <stdio.h>
+
+/* Whatever was resolved for the block before may no longer hold */
+static void
+invalidate_block (DeviceIndex *index,
+                  UDisksBlock *block)
+{
+    device_cache_invalidate_dev (index->cache, udisks_block_get_device_number (block));
+    device_cache_invalidate_uuid (index->cache, udisks_block_get_id_uuid (block));
+}
+
+static void
+index_block (DeviceIndex *index,
+             UDisksObject *object,
+             UDisksBlock  *block)
+{
+    gint64 *key;
+
+    key = g_new (gint64, 1);
+    *key = udisks_block_get_device_number (block);
+    g_hash_table_replace (index->blocks_by_dev, key, g_object_ref (object));
+    invalidate_block (index, block);
+}
+
+static void
+unindex_block (DeviceIndex *index,
+               UDisksObject *object,
+               UDisksBlock  *block)
+{
+    gint64 dev;
+
+    invalidate_block (index, block);
+    dev = udisks_block_get_device_number (block);
+    /* only if the slot still belongs to this object */
+    if (g_hash_table_lookup (index->blocks_by_dev, &dev) == object)
+        g_hash_table_remove (index->blocks_by_dev, &dev);
+}
+
+static void
+index_object (DeviceIndex *index,
+              GDBusObject *dbus_object)
+{
+    UDisksObject *object = UDISKS_OBJECT (dbus_object);
+    UDisksBlock *block;
+
+    block = udisks_object_peek_block (object);
+    if (block != NULL)
+        index_block (index, object, block);
+
+    if (udisks_object_peek_drive (object) != NULL)
+        g_hash_table_replace (index->drives_by_path,
+                              g_strdup (g_dbus_object_get_object_path (dbus_object)),
+                              g_object_ref (object));
+}
+
+static void
+unindex_object (DeviceIndex *index,
+                GDBusObject *dbus_object)
+{
+    UDisksObject *object = UDISKS_OBJECT (dbus_object);
+    UDisksBlock *block;
+
+    block = udisks_object_peek_block (object);
+    if (block != NULL)
+        unindex_block (index, object, block);
+
+    if (udisks_object_peek_drive (object) != NULL)
+        device_cache_invalidate_drive (index->cache, g_dbus_object_get_object_path (dbus_object));
+    g_hash_table_remove (index->drives_by_path, g_dbus_object_get_object_path (dbus_object));
+}
+
+static void
+notify_changed (DeviceIndex *index)
+{
+    if (index->changed_func != NULL)
+        index->changed_func (index, index->user_data);
+}
+
+static void
+on_object_added (GDBusObjectManager *manager,
+                 GDBusObject        *object,
+                 gpointer            user_data)
+{
+    index_object ((DeviceIndex *) user_data, object);
+    notify_changed ((DeviceIndex *) user_data);
+}
+
+static void
+on_object_removed (GDBusObjectManager *manager,
+                   GDBusObject        *object,
+                   gpointer            user_data)
+{
+    unindex_object ((DeviceIndex *) user_data, object);
+    notify_changed ((DeviceIndex *) user_data);
+}
+
+static void
+on_interface_added (GDBusObjectManager *manager,
+                    GDBusObject        *object,
+                    GDBusInterface     *interface,
+                    gpointer            user_data)
+{
+    index_object ((DeviceIndex *) user_data, object);
+    notify_changed ((DeviceIndex *) user_data);
+}
+
+static void
+on_interface_removed (GDBusObjectManager *manager,
+                      GDBusObject        *object,
+                      GDBusInterface     *interface,
+                      gpointer            user_data)
+{
+    DeviceIndex *index = user_data;
+
+    /* the object no longer carries the interface, so go by the interface itself */
+    if (UDISKS_IS_BLOCK (interface))
+        unindex_block (index, UDISKS_OBJECT (object), UDISKS_BLOCK (interface));
+    else if (UDISKS_IS_DRIVE (interface))
+    {
+        device_cache_invalidate_drive (index->cache, g_dbus_object_get_object_path (object));
+        g_hash_table_remove (index->drives_by_path, g_dbus_object_get_object_path (object));
+    }
+    notify_changed (index);
+}
+
+/* The cached identities only depend on the Block and Drive properties.
+ * The device number of a block object stays the same, so the identity
+ * resolved for it is found by dev_t even if its UUID just changed.
+ */
+static void
+on_properties_changed (GDBusObjectManagerClient *manager,
+                       GDBusObjectProxy         *object,
+                       GDBusProxy               *interface,
+                       GVariant                 *changed_properties,
+                       const gchar *const       *invalidated_properties,
+                       gpointer                  user_data)
+{
+    DeviceIndex *index = user_data;
+
+    if (UDISKS_IS_BLOCK (interface))
+        invalidate_block (index, UDISKS_BLOCK (interface));
+    else if (UDISKS_IS_DRIVE (interface))
+        device_cache_invalidate_drive (index->cache, g_dbus_object_get_object_path (G_DBUS_OBJECT (object)));
+}
+
+static void
+on_client_ready (GObject      *source_object,
+                 GAsyncResult *res,
+                 gpointer      user_data)
+{
+    DeviceIndex *index;
+    UDisksClient *client;
+    GError *error;
+    GList *objects;
+    GList *l;
+
+    error = NULL;
+    client = udisks_client_new_finish (res, &error);
+    if (client == NULL)
+    {
+        /* the index may already be gone */
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            g_error_free (error);
+            return;
+        }
+        index = user_data;
+        printf ("Error connecting to the udisks daemon: %s\n", error->message);
+        g_error_free (error);
+        goto out;
+    }
+
+    index = user_data;
+    index->client = client;
+    index->manager = udisks_client_get_object_manager (client);
+
+    objects = g_dbus_object_manager_get_objects (index->manager);
+    for (l = objects; l != NULL; l = l->next)
+        index_object (index, G_DBUS_OBJECT (l->data));
+    g_list_free_full (objects, g_object_unref);
+
+    index->object_added_id = g_signal_connect (index->manager, "object-added",
+                                               G_CALLBACK (on_object_added), index);
+    index->object_removed_id = g_signal_connect (index->manager, "object-removed",
+                                                 G_CALLBACK (on_object_removed), index);
+    index->interface_added_id = g_signal_connect (index->manager, "interface-added",
+                                                  G_CALLBACK (on_interface_added), index);
+    index->interface_removed_id = g_signal_connect (index->manager, "interface-removed",
+                                                    G_CALLBACK (on_interface_removed), index);
+    index->properties_changed_id = g_signal_connect (index->manager, "interface-proxy-properties-changed",
+                                                     G_CALLBACK (on_properties_changed), index);
+
+out:
+    index->ready = TRUE;
+    notify_changed (index);
+}
+
+/* Starts connecting to the udisks daemon without blocking the main loop */
+DeviceIndex *
+device_index_new (DeviceIndexChangedFunc changed_func,
+                  gpointer               user_data)
+{
+    DeviceIndex *index;
+
+    index = g_new0 (DeviceIndex, 1);
+    index->changed_func = changed_func;
+    index->user_data = user_data;
+    index->cancellable = g_cancellable_new ();
+    index->blocks_by_dev = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                                  g_free, g_object_unref);
+    index->drives_by_path = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                   g_free, g_object_unref);
+    index->cache = device_cache_new (DEVICE_CACHE_DEFAULT_SIZE);
+
+    udisks_client_new (index->cancellable, on_client_ready, index);
+
+    return index;
+}
+
+void
+device_index_free (DeviceIndex *index)
+{
+    if (index == NULL)
+        return;
+
+    g_cancellable_cancel (index->cancellable);
+    g_object_unref (index->cancellable);
+
+    if (index->client != NULL)
+    {
+        g_signal_handler_disconnect (index->manager, index->object_added_id);
+        g_signal_handler_disconnect (index->manager, index->object_removed_id);
+        g_signal_handler_disconnect (index->manager, index->interface_added_id);
+        g_signal_handler_disconnect (index->manager, index->interface_removed_id);
+        g_signal_handler_disconnect (index->manager, index->properties_changed_id);
+    }
+
+    g_hash_table_unref (index->blocks_by_dev);
+    g_hash_table_unref (index->drives_by_path);
+    device_cache_free (index->cache);
+    if (index->client != NULL)
+        g_object_unref (index->client);
+    g_free (index);
+}
+
+/* TRUE once connecting has finished, successfully or not */
+gboolean
+device_index_is_ready (DeviceIndex *index)
+{
+    return index->ready;
+}
+
+gboolean
+device_index_is_connected (DeviceIndex *index)
+{
+    return index->client != NULL;
+}
+
+/* Caches an identity that was resolved before, e.g. by an earlier run of
+ * the daemon, unless one is cached for its dev_t already.  Only complete
+ * identities are taken.
+ */
+void
+device_index_seed (DeviceIndex    *index,
+                   DeviceIdentity *identity)
+{
+    if (!identity->complete || identity->lru_link != NULL ||
+        device_cache_lookup (index->cache, identity->dev) != NULL)
+        return;
+    device_cache_insert (index->cache, identity);
+}
+
+/* Both lookups return a borrowed object, or NULL */
+UDisksObject *
+device_index_lookup_block (DeviceIndex *index,
+                           dev_t        dev)
+{
+    gint64 key = dev;
+
+    return g_hash_table_lookup (index->blocks_by_dev, &key);
+}
+
+UDisksObject *
+device_index_lookup_drive (DeviceIndex *index,
+                           const gchar *object_path)
+{
+    if (object_path == NULL)
+        return NULL;
+    return g_hash_table_lookup (index->drives_by_path, object_path);
+}
+
+/* Returns what UDisks knows about the block device dev and its drive, with
+ * a reference, or NULL if it doesn't know the block.  *out_cached tells
+ * whether it came from the cache.  An identity without a drive is returned
+ * but not cached, so the drive is looked for again next time.
+ */
+DeviceIdentity *
+device_index_resolve (DeviceIndex *index,
+                      dev_t        dev,
+                      gboolean    *out_cached)
+{
+    DeviceIdentity *identity;
+    UDisksObject *object;
+    UDisksBlock *block;
+    UDisksDrive *drive;
+
+    identity = device_cache_lookup (index->cache, dev);
+    *out_cached = identity != NULL;
+    if (identity != NULL)
+        return device_identity_ref (identity);
+
+    /* misses are counted by the caller, see the UdisksMisses metric */
+    object = device_index_lookup_block (index, dev);
+    if (object == NULL)
+        return NULL;
+
+    block = udisks_object_peek_block (object);
+    identity = device_identity_new (dev);
+    identity->uuid = g_strdup (udisks_block_get_id_uuid (block));
+    identity->drive_path = g_strdup (udisks_block_get_drive (block));
+
+    object = device_index_lookup_drive (index, identity->drive_path);
+    if (object == NULL)
+        return identity;
+
+    drive = udisks_object_peek_drive (object);
+    identity->serial = g_strdup (udisks_drive_get_serial (drive));
+    identity->vendor = g_strdup (udisks_drive_get_vendor (drive));
+    identity->model = g_strdup (udisks_drive_get_model (drive));
+    identity->complete = TRUE;
+    device_cache_insert (index->cache, identity);
+
+    return identity;
+}
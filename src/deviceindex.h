@@ -0,0 +1,63 @@
+#ifndef __DEVICE_INDEX_H__
+#define __DEVICE_INDEX_H__
+#include <udisks/udisks.h>
+#include "devicecache.h"
+
+typedef struct _DeviceIndex DeviceIndex;
+
+/* Called once the client is ready (or failed to connect) and whenever a
+ * block or drive object shows up or goes away afterwards.
+ */
+typedef void (*DeviceIndexChangedFunc) (DeviceIndex *index,
+                                        gpointer     user_data);
+
+/* A long-lived UDisks client together with hash indexes over its objects,
+ * kept current from the object manager's notifications so that looking up
+ * the block and drive behind a mount doesn't scan every UDisks object.
+ * What was resolved for a dev_t is cached until UDisks reports a change of
+ * its block or drive object, so a device mounted again is reported without
+ * looking at the objects at all.
+ *
+ * The client is created asynchronously; until it is ready all lookups
+ * return NULL.
+ */
+struct _DeviceIndex
+{
+    UDisksClient *client;
+    GCancellable *cancellable;
+    gboolean ready;
+    DeviceIndexChangedFunc changed_func;
+    gpointer user_data;
+
+    GDBusObjectManager *manager;
+
+    /* dev_t -> UDisksObject with a Block interface */
+    GHashTable *blocks_by_dev;
+    /* object path -> UDisksObject with a Drive interface */
+    GHashTable *drives_by_path;
+
+    DeviceCache *cache;
+
+    gulong object_added_id;
+    gulong object_removed_id;
+    gulong interface_added_id;
+    gulong interface_removed_id;
+    gulong properties_changed_id;
+};
+
+DeviceIndex  *device_index_new          (DeviceIndexChangedFunc changed_func,
+                                         gpointer      user_data);
+void          device_index_free         (DeviceIndex  *index);
+gboolean      device_index_is_ready     (DeviceIndex  *index);
+gboolean      device_index_is_connected (DeviceIndex  *index);
+UDisksObject *device_index_lookup_block (DeviceIndex  *index,
+                                         dev_t         dev);
+UDisksObject *device_index_lookup_drive (DeviceIndex  *index,
+                                         const gchar  *object_path);
+DeviceIdentity *device_index_resolve    (DeviceIndex  *index,
+                                         dev_t         dev,
+                                         gboolean     *out_cached);
+void          device_index_seed         (DeviceIndex  *index,
+                                         DeviceIdentity *identity);
+
+#endif
@@ -0,0 +1,122 @@
+#include "eventring.h"
+
+/* generation is that of the last change before the ring was created */
+EventRing *
+event_ring_new (guint   size,
+                guint64 generation)
+{
+    EventRing *ring;
+
+    ring = g_new0 (EventRing, 1);
+    ring->size = MAX (size, 1);
+    ring->entries = g_new0 (EventRingEntry, ring->size);
+    ring->generation = generation;
+
+    return ring;
+}
+
+void
+event_ring_free (EventRing *ring)
+{
+    guint n;
+
+    if (ring == NULL)
+        return;
+
+    for (n = 0; n < ring->len; n++)
+        g_value_array_free (ring->entries[(ring->head + n) % ring->size].mount);
+    g_free (ring->entries);
+    g_free (ring);
+}
+
+/* Takes over mount and returns the generation assigned to the change */
+guint64
+event_ring_append (EventRing   *ring,
+                   gboolean     added,
+                   GValueArray *mount)
+{
+    EventRingEntry *entry;
+
+    if (ring->len == ring->size)
+    {
+        /* overwrite the oldest one */
+        entry = &ring->entries[ring->head];
+        g_value_array_free (entry->mount);
+        ring->head = (ring->head + 1) % ring->size;
+    }
+    else
+    {
+        entry = &ring->entries[(ring->head + ring->len) % ring->size];
+        ring->len++;
+    }
+
+    entry->generation = ++ring->generation;
+    entry->added = added;
+    entry->mount = mount;
+
+    return entry->generation;
+}
+
+guint64
+event_ring_get_generation (EventRing *ring)
+{
+    return ring->generation;
+}
+
+/* (generation, added, mount fields...) as sent by GetChangesSince */
+GValueArray *
+event_ring_change_new (guint64      generation,
+                       gboolean     added,
+                       GValueArray *mount)
+{
+    GValueArray *change;
+    GValue value = G_VALUE_INIT;
+    guint n;
+
+    change = g_value_array_new (2 + mount->n_values);
+
+    g_value_init (&value, G_TYPE_UINT64);
+    g_value_set_uint64 (&value, generation);
+    g_value_array_append (change, &value);
+    g_value_unset (&value);
+
+    g_value_init (&value, G_TYPE_BOOLEAN);
+    g_value_set_boolean (&value, added);
+    g_value_array_append (change, &value);
+    g_value_unset (&value);
+
+    for (n = 0; n < mount->n_values; n++)
+        g_value_array_append (change, g_value_array_get_nth (mount, n));
+
+    return change;
+}
+
+/* Appends every change after generation to changes, oldest first.  Returns
+ * FALSE, leaving changes alone, if some of them have already been dropped
+ * or generation is not one this ring handed out.
+ */
+gboolean
+event_ring_collect_since (EventRing *ring,
+                          guint64    generation,
+                          GPtrArray *changes)
+{
+    guint64 oldest;
+    guint n;
+
+    if (generation > ring->generation)
+        return FALSE;
+
+    /* generation of the oldest change still kept */
+    oldest = ring->generation - ring->len + 1;
+    if (generation + 1 < oldest)
+        return FALSE;
+
+    for (n = generation + 1 - oldest; n < ring->len; n++)
+    {
+        EventRingEntry *entry = &ring->entries[(ring->head + n) % ring->size];
+
+        g_ptr_array_add (changes, event_ring_change_new (entry->generation, entry->added, entry->mount));
+    }
+
+    return TRUE;
+}
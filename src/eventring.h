@@ -0,0 +1,45 @@
+#ifndef __EVENT_RING_H__
+#define __EVENT_RING_H__
+#include <glib-object.h>
+
+/* The most recent mount changes, each under its generation number, kept
+ * so that clients which missed signals can catch up with just the delta.
+ * Generations increase by one per change; the oldest changes are dropped
+ * once the ring is full.
+ */
+typedef struct _EventRingEntry EventRingEntry;
+struct _EventRingEntry
+{
+    guint64 generation;
+    gboolean added;
+    /* the mount as sent over D-Bus, see MOUNT_MONITOR_TYPE_MOUNT_ARRAY */
+    GValueArray *mount;
+};
+
+typedef struct _EventRing EventRing;
+struct _EventRing
+{
+    EventRingEntry *entries;
+    guint size;
+    /* index of the oldest entry */
+    guint head;
+    guint len;
+    /* generation of the newest change */
+    guint64 generation;
+};
+
+EventRing *event_ring_new            (guint         size,
+                                      guint64       generation);
+void       event_ring_free           (EventRing    *ring);
+guint64    event_ring_append         (EventRing    *ring,
+                                      gboolean      added,
+                                      GValueArray  *mount);
+guint64    event_ring_get_generation (EventRing    *ring);
+gboolean   event_ring_collect_since  (EventRing    *ring,
+                                      guint64       generation,
+                                      GPtrArray    *changes);
+GValueArray *event_ring_change_new   (guint64       generation,
+                                      gboolean      added,
+                                      GValueArray  *mount);
+
+#endif
@@ -0,0 +1,444 @@
+#include "journal.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+#define RECORD_ALIGN 8
+
+static gsize
+record_size (gsize len)
+{
+    return (len + RECORD_ALIGN - 1) & ~(gsize) (RECORD_ALIGN - 1);
+}
+
+/* Appends len bytes of record and the padding after them to the batch */
+static void
+buffer_record (MountJournal *journal,
+               gconstpointer record,
+               gsize         len)
+{
+    static const guint8 zeroes[RECORD_ALIGN] = { 0 };
+
+    g_byte_array_append (journal->buffer, record, len);
+    g_byte_array_append (journal->buffer, zeroes, record_size (len) - len);
+}
+
+/* Returns the ID of str in the current file, writing it out the first time */
+static guint32
+journal_string (MountJournal *journal,
+                const gchar  *str)
+{
+    MountJournalString record;
+    gpointer id;
+    gsize len;
+
+    if (str == NULL)
+        return MOUNT_JOURNAL_NO_STRING;
+
+    if (g_hash_table_lookup_extended (journal->string_ids, str, NULL, &id))
+        return GPOINTER_TO_UINT (id);
+
+    len = strlen (str);
+    memset (&record, 0, sizeof record);
+    record.record.size = record_size (sizeof record + len + 1);
+    record.record.type = MOUNT_JOURNAL_STRING;
+    record.id = journal->next_string_id++;
+    record.len = len;
+    g_byte_array_append (journal->buffer, (const guint8 *) &record, sizeof record);
+    buffer_record (journal, str, len + 1);
+    g_hash_table_insert (journal->string_ids, g_strdup (str), GUINT_TO_POINTER (record.id));
+
+    return record.id;
+}
+
+static gboolean
+string_id_is_unwritten (gpointer key,
+                        gpointer value,
+                        gpointer user_data)
+{
+    return GPOINTER_TO_UINT (value) >= GPOINTER_TO_UINT (user_data);
+}
+
+/* Writes out the batch.  If that fails the batch is lost: the file is cut
+ * back to where it ended before, and the strings first defined in the
+ * batch are forgotten, so their IDs are handed out again in order and a
+ * reader still accepts what comes after.  If the file can't be cut back
+ * it is given up, and the next batch starts a new one.
+ */
+static void
+journal_flush (MountJournal *journal)
+{
+    gboolean failed;
+    gsize done;
+    gssize n;
+
+    failed = journal->fd < 0 && journal->buffer->len > 0;
+    for (done = 0; journal->fd >= 0 && done < journal->buffer->len; done += n)
+    {
+        n = write (journal->fd, journal->buffer->data + done, journal->buffer->len - done);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                n = 0;
+                continue;
+            }
+            printf ("Error writing journal %s: %s\n", journal->path, g_strerror (errno));
+            failed = TRUE;
+            break;
+        }
+    }
+
+    if (!failed)
+        journal->size += done;
+    else
+    {
+        g_hash_table_foreach_remove (journal->string_ids, string_id_is_unwritten,
+                                     GUINT_TO_POINTER (journal->batch_string_id));
+        journal->next_string_id = journal->batch_string_id;
+        if (journal->fd >= 0 && ftruncate (journal->fd, journal->size) != 0)
+        {
+            printf ("Error truncating journal %s: %s\n", journal->path, g_strerror (errno));
+            close (journal->fd);
+            journal->fd = -1;
+        }
+    }
+    journal->batch_string_id = journal->next_string_id;
+    g_byte_array_set_size (journal->buffer, 0);
+}
+
+/* Ends the batch with a BATCH_END record and writes it in one go */
+static void
+journal_write_batch (MountJournal *journal,
+                     guint64       generation)
+{
+    MountJournalBatchEnd record;
+
+    memset (&record, 0, sizeof record);
+    record.record.size = record_size (sizeof record);
+    record.record.type = MOUNT_JOURNAL_BATCH_END;
+    record.timestamp = g_get_real_time ();
+    record.generation = generation;
+    buffer_record (journal, &record, sizeof record);
+    journal_flush (journal);
+}
+
+/* Moves path.N-1 to path.N and so on, path itself to path.1 */
+static void
+journal_rotate_files (MountJournal *journal)
+{
+    gchar *from;
+    gchar *to;
+    guint n;
+
+    if (journal->max_files == 0)
+    {
+        g_unlink (journal->path);
+        return;
+    }
+
+    for (n = journal->max_files; n > 1; n--)
+    {
+        from = g_strdup_printf ("%s.%u", journal->path, n - 1);
+        to = g_strdup_printf ("%s.%u", journal->path, n);
+        g_rename (from, to);
+        g_free (from);
+        g_free (to);
+    }
+    to = g_strdup_printf ("%s.1", journal->path);
+    g_rename (journal->path, to);
+    g_free (to);
+}
+
+/* Rotates away whatever is at path and starts a new file there */
+static gboolean
+journal_start_file (MountJournal  *journal,
+                    GError       **error)
+{
+    MountJournalHeader header;
+    struct stat statbuf;
+    guint64 generation;
+    int errsv;
+
+    if (journal->fd >= 0)
+        close (journal->fd);
+    journal->fd = -1;
+    if (g_stat (journal->path, &statbuf) == 0 && statbuf.st_size > 0)
+        journal_rotate_files (journal);
+
+    journal->fd = g_open (journal->path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (journal->fd < 0)
+    {
+        errsv = errno;
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+                     "Error opening journal %s: %s", journal->path, g_strerror (errsv));
+        return FALSE;
+    }
+    journal->size = 0;
+    g_hash_table_remove_all (journal->string_ids);
+    journal->next_string_id = MOUNT_JOURNAL_NO_STRING + 1;
+    journal->batch_string_id = journal->next_string_id;
+
+    memset (&header, 0, sizeof header);
+    memcpy (header.magic, MOUNT_JOURNAL_MAGIC, sizeof header.magic);
+    header.version = MOUNT_JOURNAL_VERSION;
+    header.created = g_get_real_time ();
+    g_byte_array_set_size (journal->buffer, 0);
+    g_byte_array_append (journal->buffer, (const guint8 *) &header, sizeof header);
+
+    generation = journal->start_func (journal, journal->user_data);
+    journal_write_batch (journal, generation);
+
+    return TRUE;
+}
+
+/* Opens the journal at path.  An existing file there is rotated first, so
+ * string IDs never clash with those of an earlier run.
+ */
+MountJournal *
+mount_journal_open (const gchar            *path,
+                    guint64                 max_size,
+                    guint                   max_files,
+                    MountJournalStartFunc   start_func,
+                    gpointer                user_data,
+                    GError                **error)
+{
+    MountJournal *journal;
+
+    journal = g_new0 (MountJournal, 1);
+    journal->path = g_strdup (path);
+    journal->max_size = max_size;
+    journal->max_files = max_files;
+    journal->fd = -1;
+    journal->string_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    journal->buffer = g_byte_array_new ();
+    journal->start_func = start_func;
+    journal->user_data = user_data;
+
+    if (!journal_start_file (journal, error))
+    {
+        mount_journal_free (journal);
+        return NULL;
+    }
+
+    return journal;
+}
+
+void
+mount_journal_free (MountJournal *journal)
+{
+    if (journal == NULL)
+        return;
+
+    journal_flush (journal);
+    if (journal->fd >= 0)
+        close (journal->fd);
+    g_byte_array_unref (journal->buffer);
+    g_hash_table_unref (journal->string_ids);
+    g_free (journal->path);
+    g_free (journal);
+}
+
+/* Adds a record of mount to the current batch.  old_mount and fields are
+ * only used for MOUNT_JOURNAL_CHANGED; uuid and serial are the device info
+ * the mount was announced with.
+ */
+void
+mount_journal_append (MountJournal           *journal,
+                      MountJournalRecordType  type,
+                      guint64                 generation,
+                      MountInfo              *mount,
+                      MountInfo              *old_mount,
+                      MountChangedFields      fields,
+                      const gchar            *uuid,
+                      const gchar            *serial)
+{
+    MountJournalMount record;
+
+    /* the strings go ahead of the record that refers to them */
+    memset (&record, 0, sizeof record);
+    record.path = journal_string (journal, mount->mount_path);
+    if (old_mount != NULL && (fields & MOUNT_CHANGED_PATH))
+        record.old_path = journal_string (journal, old_mount->mount_path);
+    record.fstype = journal_string (journal, mount->fstype);
+    record.source = journal_string (journal, mount->source);
+    record.root = journal_string (journal, mount->root);
+    record.options = journal_string (journal, mount->options);
+    record.super_options = journal_string (journal, mount->super_options);
+    record.propagation = journal_string (journal, mount->propagation);
+    record.uuid = journal_string (journal, uuid);
+    record.serial = journal_string (journal, serial);
+
+    record.record.size = record_size (sizeof record);
+    record.record.type = type;
+    record.timestamp = g_get_real_time ();
+    record.generation = generation;
+    record.ns_id = mount->ns_id;
+    record.dev = mount->dev;
+    record.mount_id = mount->mount_id;
+    record.parent_id = mount->parent_id;
+    record.mount_type = mount->type;
+    record.fields = fields;
+    buffer_record (journal, &record, sizeof record);
+}
+
+/* Writes out the current batch, which ends at generation.  Files are
+ * rotated between batches, never in the middle of one.
+ */
+void
+mount_journal_end_batch (MountJournal *journal,
+                         guint64       generation)
+{
+    GError *error;
+
+    journal_write_batch (journal, generation);
+    /* a file that lost its header, or was given up, is started again */
+    if (journal->fd >= 0 && journal->size > 0 && journal->size < journal->max_size)
+        return;
+
+    error = NULL;
+    if (!journal_start_file (journal, &error))
+    {
+        printf ("%s\n", error->message);
+        g_error_free (error);
+    }
+}
+
+MountJournalReader *
+mount_journal_reader_open (const gchar  *path,
+                           GError      **error)
+{
+    MountJournalReader *reader;
+    const MountJournalHeader *header;
+    GMappedFile *file;
+
+    file = g_mapped_file_new (path, FALSE, error);
+    if (file == NULL)
+        return NULL;
+
+    header = (const MountJournalHeader *) g_mapped_file_get_contents (file);
+    if (g_mapped_file_get_length (file) < sizeof *header ||
+        memcmp (header->magic, MOUNT_JOURNAL_MAGIC, sizeof header->magic) != 0 ||
+        header->version != MOUNT_JOURNAL_VERSION)
+    {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                     "%s is not a version %d journal", path, MOUNT_JOURNAL_VERSION);
+        g_mapped_file_unref (file);
+        return NULL;
+    }
+
+    reader = g_new0 (MountJournalReader, 1);
+    reader->file = file;
+    reader->data = g_mapped_file_get_contents (file);
+    reader->len = g_mapped_file_get_length (file);
+    reader->offset = sizeof *header;
+    reader->strings = g_ptr_array_new ();
+    /* MOUNT_JOURNAL_NO_STRING */
+    g_ptr_array_add (reader->strings, NULL);
+
+    return reader;
+}
+
+void
+mount_journal_reader_free (MountJournalReader *reader)
+{
+    if (reader == NULL)
+        return;
+
+    g_ptr_array_unref (reader->strings);
+    g_mapped_file_unref (reader->file);
+    g_free (reader);
+}
+
+/* An ID that wasn't defined reads as NULL */
+static const gchar *
+reader_string (MountJournalReader *reader,
+               guint32             id)
+{
+    if (id >= reader->strings->len)
+        return NULL;
+    return g_ptr_array_index (reader->strings, id);
+}
+
+/* Fills in the next mount or BATCH_END record; the STRING records on the
+ * way are taken in.  Returns FALSE at the end of the file, a record cut
+ * short or anything that doesn't parse.
+ */
+gboolean
+mount_journal_reader_next (MountJournalReader *reader,
+                           MountJournalEvent  *event)
+{
+    const MountJournalRecord *record;
+    const MountJournalString *string;
+    const MountJournalMount *mount;
+    const MountJournalBatchEnd *end;
+
+    while (reader->offset + sizeof *record <= reader->len)
+    {
+        record = (const MountJournalRecord *) (reader->data + reader->offset);
+        if (record->size < sizeof *record || record->size % RECORD_ALIGN != 0 ||
+            record->size > reader->len - reader->offset)
+            return FALSE;
+        reader->offset += record->size;
+
+        memset (event, 0, sizeof *event);
+        event->type = record->type;
+        switch (record->type)
+        {
+        case MOUNT_JOURNAL_STRING:
+            string = (const MountJournalString *) record;
+            /* IDs are handed out in order, so a gap means a corrupt file */
+            if (record->size < sizeof *string + string->len + 1 ||
+                string->id != reader->strings->len ||
+                ((const gchar *) (string + 1))[string->len] != '\0')
+                return FALSE;
+            g_ptr_array_add (reader->strings, (gpointer) (string + 1));
+            break;
+
+        case MOUNT_JOURNAL_PRESENT:
+        case MOUNT_JOURNAL_ADDED:
+        case MOUNT_JOURNAL_REMOVED:
+        case MOUNT_JOURNAL_CHANGED:
+            mount = (const MountJournalMount *) record;
+            if (record->size < sizeof *mount)
+                return FALSE;
+            event->timestamp = mount->timestamp;
+            event->generation = mount->generation;
+            event->ns_id = mount->ns_id;
+            event->dev = mount->dev;
+            event->mount_id = mount->mount_id;
+            event->parent_id = mount->parent_id;
+            event->mount_type = mount->mount_type;
+            event->fields = mount->fields;
+            event->path = reader_string (reader, mount->path);
+            event->old_path = reader_string (reader, mount->old_path);
+            event->fstype = reader_string (reader, mount->fstype);
+            event->source = reader_string (reader, mount->source);
+            event->root = reader_string (reader, mount->root);
+            event->options = reader_string (reader, mount->options);
+            event->super_options = reader_string (reader, mount->super_options);
+            event->propagation = reader_string (reader, mount->propagation);
+            event->uuid = reader_string (reader, mount->uuid);
+            event->serial = reader_string (reader, mount->serial);
+            return TRUE;
+
+        case MOUNT_JOURNAL_BATCH_END:
+            end = (const MountJournalBatchEnd *) record;
+            if (record->size < sizeof *end)
+                return FALSE;
+            event->timestamp = end->timestamp;
+            event->generation = end->generation;
+            return TRUE;
+
+        default:
+            /* nothing to report, but it is well-formed: skip it */
+            break;
+        }
+    }
+
+    return FALSE;
+}
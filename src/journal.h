@@ -0,0 +1,182 @@
+#ifndef __JOURNAL_H__
+#define __JOURNAL_H__
+#include "mountinfo.h"
+
+#define MOUNT_JOURNAL_MAGIC "MMJRNL\r\n"
+#define MOUNT_JOURNAL_VERSION 1
+/* a string ID that stands for NULL */
+#define MOUNT_JOURNAL_NO_STRING 0
+
+/* A journal file is the header followed by records, all in host byte order
+ * and padded to 8 bytes.  It is only ever appended to, so a reader may
+ * find the last record cut short; everything before it is complete.
+ *
+ * Strings are written once per file as a STRING record that gives them an
+ * ID, before the first record that uses it.  Every file starts with the
+ * mounts present when it was opened (PRESENT records, then BATCH_END), so
+ * each one can be read on its own after the older ones were rotated away.
+ */
+typedef struct _MountJournalHeader MountJournalHeader;
+struct _MountJournalHeader
+{
+    gchar magic[8];
+    guint32 version;
+    guint32 padding;
+    /* wall clock in microseconds */
+    gint64 created;
+};
+
+typedef enum
+{
+    MOUNT_JOURNAL_STRING = 1,
+    MOUNT_JOURNAL_PRESENT,      /* there when the file was started */
+    MOUNT_JOURNAL_ADDED,
+    MOUNT_JOURNAL_REMOVED,
+    MOUNT_JOURNAL_CHANGED,
+    MOUNT_JOURNAL_BATCH_END     /* ends the changes announced together */
+} MountJournalRecordType;
+
+typedef struct _MountJournalRecord MountJournalRecord;
+struct _MountJournalRecord
+{
+    /* including this header and the padding */
+    guint32 size;
+    guint32 type;
+};
+
+/* followed by len bytes and a NUL */
+typedef struct _MountJournalString MountJournalString;
+struct _MountJournalString
+{
+    MountJournalRecord record;
+    guint32 id;
+    guint32 len;
+};
+
+typedef struct _MountJournalMount MountJournalMount;
+struct _MountJournalMount
+{
+    MountJournalRecord record;
+    /* wall clock in microseconds */
+    gint64 timestamp;
+    /* as in the signals */
+    guint64 generation;
+    guint64 ns_id;
+    guint64 dev;
+    guint64 mount_id;
+    guint64 parent_id;
+    guint32 mount_type;
+    /* MountChangedFields of a CHANGED record */
+    guint32 fields;
+    /* string IDs */
+    guint32 path;
+    guint32 old_path;
+    guint32 fstype;
+    guint32 source;
+    guint32 root;
+    guint32 options;
+    guint32 super_options;
+    guint32 propagation;
+    guint32 uuid;
+    guint32 serial;
+};
+
+typedef struct _MountJournalBatchEnd MountJournalBatchEnd;
+struct _MountJournalBatchEnd
+{
+    MountJournalRecord record;
+    gint64 timestamp;
+    guint64 generation;
+};
+
+typedef struct _MountJournal MountJournal;
+
+/* Called on a fresh file to append the PRESENT records; returns the
+ * current generation, which the first BATCH_END carries */
+typedef guint64 (*MountJournalStartFunc) (MountJournal *journal,
+                                          gpointer      user_data);
+
+struct _MountJournal
+{
+    gchar *path;
+    /* the file is rotated once it has grown past max_size ... */
+    guint64 max_size;
+    /* ... to path.1, path.1 to path.2 and so on up to path.max_files */
+    guint max_files;
+    int fd;
+    guint64 size;
+
+    /* string -> ID in the current file */
+    GHashTable *string_ids;
+    guint32 next_string_id;
+    /* the first ID handed out since the last write; the strings from there
+     * on are only in buffer */
+    guint32 batch_string_id;
+    /* the records of the current batch, written by mount_journal_end_batch() */
+    GByteArray *buffer;
+
+    MountJournalStartFunc start_func;
+    gpointer user_data;
+};
+
+/* One record as read back; the strings point into the mapped file */
+typedef struct _MountJournalEvent MountJournalEvent;
+struct _MountJournalEvent
+{
+    MountJournalRecordType type;
+    gint64 timestamp;
+    guint64 generation;
+    guint64 ns_id;
+    guint64 dev;
+    guint64 mount_id;
+    guint64 parent_id;
+    MountType mount_type;
+    MountChangedFields fields;
+    const gchar *path;
+    const gchar *old_path;
+    const gchar *fstype;
+    const gchar *source;
+    const gchar *root;
+    const gchar *options;
+    const gchar *super_options;
+    const gchar *propagation;
+    const gchar *uuid;
+    const gchar *serial;
+};
+
+typedef struct _MountJournalReader MountJournalReader;
+struct _MountJournalReader
+{
+    GMappedFile *file;
+    const gchar *data;
+    gsize len;
+    gsize offset;
+    /* ID -> string in the mapping */
+    GPtrArray *strings;
+};
+
+MountJournal       *mount_journal_open        (const gchar            *path,
+                                               guint64                 max_size,
+                                               guint                   max_files,
+                                               MountJournalStartFunc   start_func,
+                                               gpointer                user_data,
+                                               GError                **error);
+void                mount_journal_free        (MountJournal           *journal);
+void                mount_journal_append      (MountJournal           *journal,
+                                               MountJournalRecordType  type,
+                                               guint64                 generation,
+                                               MountInfo              *mount,
+                                               MountInfo              *old_mount,
+                                               MountChangedFields      fields,
+                                               const gchar            *uuid,
+                                               const gchar            *serial);
+void                mount_journal_end_batch   (MountJournal           *journal,
+                                               guint64                 generation);
+
+MountJournalReader *mount_journal_reader_open (const gchar            *path,
+                                               GError                **error);
+void                mount_journal_reader_free (MountJournalReader     *reader);
+gboolean            mount_journal_reader_next (MountJournalReader     *reader,
+                                               MountJournalEvent      *event);
+
+#endif
@@ -0,0 +1,474 @@
+#include "kernelmounts.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/fanotify.h>
+#include <gio/gio.h>
+
+/* Not every libc or kernel header ships these yet */
+#ifndef __NR_statmount
+#define __NR_statmount 457
+#endif
+#ifndef __NR_listmount
+#define __NR_listmount 458
+#endif
+
+#define KERNEL_LSMT_ROOT            G_GUINT64_CONSTANT (0xffffffffffffffff)
+#define KERNEL_STATMOUNT_SB_BASIC   0x00000001U
+#define KERNEL_STATMOUNT_MNT_BASIC  0x00000002U
+#define KERNEL_STATMOUNT_PROPAGATE_FROM 0x00000004U
+#define KERNEL_STATMOUNT_MNT_ROOT   0x00000008U
+#define KERNEL_STATMOUNT_MNT_POINT  0x00000010U
+#define KERNEL_STATMOUNT_FS_TYPE    0x00000020U
+#define KERNEL_STATMOUNT_MNT_OPTS   0x00000080U
+#define KERNEL_STATMOUNT_SB_SOURCE  0x00000200U
+
+/* statmount() reports flags where mountinfo shows words */
+#define KERNEL_MOUNT_ATTR_RDONLY        0x00000001
+#define KERNEL_MOUNT_ATTR_NOSUID        0x00000002
+#define KERNEL_MOUNT_ATTR_NODEV         0x00000004
+#define KERNEL_MOUNT_ATTR_NOEXEC        0x00000008
+#define KERNEL_MOUNT_ATTR__ATIME        0x00000070
+#define KERNEL_MOUNT_ATTR_RELATIME      0x00000000
+#define KERNEL_MOUNT_ATTR_NOATIME       0x00000010
+#define KERNEL_MOUNT_ATTR_NODIRATIME    0x00000080
+#define KERNEL_MOUNT_ATTR_IDMAP         0x00100000
+#define KERNEL_MOUNT_ATTR_NOSYMFOLLOW   0x00200000
+#define KERNEL_SB_RDONLY                0x00000001
+#define KERNEL_SB_SYNCHRONOUS           0x00000010
+#define KERNEL_SB_MANDLOCK              0x00000040
+#define KERNEL_SB_DIRSYNC               0x00000080
+#define KERNEL_SB_LAZYTIME              0x02000000
+#define KERNEL_MS_UNBINDABLE            (1 << 17)
+#define KERNEL_MS_SLAVE                 (1 << 19)
+#define KERNEL_MS_SHARED                (1 << 20)
+
+#ifndef FAN_REPORT_MNT
+#define FAN_REPORT_MNT 0x00004000
+#endif
+#ifndef FAN_MARK_MNTNS
+#define FAN_MARK_MNTNS 0x00000110
+#endif
+#ifndef FAN_MNT_ATTACH
+#define FAN_MNT_ATTACH 0x01000000
+#endif
+#ifndef FAN_MNT_DETACH
+#define FAN_MNT_DETACH 0x02000000
+#endif
+#ifndef FAN_EVENT_INFO_TYPE_MNT
+#define FAN_EVENT_INFO_TYPE_MNT 7
+#endif
+
+/* NS_GET_MNTNS_ID, Linux 6.10 */
+#define KERNEL_NS_GET_MNTNS_ID _IOR (0xb7, 0x5, guint64)
+
+#define KERNEL_MOUNT_LIST_CHUNK 512
+#define KERNEL_MOUNT_MIN_BUF_SIZE 4096
+
+/* struct mnt_id_req; version 0 ends before mnt_ns_id */
+struct kernel_mnt_id_req
+{
+    guint32 size;
+    guint32 spare;
+    guint64 mnt_id;
+    guint64 param;
+    guint64 mnt_ns_id;
+};
+
+#define KERNEL_MNT_ID_REQ_SIZE_VER0 24
+#define KERNEL_MNT_ID_REQ_SIZE_VER1 32
+
+/* The fixed part of struct statmount, up to the fields used here; the
+ * string area always starts at offset 512.
+ */
+struct kernel_statmount
+{
+    guint32 size;
+    guint32 mnt_opts;
+    guint64 mask;
+    guint32 sb_dev_major;
+    guint32 sb_dev_minor;
+    guint64 sb_magic;
+    guint32 sb_flags;
+    guint32 fs_type;
+    guint64 mnt_id;
+    guint64 mnt_parent_id;
+    guint32 mnt_id_old;
+    guint32 mnt_parent_id_old;
+    guint64 mnt_attr;
+    guint64 mnt_propagation;
+    guint64 mnt_peer_group;
+    guint64 mnt_master;
+    guint64 propagate_from;
+    guint32 mnt_root;
+    guint32 mnt_point;
+    guint64 mnt_ns_id;
+    guint32 fs_subtype;
+    guint32 sb_source;
+    guint64 spare[48];
+    gchar str[];
+};
+
+G_STATIC_ASSERT (sizeof (struct kernel_statmount) == 512);
+
+struct kernel_fanotify_info_mnt
+{
+    struct fanotify_event_info_header hdr;
+    guint64 mnt_id;
+};
+
+static void
+set_error_from_errno (GError     **error,
+                      int          errsv,
+                      const gchar *what)
+{
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                 "%s: %s", what, g_strerror (errsv));
+}
+
+/* Our own namespace is addressed with the version 0 request, which older
+ * kernels understand as well.
+ */
+static void
+init_request (struct kernel_mnt_id_req *req,
+              guint64                   mnt_ns_id,
+              guint64                   mnt_id,
+              guint64                   param)
+{
+    memset (req, 0, sizeof *req);
+    req->size = mnt_ns_id != 0 ? KERNEL_MNT_ID_REQ_SIZE_VER1 : KERNEL_MNT_ID_REQ_SIZE_VER0;
+    req->mnt_id = mnt_id;
+    req->param = param;
+    req->mnt_ns_id = mnt_ns_id;
+}
+
+static long
+do_listmount (guint64  mnt_ns_id,
+              guint64  last_id,
+              guint64 *ids,
+              gsize    nr_ids)
+{
+    struct kernel_mnt_id_req req;
+
+    init_request (&req, mnt_ns_id, KERNEL_LSMT_ROOT, last_id);
+
+    return syscall (__NR_listmount, &req, ids, nr_ids, 0);
+}
+
+/* Watches the mount namespace behind ns_path (a /proc/<pid>/ns/mnt file),
+ * or our own one if ns_path is NULL.
+ *
+ * Fails on kernels without listmount()/statmount() or without fanotify
+ * mount notifications, and without CAP_SYS_ADMIN.
+ */
+KernelMountSource *
+kernel_mount_source_new (const gchar  *ns_path,
+                         GError      **error)
+{
+    KernelMountSource *source;
+    guint64 mnt_ns_id;
+    guint64 id;
+    int ns_fd;
+
+    ns_fd = open (ns_path != NULL ? ns_path : "/proc/self/ns/mnt", O_RDONLY | O_CLOEXEC);
+    if (ns_fd < 0)
+    {
+        set_error_from_errno (error, errno, "opening mount namespace");
+        return NULL;
+    }
+
+    mnt_ns_id = 0;
+    if (ns_path != NULL && ioctl (ns_fd, KERNEL_NS_GET_MNTNS_ID, &mnt_ns_id) != 0)
+    {
+        set_error_from_errno (error, errno, "NS_GET_MNTNS_ID");
+        close (ns_fd);
+        return NULL;
+    }
+
+    if (do_listmount (mnt_ns_id, 0, &id, 1) < 0)
+    {
+        set_error_from_errno (error, errno, "listmount");
+        close (ns_fd);
+        return NULL;
+    }
+
+    source = g_new0 (KernelMountSource, 1);
+    source->mnt_ns_id = mnt_ns_id;
+    source->fanotify_fd = fanotify_init (FAN_CLASS_NOTIF | FAN_REPORT_MNT | FAN_CLOEXEC | FAN_NONBLOCK, 0);
+    if (source->fanotify_fd < 0)
+    {
+        set_error_from_errno (error, errno, "fanotify_init");
+        close (ns_fd);
+        g_free (source);
+        return NULL;
+    }
+
+    if (fanotify_mark (source->fanotify_fd, FAN_MARK_ADD | FAN_MARK_MNTNS,
+                       FAN_MNT_ATTACH | FAN_MNT_DETACH, ns_fd, NULL) != 0)
+    {
+        set_error_from_errno (error, errno, "fanotify_mark");
+        close (ns_fd);
+        kernel_mount_source_free (source);
+        return NULL;
+    }
+    close (ns_fd);
+
+    source->buf_size = KERNEL_MOUNT_MIN_BUF_SIZE;
+    source->buf = g_malloc (source->buf_size);
+    source->strings = g_string_new (NULL);
+
+    return source;
+}
+
+void
+kernel_mount_source_free (KernelMountSource *source)
+{
+    if (source == NULL)
+        return;
+    if (source->fanotify_fd >= 0)
+        close (source->fanotify_fd);
+    g_free (source->buf);
+    if (source->strings != NULL)
+        g_string_free (source->strings, TRUE);
+    g_free (source);
+}
+
+int
+kernel_mount_source_get_fd (KernelMountSource *source)
+{
+    return source->fanotify_fd;
+}
+
+/* Appends the unique (64-bit) IDs of all mounts in the namespace to ids */
+gboolean
+kernel_mount_source_list (KernelMountSource  *source,
+                          GArray             *ids,
+                          GError            **error)
+{
+    guint64 last_id;
+    long n;
+
+    last_id = 0;
+    do
+    {
+        guint len = ids->len;
+
+        g_array_set_size (ids, len + KERNEL_MOUNT_LIST_CHUNK);
+        n = do_listmount (source->mnt_ns_id, last_id, &g_array_index (ids, guint64, len), KERNEL_MOUNT_LIST_CHUNK);
+        if (n < 0)
+        {
+            g_array_set_size (ids, len);
+            set_error_from_errno (error, errno, "listmount");
+            return FALSE;
+        }
+        g_array_set_size (ids, len + n);
+        if (n > 0)
+            last_id = g_array_index (ids, guint64, ids->len - 1);
+    }
+    while (n == KERNEL_MOUNT_LIST_CHUNK);
+
+    return TRUE;
+}
+
+/* Per-mount options, in the order show_mnt_opts() prints them */
+static void
+append_mount_options (GString *str,
+                      guint64  attr)
+{
+    g_string_append (str, (attr & KERNEL_MOUNT_ATTR_RDONLY) ? "ro" : "rw");
+    if (attr & KERNEL_MOUNT_ATTR_NOSUID)
+        g_string_append (str, ",nosuid");
+    if (attr & KERNEL_MOUNT_ATTR_NODEV)
+        g_string_append (str, ",nodev");
+    if (attr & KERNEL_MOUNT_ATTR_NOEXEC)
+        g_string_append (str, ",noexec");
+    if ((attr & KERNEL_MOUNT_ATTR__ATIME) == KERNEL_MOUNT_ATTR_NOATIME)
+        g_string_append (str, ",noatime");
+    if (attr & KERNEL_MOUNT_ATTR_NODIRATIME)
+        g_string_append (str, ",nodiratime");
+    if ((attr & KERNEL_MOUNT_ATTR__ATIME) == KERNEL_MOUNT_ATTR_RELATIME)
+        g_string_append (str, ",relatime");
+    if (attr & KERNEL_MOUNT_ATTR_NOSYMFOLLOW)
+        g_string_append (str, ",nosymfollow");
+    if (attr & KERNEL_MOUNT_ATTR_IDMAP)
+        g_string_append (str, ",idmapped");
+}
+
+/* Superblock flags followed by the filesystem's own options, if known */
+static void
+append_super_options (GString     *str,
+                      guint32      sb_flags,
+                      const gchar *fs_options)
+{
+    g_string_append (str, (sb_flags & KERNEL_SB_RDONLY) ? "ro" : "rw");
+    if (sb_flags & KERNEL_SB_SYNCHRONOUS)
+        g_string_append (str, ",sync");
+    if (sb_flags & KERNEL_SB_DIRSYNC)
+        g_string_append (str, ",dirsync");
+    if (sb_flags & KERNEL_SB_MANDLOCK)
+        g_string_append (str, ",mand");
+    if (sb_flags & KERNEL_SB_LAZYTIME)
+        g_string_append (str, ",lazytime");
+    if (fs_options != NULL && *fs_options != '\0')
+        g_string_append_printf (str, ",%s", fs_options);
+}
+
+/* The optional fields of mountinfo, see show_mountinfo() */
+static void
+append_propagation (GString                       *str,
+                    const struct kernel_statmount *sm)
+{
+    gsize start = str->len;
+
+    if (sm->mnt_propagation & KERNEL_MS_SHARED)
+        g_string_append_printf (str, "shared:%" G_GUINT64_FORMAT " ", sm->mnt_peer_group);
+    if (sm->mnt_propagation & KERNEL_MS_SLAVE)
+    {
+        g_string_append_printf (str, "master:%" G_GUINT64_FORMAT " ", sm->mnt_master);
+        if (sm->propagate_from != 0 && sm->propagate_from != sm->mnt_master)
+            g_string_append_printf (str, "propagate_from:%" G_GUINT64_FORMAT " ", sm->propagate_from);
+    }
+    if (sm->mnt_propagation & KERNEL_MS_UNBINDABLE)
+        g_string_append (str, "unbindable ");
+    /* the trailing space */
+    if (str->len > start)
+        g_string_truncate (str, str->len - 1);
+}
+
+gboolean
+kernel_mount_source_stat (KernelMountSource  *source,
+                          guint64             mnt_id,
+                          KernelMount        *mount,
+                          GError            **error)
+{
+    struct kernel_mnt_id_req req;
+    struct kernel_statmount *sm;
+    gsize super_options;
+    gsize propagation;
+
+    init_request (&req, source->mnt_ns_id, mnt_id,
+                  KERNEL_STATMOUNT_SB_BASIC | KERNEL_STATMOUNT_MNT_BASIC |
+                  KERNEL_STATMOUNT_PROPAGATE_FROM |
+                  KERNEL_STATMOUNT_MNT_ROOT | KERNEL_STATMOUNT_MNT_POINT |
+                  KERNEL_STATMOUNT_FS_TYPE | KERNEL_STATMOUNT_MNT_OPTS |
+                  KERNEL_STATMOUNT_SB_SOURCE);
+
+    /* the buffer grows until the strings fit and is kept for the next call */
+    while (syscall (__NR_statmount, &req, source->buf, source->buf_size, 0) < 0)
+    {
+        if (errno != EOVERFLOW)
+        {
+            set_error_from_errno (error, errno, "statmount");
+            return FALSE;
+        }
+        source->buf_size *= 2;
+        source->buf = g_realloc (source->buf, source->buf_size);
+    }
+
+    sm = source->buf;
+    mount->mnt_id = sm->mnt_id;
+    mount->mountinfo_id = sm->mnt_id_old;
+    mount->mountinfo_parent_id = sm->mnt_parent_id_old;
+    mount->major = sm->sb_dev_major;
+    mount->minor = sm->sb_dev_minor;
+    mount->mount_point = (sm->mask & KERNEL_STATMOUNT_MNT_POINT) ? sm->str + sm->mnt_point : NULL;
+    mount->fstype = (sm->mask & KERNEL_STATMOUNT_FS_TYPE) ? sm->str + sm->fs_type : NULL;
+    mount->source = (sm->mask & KERNEL_STATMOUNT_SB_SOURCE) ? sm->str + sm->sb_source : NULL;
+    mount->root = (sm->mask & KERNEL_STATMOUNT_MNT_ROOT) ? sm->str + sm->mnt_root : NULL;
+
+    /* offsets first, the string may move while it grows */
+    g_string_truncate (source->strings, 0);
+    append_mount_options (source->strings, sm->mnt_attr);
+    g_string_append_c (source->strings, '\0');
+    super_options = source->strings->len;
+    append_super_options (source->strings, sm->sb_flags,
+                          (sm->mask & KERNEL_STATMOUNT_MNT_OPTS) ? sm->str + sm->mnt_opts : NULL);
+    g_string_append_c (source->strings, '\0');
+    propagation = source->strings->len;
+    append_propagation (source->strings, sm);
+
+    mount->options = source->strings->str;
+    mount->super_options = source->strings->str + super_options;
+    mount->propagation = source->strings->str + propagation;
+
+    if (mount->mount_point == NULL || mount->fstype == NULL)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                     "statmount didn't report mount point and fstype of mount %" G_GUINT64_FORMAT,
+                     mnt_id);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Drains the fanotify queue, calling func for every attach and detach in
+ * the order the kernel reported them.  A move carries both bits and is
+ * passed on as a detach followed by an attach.
+ */
+gboolean
+kernel_mount_source_read_events (KernelMountSource     *source,
+                                 KernelMountEventFunc   func,
+                                 gpointer               user_data,
+                                 GError               **error)
+{
+    guint64 buf[4096 / sizeof (guint64)];
+    struct fanotify_event_metadata *meta;
+    ssize_t len;
+
+    for (;;)
+    {
+        len = read (source->fanotify_fd, buf, sizeof buf);
+        if (len < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN)
+                return TRUE;
+            set_error_from_errno (error, errno, "reading fanotify events");
+            return FALSE;
+        }
+        if (len == 0)
+            return TRUE;
+
+        for (meta = (struct fanotify_event_metadata *) buf;
+             FAN_EVENT_OK (meta, len);
+             meta = FAN_EVENT_NEXT (meta, len))
+        {
+            gchar *info;
+            gchar *end;
+            guint64 mnt_id;
+
+            if (meta->mask & FAN_Q_OVERFLOW)
+            {
+                func (KERNEL_MOUNT_OVERFLOW, 0, user_data);
+                continue;
+            }
+
+            mnt_id = 0;
+            info = (gchar *) meta + meta->metadata_len;
+            end = (gchar *) meta + meta->event_len;
+            while (info + sizeof (struct fanotify_event_info_header) <= end)
+            {
+                struct fanotify_event_info_header *hdr = (struct fanotify_event_info_header *) info;
+
+                if (hdr->len == 0)
+                    break;
+                if (hdr->info_type == FAN_EVENT_INFO_TYPE_MNT &&
+                    info + sizeof (struct kernel_fanotify_info_mnt) <= end)
+                    mnt_id = ((struct kernel_fanotify_info_mnt *) info)->mnt_id;
+                info += hdr->len;
+            }
+            if (mnt_id == 0)
+                continue;
+
+            if (meta->mask & FAN_MNT_DETACH)
+                func (KERNEL_MOUNT_DETACHED, mnt_id, user_data);
+            if (meta->mask & FAN_MNT_ATTACH)
+                func (KERNEL_MOUNT_ATTACHED, mnt_id, user_data);
+        }
+    }
+}
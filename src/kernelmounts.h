@@ -0,0 +1,74 @@
+#ifndef __KERNEL_MOUNTS_H__
+#define __KERNEL_MOUNTS_H__
+#include <glib.h>
+
+/* One mount as reported by statmount().  The strings are not escaped and
+ * point into the source's buffers; they stay valid until the next
+ * kernel_mount_source_stat().
+ */
+typedef struct _KernelMount KernelMount;
+struct _KernelMount
+{
+    guint64 mnt_id;
+    /* the IDs /proc/<pid>/mountinfo shows for the mount and its parent */
+    guint mountinfo_id;
+    guint mountinfo_parent_id;
+    guint major;
+    guint minor;
+    const gchar *mount_point;
+    const gchar *fstype;
+    /* NULL if the kernel doesn't report it */
+    const gchar *source;
+    /* NULL if the kernel doesn't report it */
+    const gchar *root;
+    /* put together from the mount's flags the way mountinfo shows them */
+    const gchar *options;
+    const gchar *super_options;
+    const gchar *propagation;
+};
+
+typedef enum
+{
+    KERNEL_MOUNT_ATTACHED,
+    KERNEL_MOUNT_DETACHED,
+    /* events were lost, the caller has to list all mounts again */
+    KERNEL_MOUNT_OVERFLOW
+} KernelMountEvent;
+
+typedef void (*KernelMountEventFunc) (KernelMountEvent  event,
+                                      guint64           mnt_id,
+                                      gpointer          user_data);
+
+/* Mount table access through listmount()/statmount() (Linux 6.8) with
+ * change notification through fanotify mount namespace marks (Linux 6.15),
+ * which report the IDs of the mounts that were attached or detached.
+ */
+typedef struct _KernelMountSource KernelMountSource;
+struct _KernelMountSource
+{
+    /* 0 for our own namespace */
+    guint64 mnt_ns_id;
+    int fanotify_fd;
+    gpointer buf;
+    gsize buf_size;
+    /* the strings made up by kernel_mount_source_stat(), NUL-separated */
+    GString *strings;
+};
+
+KernelMountSource *kernel_mount_source_new         (const gchar           *ns_path,
+                                                    GError               **error);
+void               kernel_mount_source_free        (KernelMountSource     *source);
+int                kernel_mount_source_get_fd      (KernelMountSource     *source);
+gboolean           kernel_mount_source_list        (KernelMountSource     *source,
+                                                    GArray                *ids,
+                                                    GError               **error);
+gboolean           kernel_mount_source_stat        (KernelMountSource     *source,
+                                                    guint64                mnt_id,
+                                                    KernelMount           *mount,
+                                                    GError               **error);
+gboolean           kernel_mount_source_read_events (KernelMountSource     *source,
+                                                    KernelMountEventFunc   func,
+                                                    gpointer               user_data,
+                                                    GError               **error);
+
+#endif
@@ -1,7 +1,125 @@
 #include "mountmonitor.h"
 #include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <glib-unix.h>
 #include "mountmonitor-glue.h"
 
+static gchar *opt_signals = NULL;
+static gchar *opt_backend = NULL;
+static gint opt_coalesce_min_ms = 0;
+static gint opt_coalesce_max_ms = 0;
+static gchar **opt_watch_pids = NULL;
+static gint opt_history_size = MOUNT_MONITOR_DEFAULT_HISTORY_SIZE;
+static gchar *opt_mountinfo = NULL;
+static gchar *opt_metrics_file = NULL;
+static gint opt_metrics_interval = 10;
+static gchar *opt_snapshot_file = NULL;
+static gint opt_snapshot_interval = 300;
+static gchar *opt_journal = NULL;
+static gint opt_journal_max_size = 16;
+static gint opt_journal_files = 4;
+
+static GOptionEntry entries[] =
+{
+    { "backend", 0, 0, G_OPTION_ARG_STRING, &opt_backend,
+      "Where mount changes come from: mountinfo, statmount or auto (default)", "BACKEND" },
+    { "signals", 0, 0, G_OPTION_ARG_STRING, &opt_signals,
+      "Mount change signals to send: per-mount, batched or both (default)", "MODE" },
+    { "coalesce-min-ms", 0, 0, G_OPTION_ARG_INT, &opt_coalesce_min_ms,
+      "Merge mountinfo changes until none arrived for MS milliseconds (default 0, off)", "MS" },
+    { "coalesce-max-ms", 0, 0, G_OPTION_ARG_INT, &opt_coalesce_max_ms,
+      "Reload at most MS milliseconds after the first merged change", "MS" },
+    { "watch-pid", 0, 0, G_OPTION_ARG_STRING_ARRAY, &opt_watch_pids,
+      "Also watch the mount namespace of PID (may be given more than once)", "PID" },
+    { "history-size", 0, 0, G_OPTION_ARG_INT, &opt_history_size,
+      "Number of changes kept for GetChangesSince (default 1024)", "N" },
+    { "mountinfo", 0, 0, G_OPTION_ARG_FILENAME, &opt_mountinfo,
+      "Read our own mounts from FILE instead of /proc/self/mountinfo (for testing)", "FILE" },
+    { "metrics-file", 0, 0, G_OPTION_ARG_FILENAME, &opt_metrics_file,
+      "Also write the metrics to FILE in Prometheus text format", "FILE" },
+    { "metrics-interval", 0, 0, G_OPTION_ARG_INT, &opt_metrics_interval,
+      "Rewrite the metrics file every SEC seconds (default 10)", "SEC" },
+    { "snapshot-file", 0, 0, G_OPTION_ARG_FILENAME, &opt_snapshot_file,
+      "Start from the device info saved in FILE, and keep it up to date", "FILE" },
+    { "snapshot-interval", 0, 0, G_OPTION_ARG_INT, &opt_snapshot_interval,
+      "Rewrite the snapshot file every SEC seconds and on exit (default 300)", "SEC" },
+    { "journal", 0, 0, G_OPTION_ARG_FILENAME, &opt_journal,
+      "Record every mount change in FILE", "FILE" },
+    { "journal-max-size", 0, 0, G_OPTION_ARG_INT, &opt_journal_max_size,
+      "Rotate the journal once it is bigger than MB megabytes (default 16)", "MB" },
+    { "journal-files", 0, 0, G_OPTION_ARG_INT, &opt_journal_files,
+      "Number of rotated journal files kept (default 4)", "N" },
+    { NULL }
+};
+
+static gboolean
+parse_signal_mode (const gchar *str, MountSignalMode *mode)
+{
+    if (str == NULL || strcmp (str, "both") == 0)
+        *mode = MOUNT_SIGNALS_PER_MOUNT | MOUNT_SIGNALS_BATCHED;
+    else if (strcmp (str, "per-mount") == 0)
+        *mode = MOUNT_SIGNALS_PER_MOUNT;
+    else if (strcmp (str, "batched") == 0)
+        *mode = MOUNT_SIGNALS_BATCHED;
+    else
+        return FALSE;
+    return TRUE;
+}
+
+static gboolean
+parse_backend (const gchar *str, MountBackend *backend)
+{
+    if (str == NULL || strcmp (str, "auto") == 0)
+        *backend = MOUNT_BACKEND_AUTO;
+    else if (strcmp (str, "mountinfo") == 0)
+        *backend = MOUNT_BACKEND_MOUNTINFO;
+    else if (strcmp (str, "statmount") == 0)
+        *backend = MOUNT_BACKEND_STATMOUNT;
+    else
+        return FALSE;
+    return TRUE;
+}
+
+/* Replaced atomically, so a collector never reads half a file */
+static gboolean
+write_metrics_file (gpointer user_data)
+{
+    MountMonitor *monitor = MOUNT_MONITOR (user_data);
+    GError *error = NULL;
+    gchar *text;
+
+    text = mount_metrics_to_prometheus (mount_monitor_get_metrics (monitor));
+    if (!g_file_set_contents (opt_metrics_file, text, -1, &error)) {
+        printf ("Cannot write metrics: %s\n", error->message);
+        g_error_free (error);
+    }
+    g_free (text);
+
+    return TRUE;
+}
+
+static gboolean
+write_snapshot_file (gpointer user_data)
+{
+    MountMonitor *monitor = MOUNT_MONITOR (user_data);
+    GError *error = NULL;
+
+    if (!mount_monitor_save_snapshot (monitor, opt_snapshot_file, &error)) {
+        printf ("Cannot write snapshot: %s\n", error->message);
+        g_error_free (error);
+    }
+
+    return TRUE;
+}
+
+static gboolean
+on_quit_signal (gpointer user_data)
+{
+    g_main_loop_quit ((GMainLoop *) user_data);
+    return TRUE;
+}
+
 int main(int argc, char **argv)
 {
     GMainLoop *mainLoop;
@@ -10,6 +128,47 @@ int main(int argc, char **argv)
     DBusGProxy *bus_proxy;
     MountMonitor *mount_monitor;
     guint request_name_result;
+    GOptionContext *context;
+    MountSignalMode signal_mode;
+    MountBackend backend;
+    guint64 ns_id;
+    gchar **pid;
+
+    context = g_option_context_new ("- monitor mount changes over D-Bus");
+    g_option_context_add_main_entries (context, entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        printf ("%s\n", error->message);
+        return 1;
+    }
+    g_option_context_free (context);
+    if (!parse_signal_mode (opt_signals, &signal_mode)) {
+        printf ("Unknown signal mode '%s'\n", opt_signals);
+        return 1;
+    }
+    if (!parse_backend (opt_backend, &backend)) {
+        printf ("Unknown backend '%s'\n", opt_backend);
+        return 1;
+    }
+    if (opt_coalesce_min_ms < 0 || opt_coalesce_max_ms < 0) {
+        printf ("Coalescing intervals can't be negative\n");
+        return 1;
+    }
+    if (opt_history_size < 1) {
+        printf ("History size must be at least 1\n");
+        return 1;
+    }
+    if (opt_metrics_interval < 1) {
+        printf ("Metrics interval must be at least 1 second\n");
+        return 1;
+    }
+    if (opt_snapshot_interval < 1) {
+        printf ("Snapshot interval must be at least 1 second\n");
+        return 1;
+    }
+    if (opt_journal_max_size < 1 || opt_journal_files < 0) {
+        printf ("Journal size must be at least 1 MB, and the number of files can't be negative\n");
+        return 1;
+    }
 
     dbus_g_object_type_install_info(MOUNT_MONITOR_TYPE, &dbus_glib_mountmonitor_object_info);
     mainLoop = g_main_loop_new(NULL, FALSE);
@@ -29,10 +188,42 @@ int main(int argc, char **argv)
         return 1;
     }
     // new object
-    mount_monitor = mount_monitor_new();
-    dbus_g_connection_register_g_object(bus, "/org/freedesktop/MountMonitor", G_OBJECT(mount_monitor));
-    printf ("MountMonitor server is running\n");
+    mount_monitor = mount_monitor_new(backend, opt_mountinfo);
+    mount_monitor_set_signal_mode(mount_monitor, signal_mode);
+    mount_monitor_set_history_size(mount_monitor, opt_history_size);
+    mount_monitor_set_coalescing(mount_monitor, opt_coalesce_min_ms, opt_coalesce_max_ms);
+    if (opt_snapshot_file != NULL)
+        mount_monitor_load_snapshot(mount_monitor, opt_snapshot_file);
+    for (pid = opt_watch_pids; pid != NULL && *pid != NULL; pid++) {
+        guint64 pid_num;
+
+        if (!g_ascii_string_to_unsigned (*pid, 10, 1, G_MAXUINT, &pid_num, &error) ||
+            !mount_monitor_watch_namespace (mount_monitor, pid_num, &ns_id, &error)) {
+            printf ("Cannot watch pid %s: %s\n", *pid, error->message);
+            return 1;
+        }
+        printf ("Watching mount namespace %" G_GUINT64_FORMAT " of pid %s\n", ns_id, *pid);
+    }
+    if (opt_journal != NULL &&
+        !mount_monitor_set_journal (mount_monitor, opt_journal,
+                                    (guint64) opt_journal_max_size * 1024 * 1024,
+                                    opt_journal_files, &error)) {
+        printf ("%s\n", error->message);
+        return 1;
+    }
+    mount_monitor_set_connection(mount_monitor, bus);
+    dbus_g_connection_register_g_object(bus, MOUNT_MONITOR_OBJECT_PATH, G_OBJECT(mount_monitor));
+    if (opt_metrics_file != NULL)
+        g_timeout_add_seconds (opt_metrics_interval, write_metrics_file, mount_monitor);
+    if (opt_snapshot_file != NULL)
+        g_timeout_add_seconds (opt_snapshot_interval, write_snapshot_file, mount_monitor);
+    g_unix_signal_add (SIGTERM, on_quit_signal, mainLoop);
+    g_unix_signal_add (SIGINT, on_quit_signal, mainLoop);
+    printf ("MountMonitor server is running (%s backend)\n",
+            mount_monitor_get_backend(mount_monitor) == MOUNT_BACKEND_STATMOUNT ? "statmount" : "mountinfo");
     g_main_loop_run(mainLoop);
+    if (opt_snapshot_file != NULL)
+        write_snapshot_file (mount_monitor);
     g_object_unref(bus_proxy);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "metrics.h"
+
+#define COUNTER(field, help) \
+    { #field, help, MOUNT_METRIC_COUNTER, G_STRUCT_OFFSET (MountMetrics, field) }
+#define GAUGE(field, help) \
+    { #field, help, MOUNT_METRIC_GAUGE, G_STRUCT_OFFSET (MountMetrics, field) }
+#define HISTOGRAM(field, help) \
+    { #field, help, MOUNT_METRIC_HISTOGRAM, G_STRUCT_OFFSET (MountMetrics, field) }
+
+/* The names are the field names; "_" becomes "-" in property names */
+const MountMetricInfo mount_metrics_info[] =
+{
+    COUNTER (reloads, "Scans of mountinfo and /proc/swaps"),
+    COUNTER (unchanged_reloads, "Scans that found the file unchanged"),
+    COUNTER (bytes_read, "Bytes read from mountinfo and /proc/swaps"),
+    COUNTER (lines_scanned, "Lines fingerprinted by the scans"),
+    COUNTER (lines_parsed, "Lines not seen before that had to be parsed"),
+    HISTOGRAM (read_time, "Time spent reading the file per scan"),
+    HISTOGRAM (parse_time, "Time spent parsing new lines per scan"),
+    HISTOGRAM (diff_time, "Time spent matching known lines and retiring old ones per scan"),
+    COUNTER (kernel_events, "Batches of statmount backend mount events"),
+    COUNTER (coalesced_events, "Change notifications merged into a later scan"),
+    GAUGE (records, "Tracked mountinfo lines, swaps and kernel mounts"),
+    GAUGE (mounts, "Mounts and swaps in the tables"),
+    COUNTER (udisks_lookups, "Device info lookups in the UDisks objects"),
+    COUNTER (udisks_misses, "Lookups that found no block or drive object"),
+    COUNTER (udisks_cache_hits, "Lookups answered from the device cache"),
+    HISTOGRAM (udisks_lookup_time, "Time per device info lookup"),
+    COUNTER (unresolved_removals, "Removed mounts that had no device info to announce"),
+    COUNTER (mount_added_signals, "MountAdded signals sent"),
+    COUNTER (mount_removed_signals, "MountRemoved signals sent"),
+    COUNTER (mounts_changed_signals, "MountsChanged signals sent"),
+    COUNTER (swap_added_signals, "SwapAdded signals sent"),
+    COUNTER (swap_removed_signals, "SwapRemoved signals sent"),
+    COUNTER (mount_event_signals, "MountEvent signals sent to subscribers"),
+    COUNTER (mount_changed_signals, "MountChanged signals sent"),
+};
+
+const guint mount_metrics_n_info = G_N_ELEMENTS (mount_metrics_info);
+
+MountMetrics *
+mount_metrics_new (void)
+{
+    return g_new0 (MountMetrics, 1);
+}
+
+void
+mount_metrics_free (MountMetrics *metrics)
+{
+    g_free (metrics);
+}
+
+/* Copies what the worker counts, see MountMetrics */
+void
+mount_metrics_copy_scans (MountMetrics       *dest,
+                          const MountMetrics *src)
+{
+    dest->reloads = src->reloads;
+    dest->unchanged_reloads = src->unchanged_reloads;
+    dest->bytes_read = src->bytes_read;
+    dest->lines_scanned = src->lines_scanned;
+    dest->lines_parsed = src->lines_parsed;
+    dest->read_time = src->read_time;
+    dest->parse_time = src->parse_time;
+    dest->diff_time = src->diff_time;
+    dest->kernel_events = src->kernel_events;
+    dest->coalesced_events = src->coalesced_events;
+    dest->records = src->records;
+}
+
+/* The layout of the histogram D-Bus properties:
+ * [count, sum in ns, bucket 0, ..., bucket MOUNT_HISTOGRAM_BUCKETS - 1]
+ */
+GArray *
+mount_histogram_to_array (const MountHistogram *hist)
+{
+    GArray *array;
+
+    array = g_array_sized_new (FALSE, FALSE, sizeof (guint64), MOUNT_HISTOGRAM_BUCKETS + 2);
+    g_array_append_val (array, hist->count);
+    g_array_append_val (array, hist->sum_ns);
+    g_array_append_vals (array, hist->buckets, MOUNT_HISTOGRAM_BUCKETS);
+
+    return array;
+}
+
+static void
+append_histogram (GString              *out,
+                  const gchar          *name,
+                  const MountHistogram *hist)
+{
+    guint64 cumulative;
+    guint n;
+
+    cumulative = 0;
+    for (n = 0; n < MOUNT_HISTOGRAM_BUCKETS - 1; n++)
+    {
+        cumulative += hist->buckets[n];
+        g_string_append_printf (out, "%s_bucket{le=\"%g\"} %" G_GUINT64_FORMAT "\n",
+                                name, (gdouble) (G_GUINT64_CONSTANT (1) << n) / 1e6, cumulative);
+    }
+    g_string_append_printf (out, "%s_bucket{le=\"+Inf\"} %" G_GUINT64_FORMAT "\n", name, hist->count);
+    g_string_append_printf (out, "%s_sum %.9f\n", name, hist->sum_ns / 1e9);
+    g_string_append_printf (out, "%s_count %" G_GUINT64_FORMAT "\n", name, hist->count);
+}
+
+/* Everything in the Prometheus text exposition format, as read by the
+ * node exporter's textfile collector.  Counters get a _total suffix and
+ * histograms are in seconds.
+ */
+gchar *
+mount_metrics_to_prometheus (MountMetrics *metrics)
+{
+    GString *out;
+    guint n;
+
+    out = g_string_new (NULL);
+    for (n = 0; n < mount_metrics_n_info; n++)
+    {
+        const MountMetricInfo *info = &mount_metrics_info[n];
+        gchar *name;
+
+        switch (info->kind)
+        {
+        case MOUNT_METRIC_COUNTER:
+            name = g_strdup_printf ("mountmonitor_%s_total", info->name);
+            g_string_append_printf (out, "# HELP %s %s\n# TYPE %s counter\n%s %" G_GUINT64_FORMAT "\n",
+                                    name, info->help, name, name,
+                                    MOUNT_METRIC_COUNTER_VALUE (metrics, info));
+            break;
+        case MOUNT_METRIC_GAUGE:
+            name = g_strdup_printf ("mountmonitor_%s", info->name);
+            g_string_append_printf (out, "# HELP %s %s\n# TYPE %s gauge\n%s %" G_GUINT64_FORMAT "\n",
+                                    name, info->help, name, name,
+                                    MOUNT_METRIC_COUNTER_VALUE (metrics, info));
+            break;
+        default:
+            name = g_strdup_printf ("mountmonitor_%s_seconds", info->name);
+            g_string_append_printf (out, "# HELP %s %s\n# TYPE %s histogram\n",
+                                    name, info->help, name);
+            append_histogram (out, name, MOUNT_METRIC_HISTOGRAM_VALUE (metrics, info));
+            break;
+        }
+        g_free (name);
+    }
+
+    return g_string_free (out, FALSE);
+}
@@ -0,0 +1,123 @@
+#ifndef __MOUNT_METRICS_H__
+#define __MOUNT_METRICS_H__
+#include <glib.h>
+#include <time.h>
+
+/* Bucket n of a histogram counts durations of less than 2^n microseconds
+ * that no earlier bucket counts; the last one takes everything longer.
+ */
+#define MOUNT_HISTOGRAM_BUCKETS 24
+
+typedef struct _MountHistogram MountHistogram;
+struct _MountHistogram
+{
+    guint64 buckets[MOUNT_HISTOGRAM_BUCKETS];
+    guint64 count;
+    guint64 sum_ns;
+};
+
+/* Counters and latency histograms of the hot paths.  They are plain
+ * integers, cheap enough to be always on, so each MountMetrics is only
+ * ever touched by one thread: the worker counts its scans in one of its
+ * own, which the main thread copies into the monitor's under a lock when
+ * it reads them, see mount_worker_collect_metrics().  A NULL MountMetrics
+ * is accepted everywhere and records nothing.
+ */
+typedef struct _MountMetrics MountMetrics;
+struct _MountMetrics
+{
+    /* mountinfo and /proc/swaps scans, counted by the worker */
+    guint64 reloads;
+    guint64 unchanged_reloads;
+    guint64 bytes_read;
+    guint64 lines_scanned;
+    guint64 lines_parsed;
+    MountHistogram read_time;
+    MountHistogram parse_time;
+    MountHistogram diff_time;
+
+    /* statmount backend */
+    guint64 kernel_events;
+    /* change notifications merged into a later reload */
+    guint64 coalesced_events;
+
+    /* gauges, brought up to date before they are read; records by the
+     * worker, mounts by the main thread */
+    guint64 records;
+    guint64 mounts;
+
+    /* from here on only the main thread counts */
+    guint64 udisks_lookups;
+    guint64 udisks_misses;
+    guint64 udisks_cache_hits;
+    MountHistogram udisks_lookup_time;
+    /* removed mounts that had no device info, so no signal went out */
+    guint64 unresolved_removals;
+
+    guint64 mount_added_signals;
+    guint64 mount_removed_signals;
+    guint64 mounts_changed_signals;
+    guint64 swap_added_signals;
+    guint64 swap_removed_signals;
+    guint64 mount_event_signals;
+    guint64 mount_changed_signals;
+};
+
+typedef enum
+{
+    MOUNT_METRIC_COUNTER,
+    MOUNT_METRIC_GAUGE,
+    MOUNT_METRIC_HISTOGRAM
+} MountMetricKind;
+
+/* Describes one field of MountMetrics.  name is the field name, from which
+ * the property and Prometheus metric names are derived.
+ */
+typedef struct _MountMetricInfo MountMetricInfo;
+struct _MountMetricInfo
+{
+    const gchar *name;
+    const gchar *help;
+    MountMetricKind kind;
+    gsize offset;
+};
+
+extern const MountMetricInfo mount_metrics_info[];
+extern const guint mount_metrics_n_info;
+
+#define MOUNT_METRIC_COUNTER_VALUE(metrics, info) \
+    (*(guint64 *) ((guint8 *) (metrics) + (info)->offset))
+#define MOUNT_METRIC_HISTOGRAM_VALUE(metrics, info) \
+    ((MountHistogram *) ((guint8 *) (metrics) + (info)->offset))
+
+static inline gint64
+mount_metrics_now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline void
+mount_histogram_add (MountHistogram *hist,
+                     gint64          ns)
+{
+    gulong usec;
+    guint bucket;
+
+    usec = ns > 0 ? ns / 1000 : 0;
+    bucket = usec != 0 ? g_bit_storage (usec) : 0;
+    hist->buckets[MIN (bucket, MOUNT_HISTOGRAM_BUCKETS - 1)]++;
+    hist->count++;
+    hist->sum_ns += MAX (ns, 0);
+}
+
+MountMetrics *mount_metrics_new              (void);
+void          mount_metrics_free             (MountMetrics   *metrics);
+void          mount_metrics_copy_scans       (MountMetrics   *dest,
+                                              const MountMetrics *src);
+GArray       *mount_histogram_to_array       (const MountHistogram *hist);
+gchar        *mount_metrics_to_prometheus    (MountMetrics   *metrics);
+
+#endif
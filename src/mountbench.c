@@ -0,0 +1,612 @@
+/* Benchmark of the mountinfo scan and diff path.
+ *
+ * A synthetic mountinfo table is written to a temporary file and a
+ * MountNamespace is pointed at it.  Every scenario edits the table, rewrites
+ * the file in place and times mount_namespace_reload(), which reads, diffs
+ * and reports the changes exactly as on a /proc change notification.  For
+ * each scenario the latency percentiles, the heap allocations per reload
+ * and the peak RSS are reported.
+ */
+#include "mountnamespace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static gint opt_mounts = 1000;
+static gdouble opt_escape_density = 0.05;
+static gdouble opt_btrfs_share = 0.1;
+static gint opt_bulk = 100;
+static gint opt_churn = 10;
+static gint opt_iterations = 200;
+static gint opt_seed = 1;
+static gchar *opt_btrfs_device = NULL;
+static gchar **opt_scenarios = NULL;
+
+static GOptionEntry entries[] =
+{
+    { "mounts", 'n', 0, G_OPTION_ARG_INT, &opt_mounts,
+      "Mounts in the base table (default 1000)", "N" },
+    { "escape-density", 0, 0, G_OPTION_ARG_DOUBLE, &opt_escape_density,
+      "Share of mount points with escaped characters (default 0.05)", "D" },
+    { "btrfs-share", 0, 0, G_OPTION_ARG_DOUBLE, &opt_btrfs_share,
+      "Share of btrfs mounts, which need their source resolved (default 0.1)", "S" },
+    { "bulk", 0, 0, G_OPTION_ARG_INT, &opt_bulk,
+      "Mounts added or removed at once by the bulk scenarios (default 100)", "K" },
+    { "churn", 0, 0, G_OPTION_ARG_INT, &opt_churn,
+      "Mounts replaced per reload by the churn scenario (default 10)", "C" },
+    { "iterations", 'i', 0, G_OPTION_ARG_INT, &opt_iterations,
+      "Timed reloads per scenario (default 200)", "I" },
+    { "seed", 0, 0, G_OPTION_ARG_INT, &opt_seed,
+      "Seed of the table generator (default 1)", "SEED" },
+    { "btrfs-device", 0, 0, G_OPTION_ARG_FILENAME, &opt_btrfs_device,
+      "Block device given as source of the btrfs mounts (default: first one found)", "PATH" },
+    { "scenario", 's', 0, G_OPTION_ARG_STRING_ARRAY, &opt_scenarios,
+      "Run only this scenario (may be given more than once)", "NAME" },
+    { NULL }
+};
+
+/* Allocation counting.  Defining the allocator in the executable catches
+ * every malloc() made through the PLT, GLib's included.
+ */
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static guint64 n_allocs;
+static guint64 n_alloc_bytes;
+
+void *
+malloc (size_t size)
+{
+    __atomic_add_fetch (&n_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch (&n_alloc_bytes, size, __ATOMIC_RELAXED);
+    return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb,
+        size_t size)
+{
+    __atomic_add_fetch (&n_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch (&n_alloc_bytes, nmemb * size, __ATOMIC_RELAXED);
+    return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void   *ptr,
+         size_t  size)
+{
+    __atomic_add_fetch (&n_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch (&n_alloc_bytes, size, __ATOMIC_RELAXED);
+    return __libc_realloc (ptr, size);
+}
+
+/* The synthetic table: one mountinfo line per entry, in file order */
+typedef struct _BenchTable BenchTable;
+struct _BenchTable
+{
+    GPtrArray *lines;
+    GRand *rand;
+    guint next_id;
+    const gchar *btrfs_device;
+    gchar *path;
+    GString *contents;
+};
+
+/* Paths like /srv/vol123/data, some with an escaped space, tab or backslash */
+static gchar *
+bench_table_new_line (BenchTable *table)
+{
+    const gchar *escapes[] = { "\\040", "\\011", "\\134" };
+    GString *mount_point;
+    gchar *line;
+    guint id;
+
+    id = table->next_id++;
+    mount_point = g_string_new (NULL);
+    g_string_append_printf (mount_point, "/srv/vol%u", id);
+    if (g_rand_double (table->rand) < opt_escape_density)
+        g_string_append_printf (mount_point, "/my%sdata",
+                                escapes[g_rand_int_range (table->rand, 0, G_N_ELEMENTS (escapes))]);
+    else
+        g_string_append (mount_point, "/data");
+
+    if (table->btrfs_device != NULL && g_rand_double (table->rand) < opt_btrfs_share)
+        line = g_strdup_printf ("%u 1 0:%u /@vol%u %s rw,relatime shared:%u - btrfs %s rw,space_cache=v2\n",
+                                id, 40 + id % 1000, id, mount_point->str, id,
+                                table->btrfs_device);
+    else
+        line = g_strdup_printf ("%u 1 %u:%u / %s rw,relatime shared:%u - ext4 /dev/sd%c%u rw\n",
+                                id, 8 + (id >> 20) % 4, id & 0xfffff, mount_point->str, id,
+                                'a' + id % 26, id % 16);
+    g_string_free (mount_point, TRUE);
+
+    return line;
+}
+
+static gboolean
+bench_table_write (BenchTable  *table,
+                   GError     **error)
+{
+    guint n;
+    gssize written;
+    int fd;
+
+    g_string_truncate (table->contents, 0);
+    for (n = 0; n < table->lines->len; n++)
+        g_string_append (table->contents, g_ptr_array_index (table->lines, n));
+
+    /* in place, the namespace keeps reading through the fd it opened */
+    fd = open (table->path, O_WRONLY | O_TRUNC | O_CLOEXEC);
+    if (fd < 0)
+    {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                     "Error opening %s: %s", table->path, g_strerror (errno));
+        return FALSE;
+    }
+    written = write (fd, table->contents->str, table->contents->len);
+    if (written != (gssize) table->contents->len)
+    {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                     "Error writing %s: %s", table->path, g_strerror (errno));
+        close (fd);
+        return FALSE;
+    }
+    close (fd);
+
+    return TRUE;
+}
+
+static void
+bench_table_add (BenchTable *table,
+                 guint       n)
+{
+    while (n-- > 0)
+        g_ptr_array_add (table->lines, bench_table_new_line (table));
+}
+
+/* Removes n lines spread over the table, not just the newest ones */
+static void
+bench_table_remove (BenchTable *table,
+                    guint       n)
+{
+    while (n-- > 0 && table->lines->len > 0)
+        g_free (g_ptr_array_remove_index (table->lines,
+                                          g_rand_int_range (table->rand, 0, table->lines->len)));
+}
+
+static void
+bench_table_reset (BenchTable *table)
+{
+    g_ptr_array_set_size (table->lines, 0);
+    bench_table_add (table, opt_mounts);
+}
+
+/* btrfs mounts are only tracked if their source is a block device */
+static const gchar *
+find_block_device (void)
+{
+    const gchar *candidates[] = { "/dev/loop0", "/dev/sda", "/dev/vda", "/dev/nvme0n1", "/dev/xvda" };
+    struct stat statbuf;
+    guint n;
+
+    for (n = 0; n < G_N_ELEMENTS (candidates); n++)
+    {
+        if (stat (candidates[n], &statbuf) == 0 && S_ISBLK (statbuf.st_mode))
+            return candidates[n];
+    }
+
+    return NULL;
+}
+
+typedef struct _BenchResult BenchResult;
+struct _BenchResult
+{
+    GArray *latencies_ns;
+    guint64 allocs;
+    guint64 alloc_bytes;
+    guint64 added;
+    guint64 removed;
+};
+
+static void
+on_changed (MountNamespace *ns,
+            GList          *added,
+            GList          *removed,
+            GList          *changed,
+            gpointer        user_data)
+{
+    BenchResult *result = user_data;
+
+    if (result != NULL)
+    {
+        result->added += g_list_length (added);
+        result->removed += g_list_length (removed);
+    }
+    g_list_free (added);
+    g_list_free_full (removed, (GDestroyNotify) mount_info_unref);
+    g_list_free_full (changed, (GDestroyNotify) mount_change_free);
+}
+
+static gint64
+now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Times one reload after the table was written */
+static void
+timed_reload (MountNamespace *ns,
+              BenchResult    *result)
+{
+    guint64 allocs;
+    guint64 bytes;
+    gint64 start;
+    gint64 elapsed;
+
+    allocs = n_allocs;
+    bytes = n_alloc_bytes;
+    start = now_ns ();
+    ns->user_data = result;
+    mount_namespace_reload (ns);
+    ns->user_data = NULL;
+    elapsed = now_ns () - start;
+
+    g_array_append_val (result->latencies_ns, elapsed);
+    result->allocs += n_allocs - allocs;
+    result->alloc_bytes += n_alloc_bytes - bytes;
+}
+
+/* Untimed reload to bring the namespace back to the table's state */
+static void
+untimed_reload (MountNamespace *ns)
+{
+    ns->user_data = NULL;
+    mount_namespace_reload (ns);
+}
+
+/* Peak RSS is reset before every scenario (Linux 4.0+), so VmHWM is the
+ * scenario's own peak
+ */
+static void
+reset_peak_rss (void)
+{
+    int fd;
+
+    fd = open ("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    if (write (fd, "5", 1) != 1)
+        printf ("Error resetting peak RSS: %s\n", g_strerror (errno));
+    close (fd);
+}
+
+static glong
+get_peak_rss_kb (void)
+{
+    gchar *contents;
+    gchar *hwm;
+    glong kb;
+
+    if (!g_file_get_contents ("/proc/self/status", &contents, NULL, NULL))
+        return -1;
+    hwm = strstr (contents, "VmHWM:");
+    kb = hwm != NULL ? strtol (hwm + strlen ("VmHWM:"), NULL, 10) : -1;
+    g_free (contents);
+
+    return kb;
+}
+
+static gint
+compare_int64 (gconstpointer a,
+               gconstpointer b)
+{
+    gint64 x = *(const gint64 *) a;
+    gint64 y = *(const gint64 *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static gdouble
+percentile_us (GArray  *sorted,
+               gdouble  p)
+{
+    guint idx;
+
+    idx = (guint) (p * (sorted->len - 1) + 0.5);
+    return g_array_index (sorted, gint64, idx) / 1000.0;
+}
+
+static void
+report (const gchar *name,
+        BenchResult *result,
+        glong        peak_rss_kb)
+{
+    GArray *sorted = result->latencies_ns;
+    guint n = sorted->len;
+
+    if (n == 0)
+        return;
+
+    g_array_sort (sorted, compare_int64);
+    printf ("%-12s %6u %9.1f %9.1f %9.1f %9.1f %10.1f %12.1f %8.1f %8.1f %9ld\n",
+            name, n,
+            percentile_us (sorted, 0.50), percentile_us (sorted, 0.90),
+            percentile_us (sorted, 0.99), g_array_index (sorted, gint64, n - 1) / 1000.0,
+            (gdouble) result->allocs / n, (gdouble) result->alloc_bytes / n,
+            (gdouble) result->added / n, (gdouble) result->removed / n,
+            peak_rss_kb);
+}
+
+typedef void (*BenchScenarioFunc) (BenchTable     *table,
+                                   MountNamespace *ns,
+                                   BenchResult    *result,
+                                   GError        **error);
+
+/* Nothing changed: only the read and the whole-file comparison */
+static void
+scenario_unchanged (BenchTable     *table,
+                    MountNamespace *ns,
+                    BenchResult    *result,
+                    GError        **error)
+{
+    gint i;
+
+    for (i = 0; i < opt_iterations; i++)
+        timed_reload (ns, result);
+}
+
+static void
+scenario_single_add (BenchTable     *table,
+                     MountNamespace *ns,
+                     BenchResult    *result,
+                     GError        **error)
+{
+    gint i;
+
+    for (i = 0; i < opt_iterations; i++)
+    {
+        bench_table_add (table, 1);
+        if (!bench_table_write (table, error))
+            return;
+        timed_reload (ns, result);
+
+        g_free (g_ptr_array_remove_index (table->lines, table->lines->len - 1));
+        if (!bench_table_write (table, error))
+            return;
+        untimed_reload (ns);
+    }
+}
+
+static void
+scenario_bulk_add (BenchTable     *table,
+                   MountNamespace *ns,
+                   BenchResult    *result,
+                   GError        **error)
+{
+    gint i;
+
+    for (i = 0; i < opt_iterations; i++)
+    {
+        bench_table_add (table, opt_bulk);
+        if (!bench_table_write (table, error))
+            return;
+        timed_reload (ns, result);
+
+        g_ptr_array_remove_range (table->lines, table->lines->len - opt_bulk, opt_bulk);
+        if (!bench_table_write (table, error))
+            return;
+        untimed_reload (ns);
+    }
+}
+
+static void
+scenario_bulk_remove (BenchTable     *table,
+                      MountNamespace *ns,
+                      BenchResult    *result,
+                      GError        **error)
+{
+    gint i;
+
+    for (i = 0; i < opt_iterations; i++)
+    {
+        bench_table_remove (table, opt_bulk);
+        if (!bench_table_write (table, error))
+            return;
+        timed_reload (ns, result);
+
+        bench_table_add (table, opt_bulk);
+        if (!bench_table_write (table, error))
+            return;
+        untimed_reload (ns);
+    }
+}
+
+/* Steady replacement of a few mounts per reload, e.g. container churn */
+static void
+scenario_churn (BenchTable     *table,
+                MountNamespace *ns,
+                BenchResult    *result,
+                GError        **error)
+{
+    gint i;
+
+    for (i = 0; i < opt_iterations; i++)
+    {
+        bench_table_remove (table, opt_churn);
+        bench_table_add (table, opt_churn);
+        if (!bench_table_write (table, error))
+            return;
+        timed_reload (ns, result);
+    }
+}
+
+static const struct
+{
+    const gchar *name;
+    BenchScenarioFunc func;
+} scenarios[] =
+{
+    { "unchanged", scenario_unchanged },
+    { "single-add", scenario_single_add },
+    { "bulk-add", scenario_bulk_add },
+    { "bulk-remove", scenario_bulk_remove },
+    { "churn", scenario_churn },
+};
+
+/* The initial load of a whole table, as when a namespace is first watched */
+static gboolean
+run_cold_load (BenchTable   *table,
+               MountParser  *parser,
+               GError      **error)
+{
+    BenchResult result = { 0 };
+    gint i;
+
+    result.latencies_ns = g_array_new (FALSE, FALSE, sizeof (gint64));
+    reset_peak_rss ();
+    for (i = 0; i < opt_iterations; i++)
+    {
+        MountNamespace *ns;
+        guint64 allocs = n_allocs;
+        guint64 bytes = n_alloc_bytes;
+        gint64 start = now_ns ();
+        gint64 elapsed;
+
+        ns = mount_namespace_new_for_file (table->path, parser, on_changed, NULL, error);
+        if (ns == NULL)
+        {
+            g_array_free (result.latencies_ns, TRUE);
+            return FALSE;
+        }
+        elapsed = now_ns () - start;
+        result.allocs += n_allocs - allocs;
+        result.alloc_bytes += n_alloc_bytes - bytes;
+        result.added += g_hash_table_size (ns->mounts);
+        g_array_append_val (result.latencies_ns, elapsed);
+        mount_namespace_free (ns);
+    }
+    report ("cold-load", &result, get_peak_rss_kb ());
+    g_array_free (result.latencies_ns, TRUE);
+
+    return TRUE;
+}
+
+static gboolean
+scenario_selected (const gchar *name)
+{
+    return opt_scenarios == NULL || g_strv_contains ((const gchar * const *) opt_scenarios, name);
+}
+
+int
+main (int argc, char **argv)
+{
+    GOptionContext *context;
+    GError *error = NULL;
+    MountParser *parser;
+    BenchTable table = { 0 };
+    gint fd;
+    guint n;
+    int ret = 1;
+
+    context = g_option_context_new ("- benchmark mountinfo scans with synthetic tables");
+    g_option_context_add_main_entries (context, entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+        printf ("%s\n", error->message);
+        return 1;
+    }
+    g_option_context_free (context);
+    if (opt_mounts < 1 || opt_iterations < 1 || opt_bulk < 0 || opt_churn < 0 ||
+        opt_bulk > opt_mounts || opt_churn > opt_mounts)
+    {
+        printf ("Mount, iteration, bulk and churn counts must be positive, bulk and churn at most --mounts\n");
+        return 1;
+    }
+
+    table.lines = g_ptr_array_new_with_free_func (g_free);
+    table.rand = g_rand_new_with_seed (opt_seed);
+    table.next_id = 100;
+    table.contents = g_string_new (NULL);
+    table.btrfs_device = opt_btrfs_device != NULL ? opt_btrfs_device : find_block_device ();
+    if (table.btrfs_device == NULL && opt_btrfs_share > 0)
+        printf ("No block device found for the btrfs mounts, generating none\n");
+
+    fd = g_file_open_tmp ("mountbench-XXXXXX", &table.path, &error);
+    if (fd < 0)
+    {
+        printf ("%s\n", error->message);
+        goto out;
+    }
+    close (fd);
+
+    parser = mount_parser_new ();
+
+    printf ("%d mounts, escape density %.2f, btrfs share %.2f (%s), bulk %d, churn %d, %d iterations\n",
+            opt_mounts, opt_escape_density, opt_btrfs_share,
+            table.btrfs_device != NULL ? table.btrfs_device : "none",
+            opt_bulk, opt_churn, opt_iterations);
+    printf ("%-12s %6s %9s %9s %9s %9s %10s %12s %8s %8s %9s\n",
+            "scenario", "n", "p50 us", "p90 us", "p99 us", "max us",
+            "allocs", "alloc B", "added", "removed", "peak KiB");
+
+    bench_table_reset (&table);
+    if (!bench_table_write (&table, &error))
+        goto out_parser;
+    if (scenario_selected ("cold-load") && !run_cold_load (&table, parser, &error))
+        goto out_parser;
+
+    for (n = 0; n < G_N_ELEMENTS (scenarios); n++)
+    {
+        MountNamespace *ns;
+        BenchResult result = { 0 };
+
+        if (!scenario_selected (scenarios[n].name))
+            continue;
+
+        /* every scenario starts from the same table */
+        g_rand_set_seed (table.rand, opt_seed);
+        table.next_id = 100;
+        bench_table_reset (&table);
+        if (!bench_table_write (&table, &error))
+            goto out_parser;
+        ns = mount_namespace_new_for_file (table.path, parser, on_changed, NULL, &error);
+        if (ns == NULL)
+            goto out_parser;
+
+        result.latencies_ns = g_array_new (FALSE, FALSE, sizeof (gint64));
+        reset_peak_rss ();
+        scenarios[n].func (&table, ns, &result, &error);
+        if (error == NULL)
+            report (scenarios[n].name, &result, get_peak_rss_kb ());
+        g_array_free (result.latencies_ns, TRUE);
+        mount_namespace_free (ns);
+        if (error != NULL)
+            goto out_parser;
+    }
+    ret = 0;
+
+out_parser:
+    mount_parser_free (parser);
+    unlink (table.path);
+out:
+    if (error != NULL)
+    {
+        printf ("%s\n", error->message);
+        g_error_free (error);
+    }
+    g_free (table.path);
+    g_string_free (table.contents, TRUE);
+    g_rand_free (table.rand);
+    g_ptr_array_unref (table.lines);
+
+    return ret;
+}
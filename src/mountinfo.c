@@ -1,45 +1,150 @@
 #include "mountinfo.h"
+#include "arena.h"
+#include "stringpool.h"
 
-G_DEFINE_TYPE (MountInfo, mount_info, G_TYPE_OBJECT);
+/* Mounts per arena chunk */
+#define MOUNT_ARENA_CHUNK 1024
 
-static void
-mount_info_init (MountInfo *mount)
+G_DEFINE_BOXED_TYPE (MountInfo, mount_info, mount_info_ref, mount_info_unref)
+
+G_STATIC_ASSERT (G_STRUCT_OFFSET (MountInfo, dev) == G_STRUCT_OFFSET (MountKey, dev));
+G_STATIC_ASSERT (G_STRUCT_OFFSET (MountInfo, mount_path) == G_STRUCT_OFFSET (MountKey, mount_path));
+
+/* shared by the mounts of all namespaces; mounts are created on the
+ * worker thread and may be released on the main thread */
+G_LOCK_DEFINE_STATIC (mount_arena);
+static MountArena *mount_arena = NULL;
+static StringPool *mount_strings = NULL;
+
+MountInfo *
+_mount_info_new (dev_t dev,
+                   const gchar *mount_path,
+                   MountType type,
+                   const MountDetails *details)
 {
+    MountInfo *mount;
+
+    G_LOCK (mount_arena);
+    if (mount_arena == NULL)
+    {
+        mount_arena = mount_arena_new (sizeof (MountInfo), MOUNT_ARENA_CHUNK);
+        mount_strings = string_pool_new ();
+    }
+
+    mount = mount_arena_alloc0 (mount_arena);
+    mount->ref_count = 1;
+    mount->dev = dev;
+    mount->mount_path = string_pool_intern (mount_strings, mount_path);
+    mount->fstype = string_pool_intern (mount_strings, details->fstype);
+    mount->source = string_pool_intern (mount_strings, details->source);
+    mount->root = string_pool_intern (mount_strings, details->root);
+    mount->options = string_pool_intern (mount_strings, details->options);
+    mount->super_options = string_pool_intern (mount_strings, details->super_options);
+    mount->propagation = string_pool_intern (mount_strings, details->propagation);
+    G_UNLOCK (mount_arena);
+    mount->mount_id = details->mount_id;
+    mount->parent_id = details->parent_id;
+    mount->unique_id = details->unique_id;
+    mount->type = type;
+
+    return mount;
 }
 
-static void
-mount_info_finalize (GObject *object)
+MountInfo *
+mount_info_ref (MountInfo *mount)
 {
-    MountInfo *mount = MOUNT_INFO (object);
+    g_return_val_if_fail (mount != NULL, NULL);
+
+    g_atomic_int_inc (&mount->ref_count);
+    return mount;
+}
 
-    g_free (mount->mount_path);
+void
+mount_info_unref (MountInfo *mount)
+{
+    g_return_if_fail (mount != NULL);
+
+    if (!g_atomic_int_dec_and_test (&mount->ref_count))
+        return;
+
+    G_LOCK (mount_arena);
+    string_pool_release (mount_strings, mount->mount_path);
+    string_pool_release (mount_strings, mount->fstype);
+    string_pool_release (mount_strings, mount->source);
+    string_pool_release (mount_strings, mount->root);
+    string_pool_release (mount_strings, mount->options);
+    string_pool_release (mount_strings, mount->super_options);
+    string_pool_release (mount_strings, mount->propagation);
+    mount_arena_release (mount_arena, mount);
+    G_UNLOCK (mount_arena);
+}
 
-    if (G_OBJECT_CLASS (mount_info_parent_class)->finalize)
-        G_OBJECT_CLASS (mount_info_parent_class)->finalize (object);
+/* The fields in which other_mount differs from mount.  Both have their
+ * strings from the same pool, so they are compared by pointer.
+ */
+MountChangedFields
+mount_info_diff (MountInfo *mount,
+                 MountInfo *other_mount)
+{
+    MountChangedFields fields = 0;
+
+    if (mount->mount_path != other_mount->mount_path)
+        fields |= MOUNT_CHANGED_PATH;
+    if (mount->parent_id != other_mount->parent_id)
+        fields |= MOUNT_CHANGED_PARENT;
+    if (mount->root != other_mount->root)
+        fields |= MOUNT_CHANGED_ROOT;
+    if (mount->options != other_mount->options)
+        fields |= MOUNT_CHANGED_OPTIONS;
+    if (mount->super_options != other_mount->super_options)
+        fields |= MOUNT_CHANGED_SUPER_OPTIONS;
+    if (mount->propagation != other_mount->propagation)
+        fields |= MOUNT_CHANGED_PROPAGATION;
+
+    return fields;
 }
 
-static void
-mount_info_class_init (MountInfoClass *klass)
+/* Takes over the callers' references to both mounts */
+MountChange *
+mount_change_new (MountInfo          *old_mount,
+                  MountInfo          *new_mount,
+                  MountChangedFields  fields)
 {
-    GObjectClass *gobject_class;
+    MountChange *change;
 
-    gobject_class = G_OBJECT_CLASS (klass);
-    gobject_class->finalize = mount_info_finalize;
+    change = g_slice_new (MountChange);
+    change->old_mount = old_mount;
+    change->new_mount = new_mount;
+    change->fields = fields;
+
+    return change;
 }
 
-MountInfo *
-_mount_info_new (dev_t dev,
-                   const gchar *mount_path,
-                   MountType type)
+void
+mount_change_free (MountChange *change)
 {
-    MountInfo *mount;
+    mount_info_unref (change->old_mount);
+    mount_info_unref (change->new_mount);
+    g_slice_free (MountChange, change);
+}
 
-    mount = MOUNT_INFO (g_object_new (MOUNT_INFO_TYPE, NULL));
-    mount->dev = dev;
-    mount->mount_path = g_strdup (mount_path);
-    mount->type = type;
+guint
+mount_key_hash (gconstpointer key)
+{
+    const MountKey *k = key;
+    guint64 dev = k->dev;
 
-    return mount;
+    return g_str_hash (k->mount_path) ^ (guint) (dev ^ (dev >> 32));
+}
+
+gboolean
+mount_key_equal (gconstpointer a,
+                 gconstpointer b)
+{
+    const MountKey *ka = a;
+    const MountKey *kb = b;
+
+    return ka->dev == kb->dev && g_strcmp0 (ka->mount_path, kb->mount_path) == 0;
 }
 
 gint
@@ -8,35 +8,128 @@ typedef enum
     MOUNT_TYPE_SWAP
 } MountType;
 
+/* Identity of a mount in the monitor's tables: the device number plus
+ * the (decoded) mount path.  mount_path is borrowed, not owned.
+ */
+typedef struct _MountKey MountKey;
+struct _MountKey
+{
+    dev_t dev;
+    const gchar *mount_path;
+};
+
+/* Everything a mountinfo line or statmount() tells about a mount besides
+ * its device and path.  The strings are borrowed.
+ */
+typedef struct _MountDetails MountDetails;
+struct _MountDetails
+{
+    /* the IDs /proc/<pid>/mountinfo shows, 0 for swaps */
+    guint64 mount_id;
+    guint64 parent_id;
+    /* statmount()'s 64-bit mount ID, which unlike mount_id is never
+     * reused; 0 with the mountinfo backend */
+    guint64 unique_id;
+    const gchar *root;
+    const gchar *fstype;
+    const gchar *source;
+    /* per-mount options such as rw,nosuid,relatime */
+    const gchar *options;
+    /* superblock options such as rw,errors=continue */
+    const gchar *super_options;
+    /* the optional fields: shared:N, master:N, propagate_from:N and
+     * unbindable, separated by spaces */
+    const gchar *propagation;
+};
+
+/* A mount or swap.  Mounts are plain reference counted records allocated
+ * from a shared arena, their strings interned in a shared pool, so equal
+ * paths, fstypes and sources are stored once across namespaces and
+ * reloads.  MOUNT_INFO_TYPE boxes them for GValues.  A mount is created on
+ * the worker thread, whose namespace fills in ns_id before the mount is
+ * handed to any other thread.  From then on everything but n_records and
+ * ref_count stays as it is and may be read from any thread that holds a
+ * reference.
+ */
 typedef struct _MountInfo MountInfo;
 struct _MountInfo
 {
-    GObject parent_instance;
-
-    gchar *mount_path;
+    /* dev and mount_path come first and are laid out like a MountKey, so a
+     * mount is its own hash table key, see MOUNT_INFO_KEY() */
     dev_t dev;
+    /* interned, like fstype and source */
+    const gchar *mount_path;
+    /* "swap" for swaps */
+    const gchar *fstype;
+    /* the mount source, the swap file or partition for swaps */
+    const gchar *source;
+    /* the rest of the record the mount was first seen in, see
+     * MountDetails; NULL for swaps.  Interned as well. */
+    guint64 mount_id;
+    guint64 parent_id;
+    guint64 unique_id;
+    const gchar *root;
+    const gchar *options;
+    const gchar *super_options;
+    const gchar *propagation;
+    /* the mount namespace the mount was seen in */
+    guint64 ns_id;
+    /* atomic, mounts are passed between threads */
+    gint ref_count;
+    /* number of mountinfo records referring to this mount; belongs to the
+     * namespace's tables on the worker thread, nothing else may read it */
+    guint n_records;
     MountType type;
 };
 
-typedef struct _MountInfoClass MountInfoClass;
+/* What differs between two versions of the same kernel mount */
+typedef enum
+{
+    MOUNT_CHANGED_PATH          = 1 << 0,   /* moved */
+    MOUNT_CHANGED_PARENT        = 1 << 1,
+    MOUNT_CHANGED_ROOT          = 1 << 2,
+    MOUNT_CHANGED_OPTIONS       = 1 << 3,   /* remounted */
+    MOUNT_CHANGED_SUPER_OPTIONS = 1 << 4,   /* superblock reconfigured */
+    MOUNT_CHANGED_PROPAGATION   = 1 << 5    /* made shared, private, ... */
+} MountChangedFields;
 
-struct _MountInfoClass
+/* A mount that changed in place: the kernel mount ID and the device stayed
+ * the same.  Mounts never change, so the new state is a new MountInfo;
+ * both hold a reference.
+ */
+typedef struct _MountChange MountChange;
+struct _MountChange
 {
-    GObjectClass parent_class;
+    MountInfo *old_mount;
+    MountInfo *new_mount;
+    MountChangedFields fields;
 };
 
 #define MOUNT_INFO_TYPE         (mount_info_get_type ())
-#define MOUNT_INFO(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), MOUNT_INFO_TYPE, MountInfo))
-#define IS_MOUNT_INFO(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), MOUNT_INFO_TYPE))
+#define MOUNT_INFO(o)           ((MountInfo *) (o))
+#define IS_MOUNT_INFO(o)        ((o) != NULL)
+#define MOUNT_INFO_KEY(mount)   ((MountKey *) (mount))
 
 GType            mount_info_get_type       (void) G_GNUC_CONST;
+MountInfo       *mount_info_ref            (MountInfo *mount);
+void             mount_info_unref          (MountInfo *mount);
 MountType  mount_info_get_mount_type (MountInfo *mount);
 const gchar     *mount_info_get_mount_path (MountInfo *mount);
 dev_t            mount_info_get_dev        (MountInfo *mount);
 gint             mount_info_compare        (MountInfo *mount,
                                               MountInfo *other_mount);
+MountChangedFields mount_info_diff         (MountInfo *mount,
+                                              MountInfo *other_mount);
+MountChange     *mount_change_new          (MountInfo *old_mount,
+                                              MountInfo *new_mount,
+                                              MountChangedFields fields);
+void             mount_change_free         (MountChange *change);
+guint            mount_key_hash            (gconstpointer key);
+gboolean         mount_key_equal           (gconstpointer a,
+                                              gconstpointer b);
 MountInfo *_mount_info_new (dev_t dev,
                    const gchar *mount_path,
-                   MountType type);
+                   MountType type,
+                   const MountDetails *details);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,527 @@
+/* Reads the journal written with mountmonitor --journal.
+ *
+ *   mountjournal dump FILE...    prints every record, for incident reviews
+ *   mountjournal replay FILE...  replays the recorded changes against the
+ *                                mountinfo parser and diff engine
+ *
+ * A replay rebuilds the mountinfo table of one namespace from each file:
+ * the PRESENT records are the table it starts from, then after every batch
+ * the table is rewritten with the batch applied and
+ * mount_namespace_reload() is timed on it, with nothing in between, as in
+ * mountbench.  The changes the reload reports are checked against the
+ * ones recorded.  Files are replayed one at a time, oldest first as given.
+ */
+#include "journal.h"
+#include "mountnamespace.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/sysmacros.h>
+
+static gchar *opt_ns = NULL;
+static gint opt_iterations = 1;
+
+static GOptionEntry entries[] =
+{
+    { "ns", 0, 0, G_OPTION_ARG_STRING, &opt_ns,
+      "Replay namespace ID (default the first one in each file)", "ID" },
+    { "iterations", 0, 0, G_OPTION_ARG_INT, &opt_iterations,
+      "Replay every file N times (default 1)", "N" },
+    { NULL }
+};
+
+static const gchar *
+record_type_name (MountJournalRecordType type)
+{
+    switch (type)
+    {
+    case MOUNT_JOURNAL_PRESENT:
+        return "present";
+    case MOUNT_JOURNAL_ADDED:
+        return "added";
+    case MOUNT_JOURNAL_REMOVED:
+        return "removed";
+    case MOUNT_JOURNAL_CHANGED:
+        return "changed";
+    default:
+        return "?";
+    }
+}
+
+static gchar *
+format_timestamp (gint64 timestamp)
+{
+    GDateTime *date;
+    gchar *seconds;
+    gchar *str;
+
+    date = g_date_time_new_from_unix_utc (timestamp / G_USEC_PER_SEC);
+    if (date == NULL)
+        return g_strdup ("?");
+    seconds = g_date_time_format (date, "%Y-%m-%dT%H:%M:%S");
+    str = g_strdup_printf ("%s.%06dZ", seconds, (gint) (timestamp % G_USEC_PER_SEC));
+    g_free (seconds);
+    g_date_time_unref (date);
+
+    return str;
+}
+
+static void
+dump_fields (MountChangedFields fields)
+{
+    const struct
+    {
+        MountChangedFields field;
+        const gchar *name;
+    } names[] =
+    {
+        { MOUNT_CHANGED_PATH, "path" },
+        { MOUNT_CHANGED_PARENT, "parent-id" },
+        { MOUNT_CHANGED_ROOT, "root" },
+        { MOUNT_CHANGED_OPTIONS, "options" },
+        { MOUNT_CHANGED_SUPER_OPTIONS, "super-options" },
+        { MOUNT_CHANGED_PROPAGATION, "propagation" },
+    };
+    const gchar *sep = " [";
+    guint n;
+
+    for (n = 0; n < G_N_ELEMENTS (names); n++)
+    {
+        if (fields & names[n].field)
+        {
+            printf ("%s%s", sep, names[n].name);
+            sep = ",";
+        }
+    }
+    if (fields != 0)
+        printf ("]");
+}
+
+static gboolean
+dump_file (const gchar  *path,
+           GError      **error)
+{
+    MountJournalReader *reader;
+    MountJournalEvent event;
+    gchar *stamp;
+
+    reader = mount_journal_reader_open (path, error);
+    if (reader == NULL)
+        return FALSE;
+
+    printf ("# %s\n", path);
+    while (mount_journal_reader_next (reader, &event))
+    {
+        stamp = format_timestamp (event.timestamp);
+        if (event.type == MOUNT_JOURNAL_BATCH_END)
+        {
+            printf ("%s -- generation %" G_GUINT64_FORMAT "\n", stamp, event.generation);
+            g_free (stamp);
+            continue;
+        }
+
+        printf ("%s %" G_GUINT64_FORMAT " ns %" G_GUINT64_FORMAT " %-7s %s %s %u:%u id %"
+                G_GUINT64_FORMAT " %s %s",
+                stamp, event.generation, event.ns_id, record_type_name (event.type),
+                event.mount_type == MOUNT_TYPE_SWAP ? "swap" : "mount",
+                event.path != NULL ? event.path : "-",
+                major (event.dev), minor (event.dev), event.mount_id,
+                event.fstype != NULL ? event.fstype : "-",
+                event.source != NULL ? event.source : "-");
+        if (event.uuid != NULL)
+            printf (" uuid=%s", event.uuid);
+        if (event.serial != NULL)
+            printf (" serial=%s", event.serial);
+        if (event.old_path != NULL)
+            printf (" from %s", event.old_path);
+        dump_fields (event.fields);
+        printf ("\n");
+        g_free (stamp);
+    }
+    if (reader->offset != reader->len)
+        printf ("# %s: stopped at byte %" G_GSIZE_FORMAT " of %" G_GSIZE_FORMAT "\n",
+                path, reader->offset, reader->len);
+
+    mount_journal_reader_free (reader);
+
+    return TRUE;
+}
+
+/* The mountinfo table of the namespace being replayed */
+typedef struct _ReplayTable ReplayTable;
+struct _ReplayTable
+{
+    gchar *path;
+    /* mount ID -> mountinfo line */
+    GHashTable *lines;
+    GString *contents;
+};
+
+/* mountinfo escapes blanks and backslashes as octal */
+static void
+append_escaped (GString     *str,
+                const gchar *field)
+{
+    const gchar *p;
+
+    if (field == NULL || *field == '\0')
+    {
+        g_string_append (str, "none");
+        return;
+    }
+
+    for (p = field; *p != '\0'; p++)
+    {
+        if (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\\')
+            g_string_append_printf (str, "\\%03o", (guchar) *p);
+        else
+            g_string_append_c (str, *p);
+    }
+}
+
+/* Writes the line the kernel would show for the recorded mount.  Its
+ * device is the one it was tracked under, so that even btrfs mounts are
+ * tracked again without their source having to exist.
+ */
+static void
+replay_table_set (ReplayTable             *table,
+                  const MountJournalEvent *event)
+{
+    GString *line;
+    guint64 *mount_id;
+
+    line = g_string_new (NULL);
+    g_string_append_printf (line, "%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT " %u:%u ",
+                            event->mount_id, event->parent_id,
+                            major (event->dev), minor (event->dev));
+    append_escaped (line, event->root);
+    g_string_append_c (line, ' ');
+    append_escaped (line, event->path);
+    g_string_append_c (line, ' ');
+    g_string_append (line, event->options != NULL ? event->options : "rw");
+    if (event->propagation != NULL && *event->propagation != '\0')
+        g_string_append_printf (line, " %s", event->propagation);
+    g_string_append (line, " - ");
+    g_string_append (line, event->fstype != NULL ? event->fstype : "none");
+    g_string_append_c (line, ' ');
+    append_escaped (line, event->source);
+    g_string_append_c (line, ' ');
+    append_escaped (line, event->super_options);
+    g_string_append_c (line, '\n');
+
+    mount_id = g_new (guint64, 1);
+    *mount_id = event->mount_id;
+    g_hash_table_replace (table->lines, mount_id, g_string_free (line, FALSE));
+}
+
+static gboolean
+replay_table_write (ReplayTable  *table,
+                    GError      **error)
+{
+    GHashTableIter iter;
+    const gchar *line;
+    gssize written;
+    int fd;
+
+    g_string_truncate (table->contents, 0);
+    g_hash_table_iter_init (&iter, table->lines);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &line))
+        g_string_append (table->contents, line);
+
+    /* in place, the namespace keeps reading through the fd it opened */
+    fd = open (table->path, O_WRONLY | O_TRUNC | O_CLOEXEC);
+    if (fd < 0)
+    {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                     "Error opening %s: %s", table->path, g_strerror (errno));
+        return FALSE;
+    }
+    written = write (fd, table->contents->str, table->contents->len);
+    if (written != (gssize) table->contents->len)
+    {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                     "Error writing %s: %s", table->path, g_strerror (errno));
+        close (fd);
+        return FALSE;
+    }
+    close (fd);
+
+    return TRUE;
+}
+
+/* What one batch changed, as recorded or as reported by the reload */
+typedef struct _ReplayCounts ReplayCounts;
+struct _ReplayCounts
+{
+    guint added;
+    guint removed;
+    guint changed;
+};
+
+typedef struct _ReplayResult ReplayResult;
+struct _ReplayResult
+{
+    GArray *latencies_ns;
+    guint64 records;
+    guint64 mismatches;
+};
+
+static void
+on_changed (MountNamespace *ns,
+            GList          *added,
+            GList          *removed,
+            GList          *changed,
+            gpointer        user_data)
+{
+    ReplayCounts *counts = user_data;
+
+    if (counts != NULL)
+    {
+        counts->added += g_list_length (added);
+        counts->removed += g_list_length (removed);
+        counts->changed += g_list_length (changed);
+    }
+    g_list_free (added);
+    g_list_free_full (removed, (GDestroyNotify) mount_info_unref);
+    g_list_free_full (changed, (GDestroyNotify) mount_change_free);
+}
+
+static gint64
+now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Whether a record belongs to the namespace being replayed; the first
+ * filesystem record picks it unless --ns did */
+static gboolean
+replay_wants (const MountJournalEvent *event,
+              guint64                 *ns_id)
+{
+    if (event->type == MOUNT_JOURNAL_BATCH_END || event->mount_type != MOUNT_TYPE_FILESYSTEM)
+        return FALSE;
+    if (*ns_id == 0)
+        *ns_id = event->ns_id;
+    return event->ns_id == *ns_id;
+}
+
+static gboolean
+replay_file (const gchar   *path,
+             ReplayTable   *table,
+             MountParser   *parser,
+             ReplayResult  *result,
+             GError       **error)
+{
+    MountJournalReader *reader;
+    MountJournalEvent event;
+    MountNamespace *ns;
+    ReplayCounts expected = { 0 };
+    ReplayCounts reported = { 0 };
+    guint64 ns_id;
+    gint64 start;
+    gint64 elapsed;
+    gboolean started;
+
+    reader = mount_journal_reader_open (path, error);
+    if (reader == NULL)
+        return FALSE;
+
+    ns_id = opt_ns != NULL ? g_ascii_strtoull (opt_ns, NULL, 10) : 0;
+    ns = NULL;
+    started = FALSE;
+    g_hash_table_remove_all (table->lines);
+    while (mount_journal_reader_next (reader, &event))
+    {
+        if (event.type == MOUNT_JOURNAL_BATCH_END)
+        {
+            if (!replay_table_write (table, error))
+                break;
+
+            /* the first batch is the table the file starts from */
+            if (!started)
+            {
+                ns = mount_namespace_new_for_file (table->path, parser, on_changed, NULL, error);
+                if (ns == NULL)
+                    break;
+                started = TRUE;
+                continue;
+            }
+            if (expected.added == 0 && expected.removed == 0 && expected.changed == 0)
+                continue;
+
+            memset (&reported, 0, sizeof reported);
+            ns->user_data = &reported;
+            start = now_ns ();
+            mount_namespace_reload (ns);
+            elapsed = now_ns () - start;
+            ns->user_data = NULL;
+            g_array_append_val (result->latencies_ns, elapsed);
+
+            if (memcmp (&expected, &reported, sizeof expected) != 0)
+                result->mismatches++;
+            memset (&expected, 0, sizeof expected);
+            continue;
+        }
+
+        if (!replay_wants (&event, &ns_id))
+            continue;
+        result->records++;
+
+        switch (event.type)
+        {
+        case MOUNT_JOURNAL_PRESENT:
+            replay_table_set (table, &event);
+            break;
+        case MOUNT_JOURNAL_ADDED:
+            replay_table_set (table, &event);
+            expected.added++;
+            break;
+        case MOUNT_JOURNAL_CHANGED:
+            replay_table_set (table, &event);
+            expected.changed++;
+            break;
+        case MOUNT_JOURNAL_REMOVED:
+            g_hash_table_remove (table->lines, &event.mount_id);
+            expected.removed++;
+            break;
+        default:
+            break;
+        }
+    }
+
+    mount_namespace_free (ns);
+    mount_journal_reader_free (reader);
+
+    return error == NULL || *error == NULL;
+}
+
+static gint
+compare_int64 (gconstpointer a,
+               gconstpointer b)
+{
+    gint64 x = *(const gint64 *) a;
+    gint64 y = *(const gint64 *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static gdouble
+percentile_us (GArray  *sorted,
+               gdouble  p)
+{
+    guint idx;
+
+    idx = (guint) (p * (sorted->len - 1) + 0.5);
+    return g_array_index (sorted, gint64, idx) / 1000.0;
+}
+
+static gboolean
+replay_files (gchar   **paths,
+              GError  **error)
+{
+    ReplayResult result = { 0 };
+    ReplayTable table = { 0 };
+    MountParser *parser;
+    GArray *sorted;
+    gint64 start;
+    gint64 elapsed;
+    gboolean ret;
+    gint fd;
+    gint i;
+
+    fd = g_file_open_tmp ("mountjournal-XXXXXX", &table.path, error);
+    if (fd < 0)
+        return FALSE;
+    close (fd);
+    table.lines = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, g_free);
+    table.contents = g_string_new (NULL);
+    result.latencies_ns = g_array_new (FALSE, FALSE, sizeof (gint64));
+    parser = mount_parser_new ();
+
+    ret = TRUE;
+    start = now_ns ();
+    for (i = 0; ret && i < opt_iterations; i++)
+    {
+        gchar **path;
+
+        for (path = paths; ret && *path != NULL; path++)
+            ret = replay_file (*path, &table, parser, &result, error);
+    }
+    elapsed = now_ns () - start;
+
+    sorted = result.latencies_ns;
+    if (ret && sorted->len > 0)
+    {
+        g_array_sort (sorted, compare_int64);
+        printf ("%" G_GUINT64_FORMAT " records, %u reloads in %.1f ms: p50 %.1f us, p90 %.1f us, "
+                "p99 %.1f us, max %.1f us\n",
+                result.records, sorted->len, elapsed / 1000000.0,
+                percentile_us (sorted, 0.50), percentile_us (sorted, 0.90),
+                percentile_us (sorted, 0.99), g_array_index (sorted, gint64, sorted->len - 1) / 1000.0);
+        printf ("%" G_GUINT64_FORMAT " reloads reported other changes than recorded\n",
+                result.mismatches);
+    }
+    else if (ret)
+        printf ("Nothing to replay\n");
+
+    mount_parser_free (parser);
+    g_array_free (result.latencies_ns, TRUE);
+    g_string_free (table.contents, TRUE);
+    g_hash_table_unref (table.lines);
+    unlink (table.path);
+    g_free (table.path);
+
+    return ret;
+}
+
+int
+main (int argc, char **argv)
+{
+    GOptionContext *context;
+    GError *error = NULL;
+    gboolean ret;
+    gint i;
+
+    context = g_option_context_new ("dump|replay FILE... - read a mountmonitor journal");
+    g_option_context_add_main_entries (context, entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+        printf ("%s\n", error->message);
+        return 1;
+    }
+    g_option_context_free (context);
+    if (argc < 3 || (strcmp (argv[1], "dump") != 0 && strcmp (argv[1], "replay") != 0))
+    {
+        printf ("Usage: %s [--ns=ID] [--iterations=N] dump|replay FILE...\n", argv[0]);
+        return 1;
+    }
+    if (opt_iterations < 1)
+    {
+        printf ("Iterations must be at least 1\n");
+        return 1;
+    }
+
+    if (strcmp (argv[1], "replay") == 0)
+        ret = replay_files (argv + 2, &error);
+    else
+    {
+        ret = TRUE;
+        for (i = 2; ret && i < argc; i++)
+            ret = dump_file (argv[i], &error);
+    }
+
+    if (!ret)
+    {
+        printf ("%s\n", error->message);
+        g_error_free (error);
+        return 1;
+    }
+
+    return 0;
+}
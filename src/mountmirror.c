@@ -0,0 +1,195 @@
+#include "mountmirror.h"
+
+static void
+mount_dev_entry_free (MountDevEntry *entry)
+{
+    g_list_free (entry->mounts);
+    g_free (entry);
+}
+
+static void
+mount_id_entry_free (MountIdEntry *entry)
+{
+    g_list_free (entry->mounts);
+    g_free (entry);
+}
+
+MountMirror *
+mount_mirror_new (guint64 ns_id)
+{
+    MountMirror *mirror;
+
+    mirror = g_new0 (MountMirror, 1);
+    mirror->ns_id = ns_id;
+    mirror->mounts = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                            (GDestroyNotify) mount_info_unref, NULL);
+    mirror->mounts_by_dev = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                                   NULL, (GDestroyNotify) mount_dev_entry_free);
+    mirror->mounts_by_id = g_hash_table_new (g_int64_hash, g_int64_equal);
+    mirror->children = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                              NULL, (GDestroyNotify) mount_id_entry_free);
+    mirror->paths = path_index_new ();
+
+    return mirror;
+}
+
+void
+mount_mirror_free (MountMirror *mirror)
+{
+    if (mirror == NULL)
+        return;
+
+    path_index_free (mirror->paths);
+    g_hash_table_unref (mirror->children);
+    g_hash_table_unref (mirror->mounts_by_id);
+    g_hash_table_unref (mirror->mounts_by_dev);
+    g_hash_table_unref (mirror->mounts);
+    g_free (mirror);
+}
+
+/* Takes a reference; adding a mount twice does nothing */
+void
+mount_mirror_add (MountMirror *mirror,
+                  MountInfo   *mount)
+{
+    MountDevEntry *entry;
+    MountIdEntry *children;
+
+    if (g_hash_table_contains (mirror->mounts, mount))
+        return;
+    g_hash_table_add (mirror->mounts, mount_info_ref (mount));
+
+    entry = g_hash_table_lookup (mirror->mounts_by_dev, &mount->dev);
+    if (entry == NULL)
+    {
+        entry = g_new0 (MountDevEntry, 1);
+        entry->dev = mount->dev;
+        g_hash_table_insert (mirror->mounts_by_dev, &entry->dev, entry);
+    }
+    entry->mounts = g_list_prepend (entry->mounts, mount);
+
+    if (mount->type != MOUNT_TYPE_FILESYSTEM)
+        return;
+
+    /* mountinfo IDs are reused; the newer mount wins */
+    g_hash_table_replace (mirror->mounts_by_id, &mount->mount_id, mount);
+    path_index_insert (mirror->paths, mount->mount_path, mount);
+
+    /* the root of the namespace may be its own parent */
+    if (mount->parent_id == mount->mount_id)
+        return;
+    children = g_hash_table_lookup (mirror->children, &mount->parent_id);
+    if (children == NULL)
+    {
+        children = g_new0 (MountIdEntry, 1);
+        children->id = mount->parent_id;
+        g_hash_table_insert (mirror->children, &children->id, children);
+    }
+    children->mounts = g_list_prepend (children->mounts, mount);
+}
+
+void
+mount_mirror_remove (MountMirror *mirror,
+                     MountInfo   *mount)
+{
+    MountDevEntry *entry;
+    MountIdEntry *children;
+
+    if (!g_hash_table_contains (mirror->mounts, mount))
+        return;
+
+    entry = g_hash_table_lookup (mirror->mounts_by_dev, &mount->dev);
+    if (entry != NULL)
+    {
+        entry->mounts = g_list_remove (entry->mounts, mount);
+        if (entry->mounts == NULL)
+            g_hash_table_remove (mirror->mounts_by_dev, &mount->dev);
+    }
+
+    if (mount->type == MOUNT_TYPE_FILESYSTEM)
+    {
+        if (g_hash_table_lookup (mirror->mounts_by_id, &mount->mount_id) == mount)
+            g_hash_table_remove (mirror->mounts_by_id, &mount->mount_id);
+        path_index_remove (mirror->paths, mount->mount_path, mount);
+
+        children = g_hash_table_lookup (mirror->children, &mount->parent_id);
+        if (children != NULL)
+        {
+            children->mounts = g_list_remove (children->mounts, mount);
+            if (children->mounts == NULL)
+                g_hash_table_remove (mirror->children, &mount->parent_id);
+        }
+    }
+
+    /* last, it holds the reference */
+    g_hash_table_remove (mirror->mounts, mount);
+}
+
+/* Returns the mounts and swaps of dev, owned by the mirror */
+GList *
+mount_mirror_get_mounts_for_dev (MountMirror *mirror,
+                                 dev_t        dev)
+{
+    MountDevEntry *entry;
+    gint64 key = dev;
+
+    entry = g_hash_table_lookup (mirror->mounts_by_dev, &key);
+    return entry != NULL ? entry->mounts : NULL;
+}
+
+/* The mount with the given mountinfo ID, owned by the mirror */
+MountInfo *
+mount_mirror_get_mount_by_id (MountMirror *mirror,
+                              guint64      mount_id)
+{
+    return g_hash_table_lookup (mirror->mounts_by_id, &mount_id);
+}
+
+/* Returns the mounts at path or below it, which are owned by the mirror;
+ * free the list with g_list_free().  Only the index nodes leading to them
+ * are visited.
+ */
+GList *
+mount_mirror_get_mounts_under (MountMirror *mirror,
+                               const gchar *path)
+{
+    return path_index_lookup_under (mirror->paths, path);
+}
+
+/* Returns the mount with the given ID followed by everything mounted on
+ * it, directly or not, parents before their children; NULL if there is
+ * no such mount.  The mounts are owned by the mirror; free the list with
+ * g_list_free().
+ */
+GList *
+mount_mirror_get_subtree (MountMirror *mirror,
+                          guint64      mount_id)
+{
+    MountInfo *mount;
+    MountIdEntry *children;
+    GQueue pending = G_QUEUE_INIT;
+    guint n_left;
+    GList *ret;
+    GList *l;
+
+    mount = mount_mirror_get_mount_by_id (mirror, mount_id);
+    if (mount == NULL)
+        return NULL;
+
+    ret = NULL;
+    /* stale IDs could make a loop, no subtree is bigger than the table */
+    n_left = g_hash_table_size (mirror->mounts_by_id);
+    g_queue_push_tail (&pending, mount);
+    while (n_left-- > 0 && (mount = g_queue_pop_head (&pending)) != NULL)
+    {
+        ret = g_list_prepend (ret, mount);
+        children = g_hash_table_lookup (mirror->children, &mount->mount_id);
+        if (children == NULL)
+            continue;
+        for (l = children->mounts; l != NULL; l = l->next)
+            g_queue_push_tail (&pending, l->data);
+    }
+
+    g_queue_clear (&pending);
+    return g_list_reverse (ret);
+}
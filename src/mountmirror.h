@@ -0,0 +1,47 @@
+#ifndef __MOUNT_MIRROR_H__
+#define __MOUNT_MIRROR_H__
+#include "mountnamespace.h"
+#include "pathindex.h"
+
+/* The main thread's copy of the mounts of one watched namespace, kept up
+ * to date from the worker's events, with the indexes the queries need.
+ * Swaps are only in mounts and mounts_by_dev.
+ */
+typedef struct _MountMirror MountMirror;
+struct _MountMirror {
+    guint64 ns_id;
+    /* set of MountInfo, owns a reference to each; mounts stacked at the
+     * same (dev, path) are separate entries */
+    GHashTable *mounts;
+    /* dev_t -> MountDevEntry listing every mount of that device */
+    GHashTable *mounts_by_dev;
+    /* mount ID -> MountInfo */
+    GHashTable *mounts_by_id;
+    /* parent mount ID -> MountIdEntry listing the children */
+    GHashTable *children;
+    /* mount path -> MountInfo */
+    PathIndex *paths;
+};
+
+typedef struct _MountIdEntry MountIdEntry;
+struct _MountIdEntry {
+    guint64 id;
+    GList *mounts;
+};
+
+MountMirror *mount_mirror_new                (guint64       ns_id);
+void         mount_mirror_free               (MountMirror  *mirror);
+void         mount_mirror_add                (MountMirror  *mirror,
+                                              MountInfo    *mount);
+void         mount_mirror_remove             (MountMirror  *mirror,
+                                              MountInfo    *mount);
+GList       *mount_mirror_get_mounts_for_dev (MountMirror  *mirror,
+                                              dev_t         dev);
+MountInfo   *mount_mirror_get_mount_by_id    (MountMirror  *mirror,
+                                              guint64       mount_id);
+GList       *mount_mirror_get_mounts_under   (MountMirror  *mirror,
+                                              const gchar  *path);
+GList       *mount_mirror_get_subtree        (MountMirror  *mirror,
+                                              guint64       mount_id);
+
+#endif
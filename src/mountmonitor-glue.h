@@ -55,19 +55,506 @@ G_BEGIN_DECLS
 #endif /* !G_ENABLE_DEBUG */
 
 
+/* BOOLEAN:POINTER,POINTER,POINTER */
+extern void dbus_glib_marshal_mountmonitor_BOOLEAN__POINTER_POINTER_POINTER (GClosure     *closure,
+                                                                             GValue       *return_value,
+                                                                             guint         n_param_values,
+                                                                             const GValue *param_values,
+                                                                             gpointer      invocation_hint,
+                                                                             gpointer      marshal_data);
+void
+dbus_glib_marshal_mountmonitor_BOOLEAN__POINTER_POINTER_POINTER (GClosure     *closure,
+                                                                 GValue       *return_value G_GNUC_UNUSED,
+                                                                 guint         n_param_values,
+                                                                 const GValue *param_values,
+                                                                 gpointer      invocation_hint G_GNUC_UNUSED,
+                                                                 gpointer      marshal_data)
+{
+  typedef gboolean (*GMarshalFunc_BOOLEAN__POINTER_POINTER_POINTER) (gpointer     data1,
+                                                                     gpointer     arg_1,
+                                                                     gpointer     arg_2,
+                                                                     gpointer     arg_3,
+                                                                     gpointer     data2);
+  register GMarshalFunc_BOOLEAN__POINTER_POINTER_POINTER callback;
+  register GCClosure *cc = (GCClosure*) closure;
+  register gpointer data1, data2;
+  gboolean v_return;
+
+  g_return_if_fail (return_value != NULL);
+  g_return_if_fail (n_param_values == 4);
+
+  if (G_CCLOSURE_SWAP_DATA (closure))
+    {
+      data1 = closure->data;
+      data2 = g_value_peek_pointer (param_values + 0);
+    }
+  else
+    {
+      data1 = g_value_peek_pointer (param_values + 0);
+      data2 = closure->data;
+    }
+  callback = (GMarshalFunc_BOOLEAN__POINTER_POINTER_POINTER) (marshal_data ? marshal_data : cc->callback);
+
+  v_return = callback (data1,
+                       g_marshal_value_peek_pointer (param_values + 1),
+                       g_marshal_value_peek_pointer (param_values + 2),
+                       g_marshal_value_peek_pointer (param_values + 3),
+                       data2);
+
+  g_value_set_boolean (return_value, v_return);
+}
+
+/* BOOLEAN:STRING,POINTER,POINTER */
+extern void dbus_glib_marshal_mountmonitor_BOOLEAN__STRING_POINTER_POINTER (GClosure     *closure,
+                                                                            GValue       *return_value,
+                                                                            guint         n_param_values,
+                                                                            const GValue *param_values,
+                                                                            gpointer      invocation_hint,
+                                                                            gpointer      marshal_data);
+void
+dbus_glib_marshal_mountmonitor_BOOLEAN__STRING_POINTER_POINTER (GClosure     *closure,
+                                                                GValue       *return_value G_GNUC_UNUSED,
+                                                                guint         n_param_values,
+                                                                const GValue *param_values,
+                                                                gpointer      invocation_hint G_GNUC_UNUSED,
+                                                                gpointer      marshal_data)
+{
+  typedef gboolean (*GMarshalFunc_BOOLEAN__STRING_POINTER_POINTER) (gpointer     data1,
+                                                                    gpointer     arg_1,
+                                                                    gpointer     arg_2,
+                                                                    gpointer     arg_3,
+                                                                    gpointer     data2);
+  register GMarshalFunc_BOOLEAN__STRING_POINTER_POINTER callback;
+  register GCClosure *cc = (GCClosure*) closure;
+  register gpointer data1, data2;
+  gboolean v_return;
+
+  g_return_if_fail (return_value != NULL);
+  g_return_if_fail (n_param_values == 4);
+
+  if (G_CCLOSURE_SWAP_DATA (closure))
+    {
+      data1 = closure->data;
+      data2 = g_value_peek_pointer (param_values + 0);
+    }
+  else
+    {
+      data1 = g_value_peek_pointer (param_values + 0);
+      data2 = closure->data;
+    }
+  callback = (GMarshalFunc_BOOLEAN__STRING_POINTER_POINTER) (marshal_data ? marshal_data : cc->callback);
+
+  v_return = callback (data1,
+                       g_marshal_value_peek_string (param_values + 1),
+                       g_marshal_value_peek_pointer (param_values + 2),
+                       g_marshal_value_peek_pointer (param_values + 3),
+                       data2);
+
+  g_value_set_boolean (return_value, v_return);
+}
+
+/* BOOLEAN:UINT64,POINTER */
+extern void dbus_glib_marshal_mountmonitor_BOOLEAN__UINT64_POINTER (GClosure     *closure,
+                                                                    GValue       *return_value,
+                                                                    guint         n_param_values,
+                                                                    const GValue *param_values,
+                                                                    gpointer      invocation_hint,
+                                                                    gpointer      marshal_data);
+void
+dbus_glib_marshal_mountmonitor_BOOLEAN__UINT64_POINTER (GClosure     *closure,
+                                                        GValue       *return_value G_GNUC_UNUSED,
+                                                        guint         n_param_values,
+                                                        const GValue *param_values,
+                                                        gpointer      invocation_hint G_GNUC_UNUSED,
+                                                        gpointer      marshal_data)
+{
+  typedef gboolean (*GMarshalFunc_BOOLEAN__UINT64_POINTER) (gpointer     data1,
+                                                            guint64      arg_1,
+                                                            gpointer     arg_2,
+                                                            gpointer     data2);
+  register GMarshalFunc_BOOLEAN__UINT64_POINTER callback;
+  register GCClosure *cc = (GCClosure*) closure;
+  register gpointer data1, data2;
+  gboolean v_return;
+
+  g_return_if_fail (return_value != NULL);
+  g_return_if_fail (n_param_values == 3);
+
+  if (G_CCLOSURE_SWAP_DATA (closure))
+    {
+      data1 = closure->data;
+      data2 = g_value_peek_pointer (param_values + 0);
+    }
+  else
+    {
+      data1 = g_value_peek_pointer (param_values + 0);
+      data2 = closure->data;
+    }
+  callback = (GMarshalFunc_BOOLEAN__UINT64_POINTER) (marshal_data ? marshal_data : cc->callback);
+
+  v_return = callback (data1,
+                       g_marshal_value_peek_uint64 (param_values + 1),
+                       g_marshal_value_peek_pointer (param_values + 2),
+                       data2);
+
+  g_value_set_boolean (return_value, v_return);
+}
+
+/* BOOLEAN:UINT64,POINTER,POINTER */
+extern void dbus_glib_marshal_mountmonitor_BOOLEAN__UINT64_POINTER_POINTER (GClosure     *closure,
+                                                                            GValue       *return_value,
+                                                                            guint         n_param_values,
+                                                                            const GValue *param_values,
+                                                                            gpointer      invocation_hint,
+                                                                            gpointer      marshal_data);
+void
+dbus_glib_marshal_mountmonitor_BOOLEAN__UINT64_POINTER_POINTER (GClosure     *closure,
+                                                                GValue       *return_value G_GNUC_UNUSED,
+                                                                guint         n_param_values,
+                                                                const GValue *param_values,
+                                                                gpointer      invocation_hint G_GNUC_UNUSED,
+                                                                gpointer      marshal_data)
+{
+  typedef gboolean (*GMarshalFunc_BOOLEAN__UINT64_POINTER_POINTER) (gpointer     data1,
+                                                                    guint64      arg_1,
+                                                                    gpointer     arg_2,
+                                                                    gpointer     arg_3,
+                                                                    gpointer     data2);
+  register GMarshalFunc_BOOLEAN__UINT64_POINTER_POINTER callback;
+  register GCClosure *cc = (GCClosure*) closure;
+  register gpointer data1, data2;
+  gboolean v_return;
+
+  g_return_if_fail (return_value != NULL);
+  g_return_if_fail (n_param_values == 4);
+
+  if (G_CCLOSURE_SWAP_DATA (closure))
+    {
+      data1 = closure->data;
+      data2 = g_value_peek_pointer (param_values + 0);
+    }
+  else
+    {
+      data1 = g_value_peek_pointer (param_values + 0);
+      data2 = closure->data;
+    }
+  callback = (GMarshalFunc_BOOLEAN__UINT64_POINTER_POINTER) (marshal_data ? marshal_data : cc->callback);
+
+  v_return = callback (data1,
+                       g_marshal_value_peek_uint64 (param_values + 1),
+                       g_marshal_value_peek_pointer (param_values + 2),
+                       g_marshal_value_peek_pointer (param_values + 3),
+                       data2);
+
+  g_value_set_boolean (return_value, v_return);
+}
+
+/* BOOLEAN:UINT64,POINTER,POINTER,POINTER */
+extern void dbus_glib_marshal_mountmonitor_BOOLEAN__UINT64_POINTER_POINTER_POINTER (GClosure     *closure,
+                                                                                    GValue       *return_value,
+                                                                                    guint         n_param_values,
+                                                                                    const GValue *param_values,
+                                                                                    gpointer      invocation_hint,
+                                                                                    gpointer      marshal_data);
+void
+dbus_glib_marshal_mountmonitor_BOOLEAN__UINT64_POINTER_POINTER_POINTER (GClosure     *closure,
+                                                                        GValue       *return_value G_GNUC_UNUSED,
+                                                                        guint         n_param_values,
+                                                                        const GValue *param_values,
+                                                                        gpointer      invocation_hint G_GNUC_UNUSED,
+                                                                        gpointer      marshal_data)
+{
+  typedef gboolean (*GMarshalFunc_BOOLEAN__UINT64_POINTER_POINTER_POINTER) (gpointer     data1,
+                                                                            guint64      arg_1,
+                                                                            gpointer     arg_2,
+                                                                            gpointer     arg_3,
+                                                                            gpointer     arg_4,
+                                                                            gpointer     data2);
+  register GMarshalFunc_BOOLEAN__UINT64_POINTER_POINTER_POINTER callback;
+  register GCClosure *cc = (GCClosure*) closure;
+  register gpointer data1, data2;
+  gboolean v_return;
+
+  g_return_if_fail (return_value != NULL);
+  g_return_if_fail (n_param_values == 5);
+
+  if (G_CCLOSURE_SWAP_DATA (closure))
+    {
+      data1 = closure->data;
+      data2 = g_value_peek_pointer (param_values + 0);
+    }
+  else
+    {
+      data1 = g_value_peek_pointer (param_values + 0);
+      data2 = closure->data;
+    }
+  callback = (GMarshalFunc_BOOLEAN__UINT64_POINTER_POINTER_POINTER) (marshal_data ? marshal_data : cc->callback);
+
+  v_return = callback (data1,
+                       g_marshal_value_peek_uint64 (param_values + 1),
+                       g_marshal_value_peek_pointer (param_values + 2),
+                       g_marshal_value_peek_pointer (param_values + 3),
+                       g_marshal_value_peek_pointer (param_values + 4),
+                       data2);
+
+  g_value_set_boolean (return_value, v_return);
+}
+
+/* BOOLEAN:UINT64,POINTER,POINTER,POINTER,POINTER */
+extern void dbus_glib_marshal_mountmonitor_BOOLEAN__UINT64_POINTER_POINTER_POINTER_POINTER (GClosure     *closure,
+                                                                                            GValue       *return_value,
+                                                                                            guint         n_param_values,
+                                                                                            const GValue *param_values,
+                                                                                            gpointer      invocation_hint,
+                                                                                            gpointer      marshal_data);
+void
+dbus_glib_marshal_mountmonitor_BOOLEAN__UINT64_POINTER_POINTER_POINTER_POINTER (GClosure     *closure,
+                                                                                GValue       *return_value G_GNUC_UNUSED,
+                                                                                guint         n_param_values,
+                                                                                const GValue *param_values,
+                                                                                gpointer      invocation_hint G_GNUC_UNUSED,
+                                                                                gpointer      marshal_data)
+{
+  typedef gboolean (*GMarshalFunc_BOOLEAN__UINT64_POINTER_POINTER_POINTER_POINTER) (gpointer     data1,
+                                                                                    guint64      arg_1,
+                                                                                    gpointer     arg_2,
+                                                                                    gpointer     arg_3,
+                                                                                    gpointer     arg_4,
+                                                                                    gpointer     arg_5,
+                                                                                    gpointer     data2);
+  register GMarshalFunc_BOOLEAN__UINT64_POINTER_POINTER_POINTER_POINTER callback;
+  register GCClosure *cc = (GCClosure*) closure;
+  register gpointer data1, data2;
+  gboolean v_return;
+
+  g_return_if_fail (return_value != NULL);
+  g_return_if_fail (n_param_values == 6);
+
+  if (G_CCLOSURE_SWAP_DATA (closure))
+    {
+      data1 = closure->data;
+      data2 = g_value_peek_pointer (param_values + 0);
+    }
+  else
+    {
+      data1 = g_value_peek_pointer (param_values + 0);
+      data2 = closure->data;
+    }
+  callback = (GMarshalFunc_BOOLEAN__UINT64_POINTER_POINTER_POINTER_POINTER) (marshal_data ? marshal_data : cc->callback);
+
+  v_return = callback (data1,
+                       g_marshal_value_peek_uint64 (param_values + 1),
+                       g_marshal_value_peek_pointer (param_values + 2),
+                       g_marshal_value_peek_pointer (param_values + 3),
+                       g_marshal_value_peek_pointer (param_values + 4),
+                       g_marshal_value_peek_pointer (param_values + 5),
+                       data2);
+
+  g_value_set_boolean (return_value, v_return);
+}
+
+/* BOOLEAN:UINT64,UINT64,POINTER,POINTER */
+extern void dbus_glib_marshal_mountmonitor_BOOLEAN__UINT64_UINT64_POINTER_POINTER (GClosure     *closure,
+                                                                                   GValue       *return_value,
+                                                                                   guint         n_param_values,
+                                                                                   const GValue *param_values,
+                                                                                   gpointer      invocation_hint,
+                                                                                   gpointer      marshal_data);
+void
+dbus_glib_marshal_mountmonitor_BOOLEAN__UINT64_UINT64_POINTER_POINTER (GClosure     *closure,
+                                                                       GValue       *return_value G_GNUC_UNUSED,
+                                                                       guint         n_param_values,
+                                                                       const GValue *param_values,
+                                                                       gpointer      invocation_hint G_GNUC_UNUSED,
+                                                                       gpointer      marshal_data)
+{
+  typedef gboolean (*GMarshalFunc_BOOLEAN__UINT64_UINT64_POINTER_POINTER) (gpointer     data1,
+                                                                           guint64      arg_1,
+                                                                           guint64      arg_2,
+                                                                           gpointer     arg_3,
+                                                                           gpointer     arg_4,
+                                                                           gpointer     data2);
+  register GMarshalFunc_BOOLEAN__UINT64_UINT64_POINTER_POINTER callback;
+  register GCClosure *cc = (GCClosure*) closure;
+  register gpointer data1, data2;
+  gboolean v_return;
+
+  g_return_if_fail (return_value != NULL);
+  g_return_if_fail (n_param_values == 5);
+
+  if (G_CCLOSURE_SWAP_DATA (closure))
+    {
+      data1 = closure->data;
+      data2 = g_value_peek_pointer (param_values + 0);
+    }
+  else
+    {
+      data1 = g_value_peek_pointer (param_values + 0);
+      data2 = closure->data;
+    }
+  callback = (GMarshalFunc_BOOLEAN__UINT64_UINT64_POINTER_POINTER) (marshal_data ? marshal_data : cc->callback);
+
+  v_return = callback (data1,
+                       g_marshal_value_peek_uint64 (param_values + 1),
+                       g_marshal_value_peek_uint64 (param_values + 2),
+                       g_marshal_value_peek_pointer (param_values + 3),
+                       g_marshal_value_peek_pointer (param_values + 4),
+                       data2);
+
+  g_value_set_boolean (return_value, v_return);
+}
+
+/* NONE:BOXED,POINTER */
+extern void dbus_glib_marshal_mountmonitor_NONE__BOXED_POINTER (GClosure     *closure,
+                                                                GValue       *return_value,
+                                                                guint         n_param_values,
+                                                                const GValue *param_values,
+                                                                gpointer      invocation_hint,
+                                                                gpointer      marshal_data);
+void
+dbus_glib_marshal_mountmonitor_NONE__BOXED_POINTER (GClosure     *closure,
+                                                    GValue       *return_value G_GNUC_UNUSED,
+                                                    guint         n_param_values,
+                                                    const GValue *param_values,
+                                                    gpointer      invocation_hint G_GNUC_UNUSED,
+                                                    gpointer      marshal_data)
+{
+  typedef void (*GMarshalFunc_NONE__BOXED_POINTER) (gpointer     data1,
+                                                    gpointer     arg_1,
+                                                    gpointer     arg_2,
+                                                    gpointer     data2);
+  register GMarshalFunc_NONE__BOXED_POINTER callback;
+  register GCClosure *cc = (GCClosure*) closure;
+  register gpointer data1, data2;
+
+  g_return_if_fail (n_param_values == 3);
+
+  if (G_CCLOSURE_SWAP_DATA (closure))
+    {
+      data1 = closure->data;
+      data2 = g_value_peek_pointer (param_values + 0);
+    }
+  else
+    {
+      data1 = g_value_peek_pointer (param_values + 0);
+      data2 = closure->data;
+    }
+  callback = (GMarshalFunc_NONE__BOXED_POINTER) (marshal_data ? marshal_data : cc->callback);
+
+  callback (data1,
+            g_marshal_value_peek_boxed (param_values + 1),
+            g_marshal_value_peek_pointer (param_values + 2),
+            data2);
+}
+
+/* NONE:POINTER */
+extern void dbus_glib_marshal_mountmonitor_NONE__POINTER (GClosure     *closure,
+                                                          GValue       *return_value,
+                                                          guint         n_param_values,
+                                                          const GValue *param_values,
+                                                          gpointer      invocation_hint,
+                                                          gpointer      marshal_data);
+void
+dbus_glib_marshal_mountmonitor_NONE__POINTER (GClosure     *closure,
+                                              GValue       *return_value G_GNUC_UNUSED,
+                                              guint         n_param_values,
+                                              const GValue *param_values,
+                                              gpointer      invocation_hint G_GNUC_UNUSED,
+                                              gpointer      marshal_data)
+{
+  typedef void (*GMarshalFunc_NONE__POINTER) (gpointer     data1,
+                                              gpointer     arg_1,
+                                              gpointer     data2);
+  register GMarshalFunc_NONE__POINTER callback;
+  register GCClosure *cc = (GCClosure*) closure;
+  register gpointer data1, data2;
+
+  g_return_if_fail (n_param_values == 2);
+
+  if (G_CCLOSURE_SWAP_DATA (closure))
+    {
+      data1 = closure->data;
+      data2 = g_value_peek_pointer (param_values + 0);
+    }
+  else
+    {
+      data1 = g_value_peek_pointer (param_values + 0);
+      data2 = closure->data;
+    }
+  callback = (GMarshalFunc_NONE__POINTER) (marshal_data ? marshal_data : cc->callback);
+
+  callback (data1,
+            g_marshal_value_peek_pointer (param_values + 1),
+            data2);
+}
+
+/* NONE:UINT,POINTER */
+extern void dbus_glib_marshal_mountmonitor_NONE__UINT_POINTER (GClosure     *closure,
+                                                               GValue       *return_value,
+                                                               guint         n_param_values,
+                                                               const GValue *param_values,
+                                                               gpointer      invocation_hint,
+                                                               gpointer      marshal_data);
+void
+dbus_glib_marshal_mountmonitor_NONE__UINT_POINTER (GClosure     *closure,
+                                                   GValue       *return_value G_GNUC_UNUSED,
+                                                   guint         n_param_values,
+                                                   const GValue *param_values,
+                                                   gpointer      invocation_hint G_GNUC_UNUSED,
+                                                   gpointer      marshal_data)
+{
+  typedef void (*GMarshalFunc_NONE__UINT_POINTER) (gpointer     data1,
+                                                   guint        arg_1,
+                                                   gpointer     arg_2,
+                                                   gpointer     data2);
+  register GMarshalFunc_NONE__UINT_POINTER callback;
+  register GCClosure *cc = (GCClosure*) closure;
+  register gpointer data1, data2;
+
+  g_return_if_fail (n_param_values == 3);
+
+  if (G_CCLOSURE_SWAP_DATA (closure))
+    {
+      data1 = closure->data;
+      data2 = g_value_peek_pointer (param_values + 0);
+    }
+  else
+    {
+      data1 = g_value_peek_pointer (param_values + 0);
+      data2 = closure->data;
+    }
+  callback = (GMarshalFunc_NONE__UINT_POINTER) (marshal_data ? marshal_data : cc->callback);
+
+  callback (data1,
+            g_marshal_value_peek_uint (param_values + 1),
+            g_marshal_value_peek_pointer (param_values + 2),
+            data2);
+}
+
 G_END_DECLS
 
 #endif /* __dbus_glib_marshal_mountmonitor_MARSHAL_H__ */
 
 #include <dbus/dbus-glib.h>
 static const DBusGMethodInfo dbus_glib_mountmonitor_methods[] = {
+  { (GCallback) mount_monitor_dbus_watch_namespace, dbus_glib_marshal_mountmonitor_NONE__UINT_POINTER, 0 },
+  { (GCallback) mount_monitor_unwatch_namespace, dbus_glib_marshal_mountmonitor_BOOLEAN__UINT64_POINTER, 74 },
+  { (GCallback) mount_monitor_dbus_get_mounts, dbus_glib_marshal_mountmonitor_BOOLEAN__POINTER_POINTER_POINTER, 138 },
+  { (GCallback) mount_monitor_dbus_get_changes_since, dbus_glib_marshal_mountmonitor_BOOLEAN__UINT64_POINTER_POINTER_POINTER_POINTER, 229 },
+  { (GCallback) mount_monitor_dbus_open_shared_table, dbus_glib_marshal_mountmonitor_NONE__POINTER, 356 },
+  { (GCallback) mount_monitor_dbus_subscribe, dbus_glib_marshal_mountmonitor_NONE__BOXED_POINTER, 420 },
+  { (GCallback) mount_monitor_dbus_unsubscribe, dbus_glib_marshal_mountmonitor_NONE__UINT_POINTER, 493 },
+  { (GCallback) mount_monitor_dbus_get_mounts_for_dev, dbus_glib_marshal_mountmonitor_BOOLEAN__UINT64_POINTER_POINTER, 549 },
+  { (GCallback) mount_monitor_dbus_get_mounts_under, dbus_glib_marshal_mountmonitor_BOOLEAN__STRING_POINTER_POINTER, 635 },
+  { (GCallback) mount_monitor_dbus_get_mount_subtree, dbus_glib_marshal_mountmonitor_BOOLEAN__UINT64_UINT64_POINTER_POINTER, 724 },
+  { (GCallback) mount_monitor_dbus_is_dev_in_use, dbus_glib_marshal_mountmonitor_BOOLEAN__UINT64_POINTER_POINTER_POINTER, 828 },
 };
 
 const DBusGObjectInfo dbus_glib_mountmonitor_object_info = {  1,
   dbus_glib_mountmonitor_methods,
-  0,
-"\0",
-"org.freedesktop.MountMonitor.Base\0MountAdded\0org.freedesktop.MountMonitor.Base\0MountRemoved\0\0",
-"\0"
+  11,
+"org.freedesktop.MountMonitor.Base\0WatchNamespace\0A\0pid\0I\0u\0ns_id\0O\0F\0N\0t\0\0org.freedesktop.MountMonitor.Base\0UnwatchNamespace\0S\0ns_id\0I\0t\0\0org.freedesktop.MountMonitor.Base\0GetMounts\0S\0generation\0O\0F\0N\0t\0mounts\0O\0F\0N\0a(tstsssss)\0\0org.freedesktop.MountMonitor.Base\0GetChangesSince\0S\0since\0I\0t\0generation\0O\0F\0N\0t\0snapshot\0O\0F\0N\0b\0changes\0O\0F\0N\0a(tbtstsssss)\0\0org.freedesktop.MountMonitor.Base\0OpenSharedTable\0A\0fd\0O\0F\0N\0h\0\0org.freedesktop.MountMonitor.Base\0Subscribe\0A\0filter\0I\0a{sv}\0id\0O\0F\0N\0u\0\0org.freedesktop.MountMonitor.Base\0Unsubscribe\0A\0id\0I\0u\0\0org.freedesktop.MountMonitor.Base\0GetMountsForDev\0S\0dev\0I\0t\0mounts\0O\0F\0N\0a(tstsssss)\0\0org.freedesktop.MountMonitor.Base\0GetMountsUnder\0S\0path\0I\0s\0mounts\0O\0F\0N\0a(tttstssssss)\0\0org.freedesktop.MountMonitor.Base\0GetMountSubtree\0S\0ns_id\0I\0t\0mount_id\0I\0t\0mounts\0O\0F\0N\0a(tttstssssss)\0\0org.freedesktop.MountMonitor.Base\0IsDevInUse\0S\0dev\0I\0t\0in_use\0O\0F\0N\0b\0type\0O\0F\0N\0s\0\0\0",
+"org.freedesktop.MountMonitor.Base\0MountAdded\0org.freedesktop.MountMonitor.Base\0MountRemoved\0org.freedesktop.MountMonitor.Base\0MountsChanged\0org.freedesktop.MountMonitor.Base\0MountChanged\0org.freedesktop.MountMonitor.Base\0SwapAdded\0org.freedesktop.MountMonitor.Base\0SwapRemoved\0\0",
+"org.freedesktop.MountMonitor.Base\0Reloads\0reloads\0read\0org.freedesktop.MountMonitor.Base\0UnchangedReloads\0unchanged_reloads\0read\0org.freedesktop.MountMonitor.Base\0BytesRead\0bytes_read\0read\0org.freedesktop.MountMonitor.Base\0LinesScanned\0lines_scanned\0read\0org.freedesktop.MountMonitor.Base\0LinesParsed\0lines_parsed\0read\0org.freedesktop.MountMonitor.Base\0ReadTime\0read_time\0read\0org.freedesktop.MountMonitor.Base\0ParseTime\0parse_time\0read\0org.freedesktop.MountMonitor.Base\0DiffTime\0diff_time\0read\0org.freedesktop.MountMonitor.Base\0KernelEvents\0kernel_events\0read\0org.freedesktop.MountMonitor.Base\0CoalescedEvents\0coalesced_events\0read\0org.freedesktop.MountMonitor.Base\0Records\0records\0read\0org.freedesktop.MountMonitor.Base\0Mounts\0mounts\0read\0org.freedesktop.MountMonitor.Base\0UdisksLookups\0udisks_lookups\0read\0org.freedesktop.MountMonitor.Base\0UdisksMisses\0udisks_misses\0read\0org.freedesktop.MountMonitor.Base\0UdisksCacheHits\0udisks_cache_hits\0read\0org.freedesktop.MountMonitor.Base\0UdisksLookupTime\0udisks_lookup_time\0read\0org.freedesktop.MountMonitor.Base\0UnresolvedRemovals\0unresolved_removals\0read\0org.freedesktop.MountMonitor.Base\0MountAddedSignals\0mount_added_signals\0read\0org.freedesktop.MountMonitor.Base\0MountRemovedSignals\0mount_removed_signals\0read\0org.freedesktop.MountMonitor.Base\0MountsChangedSignals\0mounts_changed_signals\0read\0org.freedesktop.MountMonitor.Base\0SwapAddedSignals\0swap_added_signals\0read\0org.freedesktop.MountMonitor.Base\0SwapRemovedSignals\0swap_removed_signals\0read\0org.freedesktop.MountMonitor.Base\0MountEventSignals\0mount_event_signals\0read\0org.freedesktop.MountMonitor.Base\0MountChangedSignals\0mount_changed_signals\0read\0\0"
 };
 
@@ -1,452 +1,1765 @@
 #include "mountmonitor.h"
 #include <string.h>
 #include <stdio.h>
-#include <sys/stat.h>
+#include <unistd.h>
+#include <sys/sysmacros.h>
+#include <dbus/dbus-glib-lowlevel.h>
+#include "snapshot.h"
 
-static GList *device_info_list = NULL;
+/* Added mounts resolved per main loop iteration */
+#define RESOLVE_BATCH_SIZE 32
+/* How long an added mount waits for its block object to appear in UDisks */
+#define RESOLVE_TIMEOUT_USEC (5 * G_USEC_PER_SEC)
+#define RESOLVE_RETRY_MS 250
 
 G_DEFINE_TYPE (MountMonitor, mount_monitor, G_TYPE_OBJECT)
 
+/* Arguments of one MountEvent, the same for every subscriber it goes to */
+typedef struct _MountEvent MountEvent;
+struct _MountEvent
+{
+    DBusConnection *connection;
+    guint64 generation;
+    dbus_bool_t added;
+    guint64 ns_id;
+    const gchar *path;
+    guint64 dev;
+    const gchar *type;
+    const gchar *serial;
+    const gchar *vendor;
+    const gchar *model;
+    const gchar *uuid;
+    const gchar *fstype;
+    /* counts the signals sent */
+    guint64 *sent;
+};
+
 static guint signals[LAST_SIGNAL] = { 0 };
 
-MountMonitor *
-mount_monitor_new (void)
+static void pending_mount_free (PendingMount *pending);
+static void schedule_publish (MountMonitor *monitor);
+static void on_worker_event (MountWorker      *worker,
+                             MountWorkerEvent *event,
+                             gpointer          user_data);
+
+enum
+{
+    PROP_0,
+    PROP_BACKEND,
+    PROP_MOUNTINFO_PATH,
+    /* one read-only property per entry of mount_metrics_info */
+    PROP_METRIC_FIRST
+};
+
+GQuark
+mount_monitor_error_quark (void)
+{
+    return g_quark_from_static_string ("mount-monitor-error-quark");
+}
+
+/* Registered with dbus-glib, which sends the nicks as D-Bus error names */
+GType
+mount_monitor_error_get_type (void)
+{
+    static GType etype = 0;
+
+    if (etype == 0)
+    {
+        static const GEnumValue values[] =
+        {
+            { MOUNT_MONITOR_ERROR_FAILED, "MOUNT_MONITOR_ERROR_FAILED", "Failed" },
+            { MOUNT_MONITOR_ERROR_NOT_FOUND, "MOUNT_MONITOR_ERROR_NOT_FOUND", "NotFound" },
+            { MOUNT_MONITOR_ERROR_INVALID_ARGS, "MOUNT_MONITOR_ERROR_INVALID_ARGS", "InvalidArgs" },
+            { 0, NULL, NULL }
+        };
+
+        etype = g_enum_register_static ("MountMonitorError", values);
+    }
+
+    return etype;
+}
+
+/* mountinfo_path replaces our own namespace's mount table with a regular
+ * file, see mount_namespace_new_for_file(); NULL for the real one
+ */
+MountMonitor *
+mount_monitor_new (MountBackend  backend,
+                   const gchar  *mountinfo_path)
+{
+    return MOUNT_MONITOR (g_object_new (MOUNT_MONITOR_TYPE,
+                                        "backend", backend,
+                                        "mountinfo-path", mountinfo_path,
+                                        NULL));
+}
+
+/* The backend in use for our own namespace */
+MountBackend
+mount_monitor_get_backend (MountMonitor *monitor)
+{
+    g_return_val_if_fail (IS_MOUNT_MONITOR (monitor), MOUNT_BACKEND_MOUNTINFO);
+    return monitor->backend;
+}
+
+void
+mount_monitor_set_signal_mode (MountMonitor    *monitor,
+                               MountSignalMode  mode)
+{
+    g_return_if_fail (IS_MOUNT_MONITOR (monitor));
+    monitor->signal_mode = mode;
+}
+
+/* Drops the change history and keeps the last size changes from now on */
+void
+mount_monitor_set_history_size (MountMonitor *monitor,
+                                guint         size)
+{
+    guint64 generation;
+
+    g_return_if_fail (IS_MOUNT_MONITOR (monitor));
+
+    generation = event_ring_get_generation (monitor->history);
+    event_ring_free (monitor->history);
+    monitor->history = event_ring_new (size, generation);
+}
+
+/* Applies to every watched namespace, including those added later */
+void
+mount_monitor_set_coalescing (MountMonitor *monitor,
+                              guint         min_interval_ms,
+                              guint         max_latency_ms)
+{
+    g_return_if_fail (IS_MOUNT_MONITOR (monitor));
+    monitor->coalesce_min_ms = min_interval_ms;
+    monitor->coalesce_max_ms = MAX (min_interval_ms, max_latency_ms);
+
+    mount_worker_set_coalescing (monitor->worker, monitor->coalesce_min_ms, monitor->coalesce_max_ms);
+}
+
+/* The counters of the monitor and all of its namespaces, with the gauges
+ * brought up to date.  Owned by the monitor.  The worker's counters are as
+ * of its last scan.
+ */
+MountMetrics *
+mount_monitor_get_metrics (MountMonitor *monitor)
+{
+    GHashTableIter iter;
+    MountMirror *mirror;
+
+    g_return_val_if_fail (IS_MOUNT_MONITOR (monitor), NULL);
+
+    mount_worker_collect_metrics (monitor->worker, monitor->metrics);
+    monitor->metrics->mounts = 0;
+    g_hash_table_iter_init (&iter, monitor->namespaces);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &mirror))
+        monitor->metrics->mounts += g_hash_table_size (mirror->mounts);
+
+    return monitor->metrics;
+}
+
+/* Unique names are never reused, so once one loses its owner the client
+ * is gone for good
+ */
+static void
+on_name_owner_changed (DBusGProxy  *proxy,
+                       const gchar *name,
+                       const gchar *old_owner,
+                       const gchar *new_owner,
+                       gpointer     user_data)
+{
+    MountMonitor *monitor = MOUNT_MONITOR (user_data);
+
+    if (name[0] == ':' && new_owner[0] == '\0')
+        subscription_table_remove_owner (monitor->subscriptions, name);
+}
+
+/* The connection the object is exported on.  MountEvent signals for the
+ * subscribers are sent over it, and subscriptions are dropped when their
+ * client leaves the bus.
+ */
+void
+mount_monitor_set_connection (MountMonitor    *monitor,
+                              DBusGConnection *connection)
+{
+    g_return_if_fail (IS_MOUNT_MONITOR (monitor));
+    g_return_if_fail (monitor->connection == NULL);
+
+    monitor->connection = dbus_g_connection_ref (connection);
+    monitor->bus_proxy = dbus_g_proxy_new_for_name (connection, DBUS_SERVICE_DBUS,
+                                                    DBUS_PATH_DBUS, DBUS_INTERFACE_DBUS);
+    dbus_g_proxy_add_signal (monitor->bus_proxy, "NameOwnerChanged",
+                             G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_INVALID);
+    dbus_g_proxy_connect_signal (monitor->bus_proxy, "NameOwnerChanged",
+                                 G_CALLBACK (on_name_owner_changed), monitor, NULL);
+}
+
+static void
+mount_monitor_finalize (GObject *object)
+{
+    MountMonitor *monitor = MOUNT_MONITOR (object);
+    GHashTableIter iter;
+    GSList *waiting;
+    GSList *l;
+    GError *error;
+
+    mount_worker_free (monitor->worker);
+    g_hash_table_unref (monitor->namespaces);
+    /* the worker won't answer them any more */
+    error = g_error_new (MOUNT_MONITOR_ERROR, MOUNT_MONITOR_ERROR_FAILED, "Shutting down");
+    g_hash_table_iter_init (&iter, monitor->pending_watches);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &waiting))
+    {
+        for (l = waiting; l != NULL; l = l->next)
+            dbus_g_method_return_error (l->data, error);
+        g_slist_free (waiting);
+    }
+    g_error_free (error);
+    g_hash_table_unref (monitor->pending_watches);
+    device_index_free (monitor->devices);
+    if (monitor->resolve_source_id != 0)
+        g_source_remove (monitor->resolve_source_id);
+    g_hash_table_unref (monitor->pending_by_mount);
+    g_queue_free_full (monitor->pending_mounts, (GDestroyNotify) pending_mount_free);
+    g_hash_table_unref (monitor->batches);
+    g_hash_table_unref (monitor->device_infos);
+    event_ring_free (monitor->history);
+    if (monitor->bus_proxy != NULL)
+    {
+        dbus_g_proxy_disconnect_signal (monitor->bus_proxy, "NameOwnerChanged",
+                                        G_CALLBACK (on_name_owner_changed), monitor);
+        g_object_unref (monitor->bus_proxy);
+    }
+    if (monitor->connection != NULL)
+        dbus_g_connection_unref (monitor->connection);
+    subscription_table_free (monitor->subscriptions);
+    mount_metrics_free (monitor->metrics);
+    if (monitor->publish_source_id != 0)
+        g_source_remove (monitor->publish_source_id);
+    shared_table_free (monitor->shared_table);
+    mount_journal_free (monitor->journal);
+    g_free (monitor->mountinfo_path);
+
+    if (G_OBJECT_CLASS (mount_monitor_parent_class)->finalize != NULL)
+    G_OBJECT_CLASS (mount_monitor_parent_class)->finalize (object);
+}
+
+/* Starts watching the mount namespace of pid.  Only the new namespace is
+ * read; its current mounts are not announced.  Watching a namespace twice
+ * just returns its ID again.  Waits for the worker to read it, so it is
+ * meant for startup; D-Bus callers go through
+ * mount_monitor_dbus_watch_namespace().
+ */
+gboolean
+mount_monitor_watch_namespace (MountMonitor  *monitor,
+                               guint          pid,
+                               guint64       *out_ns_id,
+                               GError       **error)
+{
+    GError *local_error;
+    guint64 ns_id;
+
+    g_return_val_if_fail (IS_MOUNT_MONITOR (monitor), FALSE);
+
+    local_error = NULL;
+    if (pid == 0 || !mount_namespace_get_id_for_pid (pid, &ns_id, &local_error))
+    {
+        g_set_error (error, MOUNT_MONITOR_ERROR, MOUNT_MONITOR_ERROR_NOT_FOUND,
+                     "No mount namespace for pid %u%s%s", pid,
+                     local_error != NULL ? ": " : "",
+                     local_error != NULL ? local_error->message : "");
+        g_clear_error (&local_error);
+        return FALSE;
+    }
+
+    if (g_hash_table_contains (monitor->namespaces, &ns_id))
+    {
+        *out_ns_id = ns_id;
+        return TRUE;
+    }
+
+    if (!mount_worker_watch_namespace (monitor->worker, pid, NULL, monitor->backend,
+                                       &ns_id, NULL, &local_error))
+    {
+        g_set_error (error, MOUNT_MONITOR_ERROR, MOUNT_MONITOR_ERROR_FAILED,
+                     "Error watching mount namespace of pid %u: %s", pid, local_error->message);
+        g_error_free (local_error);
+        return FALSE;
+    }
+    /* picks up the baseline, which makes the namespace known here */
+    mount_worker_dispatch (monitor->worker);
+
+    *out_ns_id = ns_id;
+    return TRUE;
+}
+
+/* D-Bus: WatchNamespace.  The same as mount_monitor_watch_namespace(),
+ * except that the reply waits for the worker's BASELINE event instead of
+ * the main loop waiting for the worker.
+ */
+gboolean
+mount_monitor_dbus_watch_namespace (MountMonitor          *monitor,
+                                    guint                  pid,
+                                    DBusGMethodInvocation *context)
+{
+    GError *local_error;
+    GError *error;
+    GSList *waiting;
+    guint64 *key;
+    guint64 ns_id;
+
+    local_error = NULL;
+    if (pid == 0 || !mount_namespace_get_id_for_pid (pid, &ns_id, &local_error))
+    {
+        error = g_error_new (MOUNT_MONITOR_ERROR, MOUNT_MONITOR_ERROR_NOT_FOUND,
+                             "No mount namespace for pid %u%s%s", pid,
+                             local_error != NULL ? ": " : "",
+                             local_error != NULL ? local_error->message : "");
+        g_clear_error (&local_error);
+        dbus_g_method_return_error (context, error);
+        g_error_free (error);
+        return TRUE;
+    }
+
+    if (g_hash_table_contains (monitor->namespaces, &ns_id))
+    {
+        dbus_g_method_return (context, ns_id);
+        return TRUE;
+    }
+
+    /* a read of it is on its way already */
+    waiting = g_hash_table_lookup (monitor->pending_watches, &ns_id);
+    if (waiting != NULL)
+    {
+        waiting = g_slist_append (waiting, context);
+        return TRUE;
+    }
+
+    key = g_new (guint64, 1);
+    *key = ns_id;
+    g_hash_table_insert (monitor->pending_watches, key, g_slist_prepend (NULL, context));
+    mount_worker_watch_namespace_async (monitor->worker, pid, monitor->backend, ns_id);
+    return TRUE;
+}
+
+/* Answers the WatchNamespace calls waiting for request_id, with ns_id or
+ * with error if that is set
+ */
+static void
+reply_pending_watches (MountMonitor *monitor,
+                       guint64       request_id,
+                       guint64       ns_id,
+                       const GError *error)
+{
+    GSList *waiting;
+    GSList *l;
+
+    waiting = g_hash_table_lookup (monitor->pending_watches, &request_id);
+    if (waiting == NULL)
+        return;
+    g_hash_table_remove (monitor->pending_watches, &request_id);
+
+    for (l = waiting; l != NULL; l = l->next)
+    {
+        if (error != NULL)
+            dbus_g_method_return_error (l->data, (GError *) error);
+        else
+            dbus_g_method_return (l->data, ns_id);
+    }
+    g_slist_free (waiting);
+}
+
+/* Stops watching a namespace.  Mounts of it still waiting for MountAdded
+ * are dropped, and no MountRemoved is sent for its current mounts.
+ */
+gboolean
+mount_monitor_unwatch_namespace (MountMonitor  *monitor,
+                                 guint64        ns_id,
+                                 GError       **error)
+{
+    GHashTableIter iter;
+    MountInfo *mount;
+    GList *link;
+    GList *next;
+
+    g_return_val_if_fail (IS_MOUNT_MONITOR (monitor), FALSE);
+
+    if (!g_hash_table_contains (monitor->namespaces, &ns_id))
+    {
+        g_set_error (error, MOUNT_MONITOR_ERROR, MOUNT_MONITOR_ERROR_NOT_FOUND,
+                     "Mount namespace %" G_GUINT64_FORMAT " is not watched", ns_id);
+        return FALSE;
+    }
+    /* it also carries the swaps */
+    if (ns_id == monitor->self_ns_id)
+    {
+        g_set_error (error, MOUNT_MONITOR_ERROR, MOUNT_MONITOR_ERROR_FAILED,
+                     "The daemon's own mount namespace is always watched");
+        return FALSE;
+    }
+
+    for (link = monitor->pending_mounts->head; link != NULL; link = next)
+    {
+        PendingMount *pending = link->data;
+
+        next = link->next;
+        if (pending->mount->ns_id != ns_id)
+            continue;
+        g_hash_table_remove (monitor->pending_by_mount, pending->mount);
+        g_queue_delete_link (monitor->pending_mounts, link);
+        pending_mount_free (pending);
+    }
+
+    g_hash_table_iter_init (&iter, monitor->device_infos);
+    while (g_hash_table_iter_next (&iter, (gpointer *) &mount, NULL))
+    {
+        if (mount->ns_id == ns_id)
+            g_hash_table_iter_remove (&iter);
+    }
+
+    g_hash_table_remove (monitor->batches, &ns_id);
+    /* events of it that are still queued are dropped from now on */
+    g_hash_table_remove (monitor->namespaces, &ns_id);
+    mount_worker_unwatch_namespace (monitor->worker, ns_id);
+    schedule_publish (monitor);
+
+    return TRUE;
+}
+
+/* Returns the mounts and swaps of dev in every watched namespace, each with
+ * a reference.  Only the per-device indexes are consulted.
+ */
+GList *
+mount_monitor_get_mounts_for_dev (MountMonitor *monitor,
+                                  dev_t         dev)
+{
+    GHashTableIter iter;
+    MountMirror *mirror;
+    GList *ret;
+    GList *l;
+
+    g_return_val_if_fail (IS_MOUNT_MONITOR (monitor), NULL);
+
+    ret = NULL;
+    g_hash_table_iter_init (&iter, monitor->namespaces);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &mirror))
+    {
+        for (l = mount_mirror_get_mounts_for_dev (mirror, dev); l != NULL; l = l->next)
+            ret = g_list_prepend (ret, mount_info_ref (l->data));
+    }
+
+    return ret;
+}
+
+/* TRUE if dev is mounted or used as swap in any watched namespace */
+gboolean
+mount_monitor_is_dev_in_use (MountMonitor *monitor,
+                             dev_t         dev,
+                             MountType    *out_type)
+{
+    GHashTableIter iter;
+    MountMirror *mirror;
+    GList *mounts;
+
+    g_return_val_if_fail (IS_MOUNT_MONITOR (monitor), FALSE);
+
+    g_hash_table_iter_init (&iter, monitor->namespaces);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &mirror))
+    {
+        mounts = mount_mirror_get_mounts_for_dev (mirror, dev);
+        if (mounts == NULL)
+            continue;
+        if (out_type != NULL)
+            *out_type = MOUNT_INFO (mounts->data)->type;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+value_array_append_uint64 (GValueArray *array,
+                           guint64      v)
+{
+    GValue value = G_VALUE_INIT;
+
+    g_value_init (&value, G_TYPE_UINT64);
+    g_value_set_uint64 (&value, v);
+    g_value_array_append (array, &value);
+    g_value_unset (&value);
+}
+
+static void
+value_array_append_string (GValueArray *array,
+                           const gchar *str)
+{
+    GValue value = G_VALUE_INIT;
+
+    /* D-Bus strings can't be NULL */
+    g_value_init (&value, G_TYPE_STRING);
+    g_value_set_string (&value, str != NULL ? str : "");
+    g_value_array_append (array, &value);
+    g_value_unset (&value);
+}
+
+/* (ns_id, path, dev, type, serial, vendor, model, uuid).  The device
+ * fields stay empty until the mount has been announced.
+ */
+static GValueArray *
+mount_to_value_array (MountMonitor *monitor,
+                      MountInfo    *mount)
+{
+    GValueArray *item;
+    DeviceInfo *df;
+
+    df = g_hash_table_lookup (monitor->device_infos, mount);
+
+    item = g_value_array_new (8);
+    value_array_append_uint64 (item, mount->ns_id);
+    value_array_append_string (item, mount->mount_path);
+    value_array_append_uint64 (item, mount->dev);
+    value_array_append_string (item, mount->type == MOUNT_TYPE_SWAP ? "swap" : "filesystem");
+    value_array_append_string (item, df != NULL ? df->serial : NULL);
+    value_array_append_string (item, df != NULL ? df->vendor : NULL);
+    value_array_append_string (item, df != NULL ? df->model : NULL);
+    value_array_append_string (item, df != NULL ? df->uuid : NULL);
+
+    return item;
+}
+
+static GPtrArray *
+mount_array_new (void)
+{
+    return g_ptr_array_new_with_free_func ((GDestroyNotify) g_value_array_free);
+}
+
+static gboolean
+publish_shared_table (gpointer user_data)
+{
+    MountMonitor *monitor = MOUNT_MONITOR (user_data);
+    GHashTableIter ns_iter;
+    GHashTableIter iter;
+    MountMirror *mirror;
+    MountInfo *mount;
+    DeviceInfo *df;
+    GError *error;
+
+    monitor->publish_source_id = 0;
+
+    shared_table_begin (monitor->shared_table);
+    g_hash_table_iter_init (&ns_iter, monitor->namespaces);
+    while (g_hash_table_iter_next (&ns_iter, NULL, (gpointer *) &mirror))
+    {
+        g_hash_table_iter_init (&iter, mirror->mounts);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &mount))
+        {
+            df = g_hash_table_lookup (monitor->device_infos, mount);
+            shared_table_add (monitor->shared_table, mount->ns_id, mount->dev,
+                              mount->mount_id, mount->parent_id,
+                              mount->type == MOUNT_TYPE_SWAP ? SHARED_TABLE_SWAP : SHARED_TABLE_FILESYSTEM,
+                              mount->mount_path, mount->fstype, mount->source, mount->options,
+                              df != NULL ? df->uuid : NULL, df != NULL ? df->serial : NULL,
+                              df != NULL ? df->vendor : NULL, df != NULL ? df->model : NULL);
+        }
+    }
+
+    error = NULL;
+    if (!shared_table_publish (monitor->shared_table, event_ring_get_generation (monitor->history), &error))
+    {
+        printf ("Error publishing the shared table: %s\n", error->message);
+        g_error_free (error);
+    }
+
+    return FALSE;
+}
+
+/* The shared table is rewritten as a whole, so changes made in one main
+ * loop iteration are published together
+ */
+static void
+schedule_publish (MountMonitor *monitor)
+{
+    if (monitor->shared_table == NULL || monitor->publish_source_id != 0)
+        return;
+    monitor->publish_source_id = g_idle_add (publish_shared_table, monitor);
+}
+
+/* D-Bus: OpenSharedTable, a read-only descriptor of the memfd the mount
+ * table is published in, see sharedtable.h.  Answered by hand, dbus-glib
+ * has no type for file descriptors.
+ */
+gboolean
+mount_monitor_dbus_open_shared_table (MountMonitor          *monitor,
+                                      DBusGMethodInvocation *context)
+{
+    DBusMessage *reply;
+    GError *error;
+    int fd;
+
+    error = NULL;
+    fd = -1;
+    if (monitor->shared_table == NULL || monitor->connection == NULL ||
+        !dbus_connection_can_send_type (dbus_g_connection_get_connection (monitor->connection),
+                                        DBUS_TYPE_UNIX_FD))
+        g_set_error (&error, MOUNT_MONITOR_ERROR, MOUNT_MONITOR_ERROR_FAILED,
+                     "The shared table is not available");
+    else
+        fd = shared_table_open_fd (monitor->shared_table, &error);
+
+    if (error != NULL)
+    {
+        dbus_g_method_return_error (context, error);
+        g_error_free (error);
+        return TRUE;
+    }
+
+    /* the message gets a duplicate */
+    reply = dbus_g_method_get_reply (context);
+    dbus_message_append_args (reply, DBUS_TYPE_UNIX_FD, &fd, DBUS_TYPE_INVALID);
+    dbus_g_method_send_reply (context, reply);
+    close (fd);
+
+    return TRUE;
+}
+
+/* D-Bus: GetMounts, everything in every watched namespace, together with
+ * the generation of the last change announced so far
+ */
+gboolean
+mount_monitor_dbus_get_mounts (MountMonitor  *monitor,
+                               guint64       *out_generation,
+                               GPtrArray    **out_mounts,
+                               GError       **error)
+{
+    GHashTableIter ns_iter;
+    GHashTableIter iter;
+    MountMirror *mirror;
+    MountInfo *mount;
+
+    *out_generation = event_ring_get_generation (monitor->history);
+    *out_mounts = mount_array_new ();
+
+    g_hash_table_iter_init (&ns_iter, monitor->namespaces);
+    while (g_hash_table_iter_next (&ns_iter, NULL, (gpointer *) &mirror))
+    {
+        g_hash_table_iter_init (&iter, mirror->mounts);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &mount))
+            g_ptr_array_add (*out_mounts, mount_to_value_array (monitor, mount));
+    }
+
+    return TRUE;
+}
+
+/* D-Bus: GetMountsForDev */
+gboolean
+mount_monitor_dbus_get_mounts_for_dev (MountMonitor  *monitor,
+                                       guint64        dev,
+                                       GPtrArray    **out_mounts,
+                                       GError       **error)
+{
+    GList *mounts;
+    GList *l;
+
+    *out_mounts = mount_array_new ();
+
+    mounts = mount_monitor_get_mounts_for_dev (monitor, dev);
+    for (l = mounts; l != NULL; l = l->next)
+        g_ptr_array_add (*out_mounts, mount_to_value_array (monitor, MOUNT_INFO (l->data)));
+    g_list_free_full (mounts, (GDestroyNotify) mount_info_unref);
+
+    return TRUE;
+}
+
+/* (ns_id, mount_id, parent_id, path, dev, root, fstype, source, options,
+ * super_options, propagation): the whole mountinfo record
+ */
+static GValueArray *
+mount_to_record_value_array (MountInfo *mount)
+{
+    GValueArray *item;
+
+    item = g_value_array_new (11);
+    value_array_append_uint64 (item, mount->ns_id);
+    value_array_append_uint64 (item, mount->mount_id);
+    value_array_append_uint64 (item, mount->parent_id);
+    value_array_append_string (item, mount->mount_path);
+    value_array_append_uint64 (item, mount->dev);
+    value_array_append_string (item, mount->root);
+    value_array_append_string (item, mount->fstype);
+    value_array_append_string (item, mount->source);
+    value_array_append_string (item, mount->options);
+    value_array_append_string (item, mount->super_options);
+    value_array_append_string (item, mount->propagation);
+
+    return item;
+}
+
+/* D-Bus: GetMountsUnder, the mounts at path or below it in every watched
+ * namespace
+ */
+gboolean
+mount_monitor_dbus_get_mounts_under (MountMonitor  *monitor,
+                                     const gchar   *path,
+                                     GPtrArray    **out_mounts,
+                                     GError       **error)
+{
+    GHashTableIter iter;
+    MountMirror *mirror;
+    GList *mounts;
+    GList *l;
+
+    if (path[0] != '/')
+    {
+        g_set_error (error, MOUNT_MONITOR_ERROR, MOUNT_MONITOR_ERROR_INVALID_ARGS,
+                     "'%s' is not an absolute path", path);
+        return FALSE;
+    }
+
+    *out_mounts = mount_array_new ();
+
+    g_hash_table_iter_init (&iter, monitor->namespaces);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &mirror))
+    {
+        mounts = mount_mirror_get_mounts_under (mirror, path);
+        for (l = mounts; l != NULL; l = l->next)
+            g_ptr_array_add (*out_mounts, mount_to_record_value_array (MOUNT_INFO (l->data)));
+        g_list_free (mounts);
+    }
+
+    return TRUE;
+}
+
+/* D-Bus: GetMountSubtree, a mount and everything mounted on it, directly
+ * or not, parents first
+ */
+gboolean
+mount_monitor_dbus_get_mount_subtree (MountMonitor  *monitor,
+                                      guint64        ns_id,
+                                      guint64        mount_id,
+                                      GPtrArray    **out_mounts,
+                                      GError       **error)
+{
+    MountMirror *mirror;
+    GList *mounts;
+    GList *l;
+
+    mirror = g_hash_table_lookup (monitor->namespaces, &ns_id);
+    mounts = mirror != NULL ? mount_mirror_get_subtree (mirror, mount_id) : NULL;
+    if (mounts == NULL)
+    {
+        g_set_error (error, MOUNT_MONITOR_ERROR, MOUNT_MONITOR_ERROR_NOT_FOUND,
+                     "No mount %" G_GUINT64_FORMAT " in mount namespace %" G_GUINT64_FORMAT,
+                     mount_id, ns_id);
+        return FALSE;
+    }
+
+    *out_mounts = mount_array_new ();
+    for (l = mounts; l != NULL; l = l->next)
+        g_ptr_array_add (*out_mounts, mount_to_record_value_array (MOUNT_INFO (l->data)));
+    g_list_free (mounts);
+
+    return TRUE;
+}
+
+/* D-Bus: IsDevInUse; type is "filesystem", "swap" or "" */
+gboolean
+mount_monitor_dbus_is_dev_in_use (MountMonitor  *monitor,
+                                  guint64        dev,
+                                  gboolean      *out_in_use,
+                                  gchar        **out_type,
+                                  GError       **error)
+{
+    MountType type;
+
+    *out_in_use = mount_monitor_is_dev_in_use (monitor, dev, &type);
+    if (!*out_in_use)
+        *out_type = g_strdup ("");
+    else
+        *out_type = g_strdup (type == MOUNT_TYPE_SWAP ? "swap" : "filesystem");
+
+    return TRUE;
+}
+
+/* D-Bus: GetChangesSince.  Returns the changes after since, oldest first.
+ * If some of them are no longer kept, or since comes from before a restart
+ * and can't be placed, every announced mount is returned instead as an
+ * addition at the current generation, with snapshot set.
+ */
+gboolean
+mount_monitor_dbus_get_changes_since (MountMonitor  *monitor,
+                                      guint64        since,
+                                      guint64       *out_generation,
+                                      gboolean      *out_snapshot,
+                                      GPtrArray    **out_changes,
+                                      GError       **error)
+{
+    GHashTableIter iter;
+    MountInfo *mount;
+
+    *out_generation = event_ring_get_generation (monitor->history);
+    *out_changes = g_ptr_array_new_with_free_func ((GDestroyNotify) g_value_array_free);
+
+    *out_snapshot = !event_ring_collect_since (monitor->history, since, *out_changes);
+    if (!*out_snapshot)
+        return TRUE;
+
+    g_hash_table_iter_init (&iter, monitor->device_infos);
+    while (g_hash_table_iter_next (&iter, (gpointer *) &mount, NULL))
+    {
+        GValueArray *item = mount_to_value_array (monitor, mount);
+
+        g_ptr_array_add (*out_changes, event_ring_change_new (*out_generation, TRUE, item));
+        g_value_array_free (item);
+    }
+
+    return TRUE;
+}
+
+/* D-Bus: Subscribe.  filter may hold "path-prefix" (s), "fstype" (s),
+ * "dev" (t) and "uuid" (s); a change is sent to the caller as MountEvent
+ * if it matches all of them.  Returns the subscription ID.
+ */
+gboolean
+mount_monitor_dbus_subscribe (MountMonitor          *monitor,
+                              GHashTable            *filter,
+                              DBusGMethodInvocation *context)
+{
+    SubscriptionFilter parsed;
+    GHashTableIter iter;
+    const gchar *key;
+    GValue *value;
+    GError *error;
+    gchar *sender;
+    guint id;
+
+    memset (&parsed, 0, sizeof parsed);
+    error = NULL;
+
+    g_hash_table_iter_init (&iter, filter);
+    while (error == NULL && g_hash_table_iter_next (&iter, (gpointer *) &key, (gpointer *) &value))
+    {
+        if (strcmp (key, "path-prefix") == 0 && G_VALUE_HOLDS_STRING (value))
+            parsed.path_prefix = g_value_get_string (value);
+        else if (strcmp (key, "fstype") == 0 && G_VALUE_HOLDS_STRING (value))
+            parsed.fstype = g_value_get_string (value);
+        else if (strcmp (key, "uuid") == 0 && G_VALUE_HOLDS_STRING (value))
+            parsed.uuid = g_value_get_string (value);
+        else if (strcmp (key, "dev") == 0 && G_VALUE_HOLDS_UINT64 (value))
+        {
+            parsed.has_dev = TRUE;
+            parsed.dev = g_value_get_uint64 (value);
+        }
+        else
+            g_set_error (&error, MOUNT_MONITOR_ERROR, MOUNT_MONITOR_ERROR_INVALID_ARGS,
+                         "Unknown filter key '%s' or wrong value type", key);
+    }
+    if (error == NULL && parsed.path_prefix != NULL &&
+        parsed.path_prefix[0] != '\0' && parsed.path_prefix[0] != '/')
+        g_set_error (&error, MOUNT_MONITOR_ERROR, MOUNT_MONITOR_ERROR_INVALID_ARGS,
+                     "Path prefix '%s' is not absolute", parsed.path_prefix);
+    if (error == NULL && monitor->connection == NULL)
+        g_set_error (&error, MOUNT_MONITOR_ERROR, MOUNT_MONITOR_ERROR_FAILED,
+                     "Subscriptions are not available");
+
+    if (error != NULL)
+    {
+        dbus_g_method_return_error (context, error);
+        g_error_free (error);
+        return TRUE;
+    }
+
+    sender = dbus_g_method_get_sender (context);
+    id = subscription_table_add (monitor->subscriptions, sender, &parsed);
+    g_free (sender);
+
+    dbus_g_method_return (context, id);
+    return TRUE;
+}
+
+/* D-Bus: Unsubscribe; only the subscriber itself can cancel */
+gboolean
+mount_monitor_dbus_unsubscribe (MountMonitor          *monitor,
+                                guint                  id,
+                                DBusGMethodInvocation *context)
+{
+    gchar *sender;
+    gboolean removed;
+
+    sender = dbus_g_method_get_sender (context);
+    removed = subscription_table_remove (monitor->subscriptions, id, sender);
+    g_free (sender);
+
+    if (!removed)
+    {
+        GError *error = g_error_new (MOUNT_MONITOR_ERROR, MOUNT_MONITOR_ERROR_NOT_FOUND,
+                                     "No subscription %u of the caller", id);
+
+        dbus_g_method_return_error (context, error);
+        g_error_free (error);
+        return TRUE;
+    }
+
+    dbus_g_method_return (context);
+    return TRUE;
+}
+
+static void
+send_mount_event (Subscription *sub,
+                  gpointer      user_data)
+{
+    MountEvent *event = user_data;
+    DBusMessage *message;
+
+    message = dbus_message_new_signal (MOUNT_MONITOR_OBJECT_PATH, MOUNT_MONITOR_INTERFACE, "MountEvent");
+    if (message == NULL)
+        return;
+    /* unicast: the bus hands it to the subscriber only */
+    dbus_message_set_destination (message, sub->owner);
+    dbus_message_append_args (message,
+                              DBUS_TYPE_UINT32, &sub->id,
+                              DBUS_TYPE_UINT64, &event->generation,
+                              DBUS_TYPE_BOOLEAN, &event->added,
+                              DBUS_TYPE_UINT64, &event->ns_id,
+                              DBUS_TYPE_STRING, &event->path,
+                              DBUS_TYPE_UINT64, &event->dev,
+                              DBUS_TYPE_STRING, &event->type,
+                              DBUS_TYPE_STRING, &event->serial,
+                              DBUS_TYPE_STRING, &event->vendor,
+                              DBUS_TYPE_STRING, &event->model,
+                              DBUS_TYPE_STRING, &event->uuid,
+                              DBUS_TYPE_STRING, &event->fstype,
+                              DBUS_TYPE_INVALID);
+    if (dbus_connection_send (event->connection, message, NULL))
+        (*event->sent)++;
+    dbus_message_unref (message);
+}
+
+/* Matches one announced change against the subscriptions once and sends
+ * MountEvent to each subscriber it matched
+ */
+static void
+notify_subscribers (MountMonitor *monitor,
+                    MountInfo    *mount,
+                    DeviceInfo   *df,
+                    gboolean      added,
+                    guint64       generation)
+{
+    SubscriptionEvent match;
+    MountEvent event;
+
+    if (monitor->connection == NULL || subscription_table_size (monitor->subscriptions) == 0)
+        return;
+
+    match.path = mount->mount_path;
+    match.fstype = mount->fstype;
+    match.dev = mount->dev;
+    match.uuid = df != NULL ? df->uuid : NULL;
+
+    /* D-Bus strings can't be NULL */
+    event.connection = dbus_g_connection_get_connection (monitor->connection);
+    event.generation = generation;
+    event.added = added;
+    event.ns_id = mount->ns_id;
+    event.path = mount->mount_path != NULL ? mount->mount_path : "";
+    event.dev = mount->dev;
+    event.type = mount->type == MOUNT_TYPE_SWAP ? "swap" : "filesystem";
+    event.serial = df != NULL && df->serial != NULL ? df->serial : "";
+    event.vendor = df != NULL && df->vendor != NULL ? df->vendor : "";
+    event.model = df != NULL && df->model != NULL ? df->model : "";
+    event.uuid = df != NULL && df->uuid != NULL ? df->uuid : "";
+    event.fstype = mount->fstype != NULL ? mount->fstype : "";
+    event.sent = &monitor->metrics->mount_event_signals;
+
+    subscription_table_match (monitor->subscriptions, &match, send_mount_event, &event);
+}
+
+/* Fills in the device fields of df.  Returns FALSE if the block or drive
+ * object wasn't found; *out_cached tells whether UDisks was consulted at all.
+ */
+static gboolean
+get_device_info (DeviceIndex *index,
+                 dev_t        dev,
+                 DeviceInfo  *df,
+                 gboolean    *out_cached)
+{
+    DeviceIdentity *identity;
+
+    *out_cached = FALSE;
+    if (index == NULL)
+        return FALSE;
+
+    identity = device_index_resolve (index, dev, out_cached);
+    if (identity == NULL)
+        return FALSE;
+
+    df->identity = identity;
+    df->uuid = identity->uuid;
+    df->drive_path = identity->drive_path;
+    df->serial = identity->serial;
+    df->vendor = identity->vendor;
+    df->model = identity->model;
+
+    return identity->complete;
+}
+
+static void
+device_info_free (DeviceInfo *df)
+{
+    g_free (df->mount_path);
+    device_identity_unref (df->identity);
+    g_free (df);
+}
+
+static void
+batch_device_info (GPtrArray  *batch,
+                   DeviceInfo *df)
+{
+    GValueArray *item;
+
+    item = g_value_array_new (4);
+    value_array_append_string (item, df->serial);
+    value_array_append_string (item, df->vendor);
+    value_array_append_string (item, df->model);
+    value_array_append_string (item, df->uuid);
+    g_ptr_array_add (batch, item);
+}
+
+static void
+mount_batch_free (MountBatch *batch)
+{
+    g_ptr_array_unref (batch->added);
+    g_ptr_array_unref (batch->removed);
+    g_slice_free (MountBatch, batch);
+}
+
+/* Returns the batch of ns_id, which then ends at generation */
+static MountBatch *
+get_batch (MountMonitor *monitor,
+           guint64       ns_id,
+           guint64       generation)
 {
-    return MOUNT_MONITOR (g_object_new (MOUNT_MONITOR_TYPE, NULL));
+    MountBatch *batch;
+
+    batch = g_hash_table_lookup (monitor->batches, &ns_id);
+    if (batch == NULL)
+    {
+        batch = g_slice_new0 (MountBatch);
+        batch->ns_id = ns_id;
+        batch->added = g_ptr_array_new_with_free_func ((GDestroyNotify) g_value_array_free);
+        batch->removed = g_ptr_array_new_with_free_func ((GDestroyNotify) g_value_array_free);
+        g_hash_table_insert (monitor->batches, &batch->ns_id, batch);
+    }
+    batch->generation = generation;
+
+    return batch;
 }
 
+/* Sends everything collected since the last flush, one MountsChanged per
+ * namespace
+ */
 static void
-mount_monitor_finalize (GObject *object)
+flush_mounts_changed (MountMonitor *monitor)
 {
-    MountMonitor *monitor = MOUNT_MONITOR (object);
+    GHashTableIter iter;
+    MountBatch *batch;
+
+    g_hash_table_iter_init (&iter, monitor->batches);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &batch))
+    {
+        if (batch->added->len != 0 || batch->removed->len != 0)
+        {
+            g_signal_emit (monitor, signals[MOUNTS_CHANGED_SIGNAL], 0,
+                           batch->ns_id, batch->generation, batch->added, batch->removed);
+            monitor->metrics->mounts_changed_signals++;
+        }
+        g_hash_table_iter_remove (&iter);
+    }
+}
+
+/* Looks up the device info of mount and keeps it until the mount goes */
+static DeviceInfo *
+resolve_device_info (MountMonitor *monitor,
+                     MountInfo    *mount)
+{
+    gint64 start;
+    gboolean cached;
+    DeviceInfo *df = g_new0(DeviceInfo, 1);
+    df->ns_id = mount->ns_id;
+    df->mount_path = g_strdup(mount->mount_path);
+    df->dev = mount->dev;
+    start = mount_metrics_now_ns ();
+    if (!get_device_info(monitor->devices, mount->dev, df, &cached))
+        monitor->metrics->udisks_misses++;
+    mount_histogram_add (&monitor->metrics->udisks_lookup_time, mount_metrics_now_ns () - start);
+    monitor->metrics->udisks_lookups++;
+    if (cached)
+        monitor->metrics->udisks_cache_hits++;
+    g_hash_table_insert (monitor->device_infos, mount_info_ref (mount), df);
+    schedule_publish (monitor);
+
+    return df;
+}
 
-    if (monitor->mounts_channel != NULL)
-    g_io_channel_unref (monitor->mounts_channel);
-    if (monitor->mounts_watch_source != NULL)
-    g_source_destroy (monitor->mounts_watch_source);
+/* Adds a change to the journal's current batch, if there is a journal */
+static void
+journal_mount (MountMonitor           *monitor,
+               MountJournalRecordType  type,
+               guint64                 generation,
+               MountInfo              *mount,
+               MountInfo              *old_mount,
+               MountChangedFields      fields,
+               DeviceInfo             *df)
+{
+    if (monitor->journal == NULL)
+        return;
 
+    mount_journal_append (monitor->journal, type, generation, mount, old_mount, fields,
+                          df != NULL ? df->uuid : NULL, df != NULL ? df->serial : NULL);
+    monitor->journal_batch_open = TRUE;
+}
 
-    g_list_foreach (monitor->mounts, (GFunc) g_object_unref, NULL);
-    g_list_free (monitor->mounts);
+/* Writes out what was announced since the last call */
+static void
+journal_end_batch (MountMonitor *monitor)
+{
+    if (monitor->journal == NULL || !monitor->journal_batch_open)
+        return;
 
-    if (G_OBJECT_CLASS (mount_monitor_parent_class)->finalize != NULL)
-    G_OBJECT_CLASS (mount_monitor_parent_class)->finalize (object);
+    mount_journal_end_batch (monitor->journal, event_ring_get_generation (monitor->history));
+    monitor->journal_batch_open = FALSE;
 }
 
-static gboolean
-have_mount (MountMonitor *monitor,
-            dev_t               dev,
-            const gchar        *mount_point)
+static void
+emit_mount_added (MountMonitor *monitor,
+                  MountInfo    *mount)
 {
-    GList *l;
-    gboolean ret;
+    guint64 generation;
+    DeviceInfo *df;
+
+    df = resolve_device_info (monitor, mount);
+    /* swaps come one at a time and always get their own signal */
+    generation = event_ring_append (monitor->history, TRUE, mount_to_value_array (monitor, mount));
+    journal_mount (monitor, MOUNT_JOURNAL_ADDED, generation, mount, NULL, 0, df);
+    notify_subscribers (monitor, mount, df, TRUE, generation);
+    if (mount->type == MOUNT_TYPE_SWAP) {
+        g_signal_emit (monitor, signals[SWAP_ADDED_SIGNAL], 0, df->serial, df->vendor, df->model, df->uuid, df->mount_path, generation);
+        monitor->metrics->swap_added_signals++;
+    } else if (monitor->signal_mode & MOUNT_SIGNALS_PER_MOUNT) {
+        g_signal_emit (monitor, signals[MOUNT_ADDED_SIGNAL], 0, df->serial, df->vendor, df->model, df->uuid, df->ns_id, generation);
+        monitor->metrics->mount_added_signals++;
+    }
+    if (mount->type != MOUNT_TYPE_SWAP && (monitor->signal_mode & MOUNT_SIGNALS_BATCHED))
+        batch_device_info (get_batch (monitor, df->ns_id, generation)->added, df);
+}
+
+static void
+pending_mount_free (PendingMount *pending)
+{
+    mount_info_unref (pending->mount);
+    g_slice_free (PendingMount, pending);
+}
 
-    ret = FALSE;
+static gboolean resolve_pending_mounts (gpointer user_data);
 
-    for (l = monitor->mounts; l != NULL; l = l->next)
+static void
+schedule_resolve (MountMonitor *monitor,
+                  guint         delay_ms)
+{
+    if (monitor->resolve_source_id != 0)
     {
-        MountInfo *mount = MOUNT_INFO (l->data);
-        if (mount_info_get_dev (mount) == dev &&
-            g_strcmp0 (mount_info_get_mount_path (mount), mount_point) == 0)
-        {
-            ret = TRUE;
-            break;
-        }
+        /* an armed retry timer is superseded by an immediate run */
+        if (delay_ms != 0 || monitor->resolve_source_is_idle)
+            return;
+        g_source_remove (monitor->resolve_source_id);
     }
 
-    return ret;
+    monitor->resolve_source_is_idle = (delay_ms == 0);
+    if (delay_ms == 0)
+        monitor->resolve_source_id = g_idle_add (resolve_pending_mounts, monitor);
+    else
+        monitor->resolve_source_id = g_timeout_add (delay_ms, resolve_pending_mounts, monitor);
 }
 
+/* Works through the queue of added mounts.  MountAdded is emitted once the
+ * block object of a mount is known to the device index, or once the mount
+ * has waited RESOLVE_TIMEOUT_USEC for it.  At most RESOLVE_BATCH_SIZE mounts
+ * are handled per main loop iteration so that large batches don't hold up
+ * mountinfo events and D-Bus traffic.
+ */
 static gboolean
-mount_monitor_get_mountinfo (MountMonitor  *monitor,
-                                    GError             **error)
+resolve_pending_mounts (gpointer user_data)
 {
-    gboolean ret;
-    gchar *contents;
-    gchar **lines;
+    MountMonitor *monitor = MOUNT_MONITOR (user_data);
+    GList *link;
+    GList *next;
+    gint64 now;
     guint n;
+    gboolean waiting;
 
-    ret = FALSE;
-    contents = NULL;
-    lines = NULL;
+    monitor->resolve_source_id = 0;
 
-    if (!g_file_get_contents ("/proc/self/mountinfo", &contents, NULL, error))
-    {
-        g_prefix_error (error, "Error reading /proc/self/mountinfo: ");
-        goto out;
-    }
+    /* the device index reports back once the udisks client is up */
+    if (!device_index_is_ready (monitor->devices))
+        return FALSE;
 
-    /* See Documentation/filesystems/proc.txt for the format of /proc/self/mountinfo
-    *
-    * Note that things like space are encoded as \020.
-    */
-    lines = g_strsplit (contents, "\n", 0);
-    for (n = 0; lines[n] != NULL; n++)
+    now = g_get_monotonic_time ();
+    n = 0;
+    waiting = FALSE;
+
+    for (link = monitor->pending_mounts->head; link != NULL && n < RESOLVE_BATCH_SIZE; link = next)
     {
-        guint mount_id;
-        guint parent_id;
-        guint major, minor;
-        gchar encoded_root[4096];
-        gchar encoded_mount_point[4096];
-        gchar *mount_point;
-        dev_t dev;
+        PendingMount *pending = link->data;
 
-        if (strlen (lines[n]) == 0)
-            continue;
+        next = link->next;
 
-        if (sscanf (lines[n],
-                    "%d %d %d:%d %4095s %4095s",
-                    &mount_id,
-                    &parent_id,
-                    &major,
-                    &minor,
-                    encoded_root,
-                    encoded_mount_point) != 6)
+        /* anonymous devices (overlay, nfs, ...) never get a block object */
+        if (device_index_is_connected (monitor->devices) &&
+            major (pending->mount->dev) != 0 &&
+            device_index_lookup_block (monitor->devices, pending->mount->dev) == NULL &&
+            now < pending->deadline)
         {
-            printf ("Error parsing line '%s'", lines[n]);
+            waiting = TRUE;
             continue;
         }
-        encoded_root[sizeof encoded_root - 1] = '\0';
-        encoded_mount_point[sizeof encoded_mount_point - 1] = '\0';
-
-        /* Temporary work-around for btrfs, see
-        *
-        *  https://bugzilla.redhat.com/show_bug.cgi?id=495152#c31
-        *  http://article.gmane.org/gmane.comp.file-systems.btrfs/2851
-        *
-        * for details.
-        */
-        if (major == 0)
-        {
-            const gchar *sep;
-            sep = strstr (lines[n], " - ");
-            if (sep != NULL)
-            {
-                gchar fstype[4096];
-                gchar mount_source[4096];
-                struct stat statbuf;
-
-                if (sscanf (sep + 3, "%4095s %4095s", fstype, mount_source) != 2)
-                {
-                    printf ("Error parsing things past - for '%s'", lines[n]);
-                    continue;
-                }
-                fstype[sizeof fstype - 1] = '\0';
-                mount_source[sizeof mount_source - 1] = '\0';
-
-                if (g_strcmp0 (fstype, "btrfs") != 0)
-                continue;
-
-                if (!g_str_has_prefix (mount_source, "/dev/"))
-                continue;
-
-                if (stat (mount_source, &statbuf) != 0)
-                {
-                    printf ("Error statting %s: %m", mount_source);
-                    continue;
-                }
-
-                if (!S_ISBLK (statbuf.st_mode))
-                {
-                    printf ("%s is not a block device", mount_source);
-                    continue;
-                }
-
-                dev = statbuf.st_rdev;
-            }
-            else
-            {
-                continue;
-            }
-        }
-        else
-        {
-            dev = makedev (major, minor);
-        }
-
-        mount_point = g_strcompress (encoded_mount_point);
-
-        /* TODO: we can probably use a hash table or something if this turns out to be slow */
-        if (!have_mount (monitor, dev, mount_point))
-        {
-            MountInfo *mount;
-            mount = _mount_info_new (dev, mount_point, MOUNT_TYPE_FILESYSTEM);
-            monitor->mounts = g_list_prepend (monitor->mounts, mount);
-        }
 
-        g_free (mount_point);
+        g_hash_table_remove (monitor->pending_by_mount, pending->mount);
+        g_queue_delete_link (monitor->pending_mounts, link);
+        if (pending->quiet)
+            resolve_device_info (monitor, pending->mount);
+        else
+            emit_mount_added (monitor, pending->mount);
+        pending_mount_free (pending);
+        n++;
     }
 
-    ret = TRUE;
+    journal_end_batch (monitor);
+    if (link != NULL)
+    {
+        schedule_resolve (monitor, 0);
+        return FALSE;
+    }
 
-    out:
-    g_free (contents);
-    g_strfreev (lines);
+    /* the reload's batch is done as far as it can be for now */
+    flush_mounts_changed (monitor);
+    if (waiting)
+        schedule_resolve (monitor, RESOLVE_RETRY_MS);
 
-    return ret;
+    return FALSE;
 }
 
 static void
-mount_monitor_ensure (MountMonitor *monitor)
+on_devices_changed (DeviceIndex *index,
+                    gpointer     user_data)
 {
-    GError *error;
+    MountMonitor *monitor = MOUNT_MONITOR (user_data);
 
-    if (monitor->have_data)
-        goto out;
+    /* a btrfs source may now be a different device */
+    mount_namespace_invalidate_sources ();
+    if (!g_queue_is_empty (monitor->pending_mounts))
+        schedule_resolve (monitor, 0);
+}
 
-    error = NULL;
-    if (!mount_monitor_get_mountinfo (monitor, &error))
-    {
-        printf ("Error getting mounts: %s (%s, %d)",
-                        error->message, g_quark_to_string (error->domain), error->code);
-        g_error_free (error);
-    }
+static void
+queue_mount (MountMonitor *monitor,
+             MountInfo    *mount,
+             gboolean      quiet)
+{
+    PendingMount *pending;
+
+    pending = g_slice_new0 (PendingMount);
+    pending->mount = mount_info_ref (mount);
+    pending->deadline = g_get_monotonic_time () + RESOLVE_TIMEOUT_USEC;
+    pending->quiet = quiet;
 
-    monitor->have_data = TRUE;
+    g_queue_push_tail (monitor->pending_mounts, pending);
+    g_hash_table_insert (monitor->pending_by_mount, mount, monitor->pending_mounts->tail);
 
-out:
-    ;
+    schedule_resolve (monitor, 0);
 }
 
 static void
-mount_monitor_invalidate (MountMonitor *monitor)
+queue_mount_added (MountMonitor *monitor,
+                   MountInfo    *mount)
 {
-  monitor->have_data = FALSE;
-
-  g_list_foreach (monitor->mounts, (GFunc) g_object_unref, NULL);
-  g_list_free (monitor->mounts);
-  monitor->mounts = NULL;
+    queue_mount (monitor, mount, FALSE);
 }
 
-static void
-diff_sorted_lists (GList *list1,
-                   GList *list2,
-                   GCompareFunc compare,
-                   GList **added,
-                   GList **removed)
+/* Takes the device info of the mounts of our own namespace that were
+ * there at startup from the snapshot at path, written by an earlier run
+ * of the daemon.  A mount is taken if the snapshot has it under the same
+ * device, path and mount ID (it can't have been remounted elsewhere in
+ * between without getting a new ID); the others are looked up in UDisks
+ * in the background, without being announced.  The identities taken also
+ * go into the device cache, so their devices need no lookup when mounted
+ * again.  With no usable snapshot everything is looked up.
+ */
+void
+mount_monitor_load_snapshot (MountMonitor *monitor,
+                             const gchar  *path)
 {
-    int order;
+    MountSnapshot *snapshot;
+    MountMirror *mirror;
+    MountInfo *mount;
+    MountKey *keys;
+    GHashTable *stored;
+    DeviceIdentity **identities;
+    GHashTableIter iter;
+    GError *error;
+    guint n_taken;
+    guint n_queued;
+    guint n;
 
-    *added = *removed = NULL;
+    g_return_if_fail (IS_MOUNT_MONITOR (monitor));
 
-    while (list1 != NULL && list2 != NULL)
+    mirror = g_hash_table_lookup (monitor->namespaces, &monitor->self_ns_id);
+    if (mirror == NULL)
+        return;
+
+    error = NULL;
+    snapshot = mount_snapshot_load (path, &error);
+    if (snapshot == NULL)
+    {
+        if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+            printf ("Not using the snapshot: %s\n", error->message);
+        g_error_free (error);
+    }
+    else if (snapshot->header->ns_id != monitor->self_ns_id)
+    {
+        printf ("Not using the snapshot: it is of another mount namespace\n");
+        mount_snapshot_free (snapshot);
+        snapshot = NULL;
+    }
+
+    /* (dev, path) -> MountSnapshotMount; the keys point into the mapping */
+    stored = g_hash_table_new (mount_key_hash, mount_key_equal);
+    keys = NULL;
+    identities = NULL;
+    if (snapshot != NULL)
     {
-        order = (*compare) (list1->data, list2->data);
-        if (order < 0)
+        keys = g_new0 (MountKey, snapshot->header->n_mounts);
+        identities = g_new0 (DeviceIdentity *, snapshot->header->n_identities);
+        for (n = 0; n < snapshot->header->n_mounts; n++)
         {
-            *removed = g_list_prepend (*removed, list1->data);
-            list1 = list1->next;
+            keys[n].dev = snapshot->mounts[n].dev;
+            keys[n].mount_path = mount_snapshot_get_string (snapshot, snapshot->mounts[n].path);
+            g_hash_table_replace (stored, &keys[n], (gpointer) &snapshot->mounts[n]);
         }
-        else if (order > 0)
+    }
+
+    n_taken = n_queued = 0;
+    g_hash_table_iter_init (&iter, mirror->mounts);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &mount))
+    {
+        const MountSnapshotMount *match;
+        DeviceInfo *df;
+
+        if (g_hash_table_contains (monitor->device_infos, mount) ||
+            g_hash_table_contains (monitor->pending_by_mount, mount))
+            continue;
+
+        match = g_hash_table_lookup (stored, MOUNT_INFO_KEY (mount));
+        if (match == NULL || match->type != mount->type || match->mount_id != mount->mount_id)
         {
-            *added = g_list_prepend (*added, list2->data);
-            list2 = list2->next;
+            /* anonymous devices (overlay, nfs, ...) have nothing to look up */
+            if (major (mount->dev) != 0)
+            {
+                queue_mount (monitor, mount, TRUE);
+                n_queued++;
+            }
+            continue;
         }
-        else
-        { /* same item */
-            list1 = list1->next;
-            list2 = list2->next;
+
+        if (identities[match->identity] == NULL)
+        {
+            identities[match->identity] = mount_snapshot_get_identity (snapshot, match->identity);
+            device_index_seed (monitor->devices, identities[match->identity]);
         }
+        df = g_new0 (DeviceInfo, 1);
+        df->ns_id = mount->ns_id;
+        df->mount_path = g_strdup (mount->mount_path);
+        df->dev = mount->dev;
+        df->identity = device_identity_ref (identities[match->identity]);
+        df->uuid = df->identity->uuid;
+        df->drive_path = df->identity->drive_path;
+        df->serial = df->identity->serial;
+        df->vendor = df->identity->vendor;
+        df->model = df->identity->model;
+        g_hash_table_insert (monitor->device_infos, mount_info_ref (mount), df);
+        n_taken++;
     }
 
-    while (list1 != NULL)
-    {
-        *removed = g_list_prepend (*removed, list1->data);
-        list1 = list1->next;
-    }
-    while (list2 != NULL)
+    printf ("Warm start: %u mounts from the snapshot, %u to look up\n", n_taken, n_queued);
+    schedule_publish (monitor);
+
+    if (snapshot != NULL)
     {
-        *added = g_list_prepend (*added, list2->data);
-        list2 = list2->next;
+        for (n = 0; n < snapshot->header->n_identities; n++)
+            device_identity_unref (identities[n]);
+        g_free (identities);
+        g_free (keys);
+        mount_snapshot_free (snapshot);
     }
+    g_hash_table_unref (stored);
 }
 
-static UDisksObject *
-lookup_object_for_block (UDisksClient  *client,
-                         dev_t          block_device)
+/* Writes the device info of the mounts and swaps of our own namespace to
+ * path, see mount_monitor_load_snapshot().  Mounts whose device wasn't
+ * found are left out, so they are looked up again next time.
+ */
+gboolean
+mount_monitor_save_snapshot (MountMonitor  *monitor,
+                             const gchar   *path,
+                             GError       **error)
 {
-  UDisksObject *ret;
-  GList *objects;
-  GList *l;
+    MountSnapshotEntry *entries;
+    GHashTableIter iter;
+    MountInfo *mount;
+    DeviceInfo *df;
+    GList *list;
+    gboolean ret;
+    guint n;
 
-  ret = NULL;
+    g_return_val_if_fail (IS_MOUNT_MONITOR (monitor), FALSE);
 
-  objects = g_dbus_object_manager_get_objects (udisks_client_get_object_manager (client));
-  for (l = objects; l != NULL; l = l->next)
+    entries = g_new0 (MountSnapshotEntry, g_hash_table_size (monitor->device_infos));
+    list = NULL;
+    n = 0;
+    g_hash_table_iter_init (&iter, monitor->device_infos);
+    while (g_hash_table_iter_next (&iter, (gpointer *) &mount, (gpointer *) &df))
     {
-      UDisksObject *object = UDISKS_OBJECT (l->data);
-      UDisksBlock *block;
-
-      block = udisks_object_peek_block (object);
-      if (block != NULL)
-        {
-          if (block_device == udisks_block_get_device_number (block))
-            {
-              ret = g_object_ref (object);
-              goto out;
-            }
-        }
+        if (mount->ns_id != monitor->self_ns_id || df->identity == NULL)
+            continue;
+        entries[n].type = mount->type;
+        entries[n].dev = mount->dev;
+        entries[n].mount_id = mount->mount_id;
+        entries[n].path = mount->mount_path;
+        entries[n].identity = df->identity;
+        list = g_list_prepend (list, &entries[n]);
+        n++;
     }
 
- out:
-  g_list_foreach (objects, (GFunc) g_object_unref, NULL);
-  g_list_free (objects);
+    ret = mount_snapshot_save (path, monitor->self_ns_id, list, error);
+
+    g_list_free (list);
+    g_free (entries);
 
-  return ret;
+    return ret;
 }
 
-static UDisksObject *lookup_object_by_path(UDisksClient  *client, const gchar *path)
+/* Appends every mount being watched to a fresh journal file, with the
+ * device info of those announced already
+ */
+static guint64
+journal_present_mounts (MountJournal *journal,
+                        gpointer      user_data)
 {
-    UDisksObject *ret;
-    GList *objects;
-    GList *l;
-
-    ret = NULL;
-
-    objects = g_dbus_object_manager_get_objects (udisks_client_get_object_manager (client));
-    for (l = objects; l != NULL; l = l->next)
+    MountMonitor *monitor = MOUNT_MONITOR (user_data);
+    GHashTableIter ns_iter;
+    GHashTableIter iter;
+    MountMirror *mirror;
+    MountInfo *mount;
+    DeviceInfo *df;
+    guint64 generation;
+
+    generation = event_ring_get_generation (monitor->history);
+    g_hash_table_iter_init (&ns_iter, monitor->namespaces);
+    while (g_hash_table_iter_next (&ns_iter, NULL, (gpointer *) &mirror))
     {
-        UDisksObject *object = UDISKS_OBJECT (l->data);
-        if (g_strcmp0(g_dbus_object_get_object_path(G_DBUS_OBJECT(object)), path) == 0) {
-            ret = g_object_ref (object);
-            goto out;
+        g_hash_table_iter_init (&iter, mirror->mounts);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &mount))
+        {
+            df = g_hash_table_lookup (monitor->device_infos, mount);
+            mount_journal_append (journal, MOUNT_JOURNAL_PRESENT, generation, mount, NULL, 0,
+                                  df != NULL ? df->uuid : NULL, df != NULL ? df->serial : NULL);
         }
     }
 
-out:
-    g_list_foreach (objects, (GFunc) g_object_unref, NULL);
-    g_list_free (objects);
-    return ret;
+    return generation;
 }
 
-static void get_device_info(dev_t dev, DeviceInfo *df)
+/* Records every change announced from now on in the journal at path, see
+ * journal.h.  The file is rotated to path.1 ... path.max_files once it
+ * is bigger than max_size bytes.
+ */
+gboolean
+mount_monitor_set_journal (MountMonitor  *monitor,
+                           const gchar   *path,
+                           guint64        max_size,
+                           guint          max_files,
+                           GError       **error)
 {
-    UDisksClient *client = NULL;
-    GError *error = NULL;
-    UDisksObject *object_block, *object_drive;
-    UDisksBlock *block;
-    UDisksDrive *drive;
+    MountJournal *journal;
 
-    client = udisks_client_new_sync (NULL, /* GCancellable */ &error);
-    if (client == NULL) {
-        printf("Error connecting to the udisks daemon: %s\n", error->message);
-        g_error_free (error);
-        goto out;
-    }
-    object_block = lookup_object_for_block (client, dev);
-    if (object_block == NULL) {
-        printf("Error finding object for block device %d:%d\n", major (dev), minor (dev));
-        goto out;
-    }
+    g_return_val_if_fail (IS_MOUNT_MONITOR (monitor), FALSE);
+    g_return_val_if_fail (monitor->journal == NULL, FALSE);
 
-    block = udisks_object_peek_block (object_block);
-    df->uuid = g_strdup(udisks_block_get_id_uuid(block));
-    df->drive_path = g_strdup(udisks_block_get_drive(block));
+    journal = mount_journal_open (path, max_size, max_files, journal_present_mounts, monitor, error);
+    if (journal == NULL)
+        return FALSE;
 
-    object_drive = lookup_object_by_path(client, df->drive_path);
-    if (object_drive == NULL) {
-        printf("Error finding object for drive %s\n", df->drive_path);
-        goto out;
-    }
-    drive = udisks_object_peek_drive(object_drive);
-    df->serial = g_strdup(udisks_drive_get_serial(drive));
-    df->vendor = g_strdup(udisks_drive_get_vendor(drive));
-    df->model = g_strdup(udisks_drive_get_model(drive));
+    monitor->journal = journal;
+    monitor->journal_batch_open = FALSE;
+
+    return TRUE;
+}
 
-out:
-    if (object_block != NULL)
-        g_object_unref (object_block);
-    if (object_drive != NULL)
-        g_object_unref (object_drive);
-    if (client != NULL)
-        g_object_unref (client);
+static void
+field_value_free (GValue *value)
+{
+    g_value_unset (value);
+    g_free (value);
 }
 
-static DeviceInfo *get_devinfo_by_mount_path(GList *list, const gchar *path)
+static void
+field_map_insert_string (GHashTable  *map,
+                         const gchar *key,
+                         const gchar *str)
 {
-    gchar *p;
-    DeviceInfo *tmp;
-    while (list) {
-        GList *next = list->next;
+    GValue *value;
 
-        tmp = (DeviceInfo *)list->data;
-        p = tmp->mount_path;
-        if (g_strcmp0(p, path) == 0) {
-            return list->data;
-        }
-        list = next;
+    value = g_new0 (GValue, 1);
+    g_value_init (value, G_TYPE_STRING);
+    g_value_set_string (value, str != NULL ? str : "");
+    g_hash_table_insert (map, (gpointer) key, value);
+}
+
+/* The a{sv} of MountChanged: the new value of each field that changed */
+static GHashTable *
+mount_change_to_field_map (MountChange *change)
+{
+    MountInfo *mount = change->new_mount;
+    GHashTable *map;
+    GValue *value;
+
+    map = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                 NULL, (GDestroyNotify) field_value_free);
+    if (change->fields & MOUNT_CHANGED_PATH)
+        field_map_insert_string (map, "path", mount->mount_path);
+    if (change->fields & MOUNT_CHANGED_PARENT)
+    {
+        value = g_new0 (GValue, 1);
+        g_value_init (value, G_TYPE_UINT64);
+        g_value_set_uint64 (value, mount->parent_id);
+        g_hash_table_insert (map, "parent-id", value);
     }
-    return NULL;
+    if (change->fields & MOUNT_CHANGED_ROOT)
+        field_map_insert_string (map, "root", mount->root);
+    if (change->fields & MOUNT_CHANGED_OPTIONS)
+        field_map_insert_string (map, "options", mount->options);
+    if (change->fields & MOUNT_CHANGED_SUPER_OPTIONS)
+        field_map_insert_string (map, "super-options", mount->super_options);
+    if (change->fields & MOUNT_CHANGED_PROPAGATION)
+        field_map_insert_string (map, "propagation", mount->propagation);
+
+    return map;
 }
 
+/* A mount was moved or changed in place.  The device is the same, so
+ * whatever is known about the old version carries over to the new one
+ * without asking UDisks again.
+ */
 static void
-reload_mounts (MountMonitor *monitor)
+announce_mount_change (MountMonitor *monitor,
+                       MountChange  *change)
 {
-    GList *old_mounts;
-    GList *cur_mounts;
-    GList *added;
-    GList *removed;
-    GList *l;
+    MountInfo *old_mount = change->old_mount;
+    MountInfo *new_mount = change->new_mount;
+    PendingMount *pending;
+    DeviceInfo *df;
+    GHashTable *map;
+    GList *link;
+    guint64 generation;
+
+    /* not announced yet: it will be, as it is now */
+    link = g_hash_table_lookup (monitor->pending_by_mount, old_mount);
+    if (link != NULL)
+    {
+        pending = link->data;
+        g_hash_table_remove (monitor->pending_by_mount, old_mount);
+        pending->mount = mount_info_ref (new_mount);
+        mount_info_unref (old_mount);
+        g_hash_table_insert (monitor->pending_by_mount, new_mount, link);
+        return;
+    }
 
-    mount_monitor_ensure (monitor);
+    /* NULL for mounts that were there before their namespace was watched;
+     * they change all the same, as the mirror already shows */
+    df = g_hash_table_lookup (monitor->device_infos, old_mount);
 
-    old_mounts = g_list_copy (monitor->mounts);
-    g_list_foreach (old_mounts, (GFunc) g_object_ref, NULL);
+    /* clients that only know paths see a move as an unmount and a mount */
+    if (change->fields & MOUNT_CHANGED_PATH)
+    {
+        generation = event_ring_append (monitor->history, FALSE, mount_to_value_array (monitor, old_mount));
+        notify_subscribers (monitor, old_mount, df, FALSE, generation);
+    }
+    if (df != NULL)
+    {
+        g_hash_table_steal (monitor->device_infos, old_mount);
+        g_hash_table_insert (monitor->device_infos, mount_info_ref (new_mount), df);
+        mount_info_unref (old_mount);
+        if (change->fields & MOUNT_CHANGED_PATH)
+        {
+            g_free (df->mount_path);
+            df->mount_path = g_strdup (new_mount->mount_path);
+        }
+    }
 
-    mount_monitor_invalidate (monitor);
-    mount_monitor_ensure (monitor);
+    if (change->fields == 0)
+        return;
+
+    /* the other half of a move; any other change lists the mount again as
+     * added, with its new values, so it has a generation of its own */
+    generation = event_ring_append (monitor->history, TRUE, mount_to_value_array (monitor, new_mount));
+    if (change->fields & MOUNT_CHANGED_PATH)
+        notify_subscribers (monitor, new_mount, df, TRUE, generation);
+
+    journal_mount (monitor, MOUNT_JOURNAL_CHANGED, generation, new_mount, old_mount, change->fields, df);
+    map = mount_change_to_field_map (change);
+    g_signal_emit (monitor, signals[MOUNT_CHANGED_SIGNAL], 0,
+                   new_mount->ns_id, new_mount->mount_id, generation, map);
+    monitor->metrics->mount_changed_signals++;
+    g_hash_table_unref (map);
+}
 
-    cur_mounts = g_list_copy (monitor->mounts);
+/* Announces the result of a scan of one namespace; consumes the lists,
+ * added and removed hold a reference to each mount, changed is a list of
+ * MountChange
+ */
+static void
+announce_changes (MountMonitor *monitor,
+                  GList        *added,
+                  GList        *removed,
+                  GList        *changed)
+{
+    GList *l;
 
-    old_mounts = g_list_sort (old_mounts, (GCompareFunc) mount_info_compare);
-    cur_mounts = g_list_sort (cur_mounts, (GCompareFunc) mount_info_compare);
-    diff_sorted_lists (old_mounts, cur_mounts, (GCompareFunc) mount_info_compare, &added, &removed);
+    for (l = changed; l != NULL; l = l->next)
+        announce_mount_change (monitor, l->data);
 
     for (l = removed; l != NULL; l = l->next)
     {
         DeviceInfo *df;
+        GList *link;
+        guint64 generation;
         MountInfo *mount = MOUNT_INFO (l->data);
-        df = get_devinfo_by_mount_path(device_info_list, mount->mount_path);
+
+        /* gone before it was ever announced: drop it, so MountRemoved can't
+         * overtake its MountAdded */
+        link = g_hash_table_lookup (monitor->pending_by_mount, mount);
+        if (link != NULL)
+        {
+            g_hash_table_remove (monitor->pending_by_mount, mount);
+            pending_mount_free (link->data);
+            g_queue_delete_link (monitor->pending_mounts, link);
+            continue;
+        }
+
+        /* the mirror listed it either way, so it is in the history and the
+         * journal even without device info */
+        df = g_hash_table_lookup (monitor->device_infos, mount);
+        generation = event_ring_append (monitor->history, FALSE, mount_to_value_array (monitor, mount));
+        journal_mount (monitor, MOUNT_JOURNAL_REMOVED, generation, mount, NULL, 0, df);
         if (df) {
-            g_signal_emit (monitor, signals[MOUNT_REMOVED_SIGNAL], 0, df->serial, df->vendor, df->model, df->uuid);
-            // delete df from list
-            device_info_list = g_list_remove(device_info_list, df);
-            g_free(df);
+            notify_subscribers (monitor, mount, df, FALSE, generation);
+            if (mount->type == MOUNT_TYPE_SWAP) {
+                g_signal_emit (monitor, signals[SWAP_REMOVED_SIGNAL], 0, df->serial, df->vendor, df->model, df->uuid, df->mount_path, generation);
+                monitor->metrics->swap_removed_signals++;
+            } else if (monitor->signal_mode & MOUNT_SIGNALS_PER_MOUNT) {
+                g_signal_emit (monitor, signals[MOUNT_REMOVED_SIGNAL], 0, df->serial, df->vendor, df->model, df->uuid, df->ns_id, generation);
+                monitor->metrics->mount_removed_signals++;
+            }
+            if (mount->type != MOUNT_TYPE_SWAP && (monitor->signal_mode & MOUNT_SIGNALS_BATCHED))
+                batch_device_info (get_batch (monitor, df->ns_id, generation)->removed, df);
+            g_hash_table_remove (monitor->device_infos, mount);
         } else {
-            printf("cant find device info.\n");
+            /* there before it was watched and never looked up */
+            monitor->metrics->unresolved_removals++;
         }
     }
 
+    /* the scan collects them last line first */
+    added = g_list_reverse (added);
     for (l = added; l != NULL; l = l->next)
-    {
-        MountInfo *mount = MOUNT_INFO (l->data);
-        DeviceInfo *df = g_malloc(sizeof(DeviceInfo));
-        df->mount_path = g_strdup(mount->mount_path);
-        df->dev = mount->dev;
-        get_device_info(mount->dev, df);
-        device_info_list = g_list_append(device_info_list, df);
-        g_signal_emit (monitor, signals[MOUNT_ADDED_SIGNAL], 0, df->serial, df->vendor, df->model, df->uuid);
-    }
+        queue_mount_added (monitor, MOUNT_INFO (l->data));
 
-    g_list_foreach (old_mounts, (GFunc) g_object_unref, NULL);
-    g_list_free (old_mounts);
-    g_list_free (cur_mounts);
-    g_list_free (removed);
-    g_list_free (added);
+    /* with additions pending, the removals go out together with them */
+    if (g_queue_is_empty (monitor->pending_mounts))
+        flush_mounts_changed (monitor);
+    journal_end_batch (monitor);
+
+    g_list_free_full (removed, (GDestroyNotify) mount_info_unref);
+    g_list_free_full (added, (GDestroyNotify) mount_info_unref);
+    g_list_free_full (changed, (GDestroyNotify) mount_change_free);
 }
 
-static gboolean
-mounts_changed_event (GIOChannel *channel,
-                      GIOCondition cond,
-                      gpointer user_data)
+static void
+on_worker_event (MountWorker      *worker,
+                 MountWorkerEvent *event,
+                 gpointer          user_data)
 {
     MountMonitor *monitor = MOUNT_MONITOR (user_data);
-    if (cond & ~G_IO_ERR)
-        goto out;
-    reload_mounts (monitor);
+    MountMirror *mirror;
+    GList *l;
 
-out:
-    return TRUE;
+    if (event->type == MOUNT_WORKER_EVENT_WATCH_FAILED)
+    {
+        GError *error;
+
+        error = g_error_new (MOUNT_MONITOR_ERROR, MOUNT_MONITOR_ERROR_FAILED,
+                             "Error watching mount namespace %" G_GUINT64_FORMAT ": %s",
+                             event->request_id, event->error->message);
+        reply_pending_watches (monitor, event->request_id, 0, error);
+        g_error_free (error);
+        mount_worker_event_free (event);
+        return;
+    }
+
+    mirror = g_hash_table_lookup (monitor->namespaces, &event->ns_id);
+
+    if (event->type == MOUNT_WORKER_EVENT_BASELINE)
+    {
+        if (mirror == NULL)
+        {
+            mirror = mount_mirror_new (event->ns_id);
+            g_hash_table_insert (monitor->namespaces, &mirror->ns_id, mirror);
+        }
+        for (l = event->added; l != NULL; l = l->next)
+        {
+            mount_mirror_add (mirror, MOUNT_INFO (l->data));
+            /* a namespace watched after the journal was started */
+            journal_mount (monitor, MOUNT_JOURNAL_PRESENT, event_ring_get_generation (monitor->history),
+                           MOUNT_INFO (l->data), NULL, 0, NULL);
+        }
+        journal_end_batch (monitor);
+        /* the pid may have moved to another namespace in the meantime,
+         * the callers get the one that was read */
+        if (event->request_id != 0)
+            reply_pending_watches (monitor, event->request_id, event->ns_id, NULL);
+        mount_worker_event_free (event);
+        schedule_publish (monitor);
+        return;
+    }
+
+    /* unwatched since, or left over from before it was watched again */
+    if (mirror == NULL)
+    {
+        mount_worker_event_free (event);
+        return;
+    }
+
+    for (l = event->removed; l != NULL; l = l->next)
+        mount_mirror_remove (mirror, MOUNT_INFO (l->data));
+    for (l = event->changed; l != NULL; l = l->next)
+        mount_mirror_remove (mirror, ((MountChange *) l->data)->old_mount);
+    for (l = event->changed; l != NULL; l = l->next)
+        mount_mirror_add (mirror, ((MountChange *) l->data)->new_mount);
+    for (l = event->added; l != NULL; l = l->next)
+        mount_mirror_add (mirror, MOUNT_INFO (l->data));
+
+    announce_changes (monitor, event->added, event->removed, event->changed);
+    event->added = NULL;
+    event->removed = NULL;
+    event->changed = NULL;
+    mount_worker_event_free (event);
+    schedule_publish (monitor);
 }
 
 static void
@@ -455,20 +1768,33 @@ mount_monitor_constructed (GObject *object)
     MountMonitor *monitor = MOUNT_MONITOR (object);
     GError *error;
 
+    /* one UDisks connection for the lifetime of the monitor and all of its
+     * namespaces, set up in the background; added mounts queue up until it
+     * is ready */
+    monitor->devices = device_index_new (on_devices_changed, monitor);
+
     error = NULL;
-    monitor->mounts_channel = g_io_channel_new_file ("/proc/self/mountinfo", "r", &error);
-    if (monitor->mounts_channel != NULL)
+    monitor->shared_table = shared_table_new (&error);
+    if (monitor->shared_table == NULL)
     {
-        monitor->mounts_watch_source = g_io_create_watch (monitor->mounts_channel, G_IO_ERR);
-        g_source_set_callback (monitor->mounts_watch_source, (GSourceFunc) mounts_changed_event, monitor, NULL);
-        g_source_attach (monitor->mounts_watch_source, g_main_context_get_thread_default ());
-        g_source_unref (monitor->mounts_watch_source);
+        printf ("No shared table: %s\n", error->message);
+        g_clear_error (&error);
     }
-    else
+
+    /* our own namespace is always watched; it decides which backend the
+     * namespaces added later try */
+    monitor->worker = mount_worker_new (on_worker_event, monitor);
+    error = NULL;
+    if (!mount_worker_watch_namespace (monitor->worker, 0, monitor->mountinfo_path, monitor->backend,
+                                       &monitor->self_ns_id, &monitor->backend, &error))
     {
-        g_error ("No /proc/self/mountinfo file: %s", error->message);
+        g_error ("No %s file: %s",
+                 monitor->mountinfo_path != NULL ? monitor->mountinfo_path : "/proc/self/mountinfo",
+                 error->message);
         g_error_free (error);
     }
+    else
+        mount_worker_dispatch (monitor->worker);
 
     if (G_OBJECT_CLASS (mount_monitor_parent_class)->constructed != NULL)
     (*G_OBJECT_CLASS (mount_monitor_parent_class)->constructed) (object);
@@ -477,7 +1803,106 @@ mount_monitor_constructed (GObject *object)
 static void
 mount_monitor_init (MountMonitor *monitor)
 {
-    monitor->mounts = NULL;
+    monitor->namespaces = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                                 NULL, (GDestroyNotify) mount_mirror_free);
+    monitor->pending_watches = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, NULL);
+    monitor->pending_mounts = g_queue_new ();
+    monitor->pending_by_mount = g_hash_table_new (g_direct_hash, g_direct_equal);
+    monitor->signal_mode = MOUNT_SIGNALS_PER_MOUNT | MOUNT_SIGNALS_BATCHED;
+    monitor->batches = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                              NULL, (GDestroyNotify) mount_batch_free);
+    /* start from the wall clock in microseconds, so generations keep
+     * growing across restarts and a client's old one is never mistaken
+     * for a recent one */
+    monitor->history = event_ring_new (MOUNT_MONITOR_DEFAULT_HISTORY_SIZE, g_get_real_time ());
+    monitor->device_infos = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                   (GDestroyNotify) mount_info_unref,
+                                                   (GDestroyNotify) device_info_free);
+    monitor->subscriptions = subscription_table_new ();
+    monitor->metrics = mount_metrics_new ();
+}
+
+static void
+mount_monitor_set_property (GObject      *object,
+                            guint         prop_id,
+                            const GValue *value,
+                            GParamSpec   *pspec)
+{
+    MountMonitor *monitor = MOUNT_MONITOR (object);
+
+    switch (prop_id)
+    {
+    case PROP_BACKEND:
+        monitor->backend = g_value_get_int (value);
+        break;
+    case PROP_MOUNTINFO_PATH:
+        monitor->mountinfo_path = g_value_dup_string (value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+mount_monitor_get_property (GObject    *object,
+                            guint       prop_id,
+                            GValue     *value,
+                            GParamSpec *pspec)
+{
+    MountMonitor *monitor = MOUNT_MONITOR (object);
+
+    switch (prop_id)
+    {
+    case PROP_BACKEND:
+        g_value_set_int (value, monitor->backend);
+        break;
+    case PROP_MOUNTINFO_PATH:
+        g_value_set_string (value, monitor->mountinfo_path);
+        break;
+    default:
+        if (prop_id >= PROP_METRIC_FIRST && prop_id < PROP_METRIC_FIRST + mount_metrics_n_info)
+        {
+            const MountMetricInfo *info = &mount_metrics_info[prop_id - PROP_METRIC_FIRST];
+            MountMetrics *metrics = mount_monitor_get_metrics (monitor);
+
+            if (info->kind == MOUNT_METRIC_HISTOGRAM)
+                g_value_take_boxed (value, mount_histogram_to_array (MOUNT_METRIC_HISTOGRAM_VALUE (metrics, info)));
+            else
+                g_value_set_uint64 (value, MOUNT_METRIC_COUNTER_VALUE (metrics, info));
+            break;
+        }
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+/* Counters and gauges are "t" properties, histograms "at" ones, see
+ * mount_histogram_to_array()
+ */
+static void
+install_metric_properties (GObjectClass *gobject_class)
+{
+    GParamSpec *pspec;
+    gchar *name;
+    guint n;
+
+    for (n = 0; n < mount_metrics_n_info; n++)
+    {
+        const MountMetricInfo *info = &mount_metrics_info[n];
+
+        name = g_strdelimit (g_strdup (info->name), "_", '-');
+        if (info->kind == MOUNT_METRIC_HISTOGRAM)
+            pspec = g_param_spec_boxed (name, NULL, info->help,
+                                        MOUNT_MONITOR_TYPE_HISTOGRAM,
+                                        G_PARAM_READABLE | G_PARAM_STATIC_BLURB);
+        else
+            pspec = g_param_spec_uint64 (name, NULL, info->help,
+                                         0, G_MAXUINT64, 0,
+                                         G_PARAM_READABLE | G_PARAM_STATIC_BLURB);
+        g_object_class_install_property (gobject_class, PROP_METRIC_FIRST + n, pspec);
+        g_free (name);
+    }
 }
 
 static void
@@ -487,6 +1912,27 @@ mount_monitor_class_init (MountMonitorClass *klass)
 
     gobject_class->finalize    = mount_monitor_finalize;
     gobject_class->constructed = mount_monitor_constructed;
+    gobject_class->set_property = mount_monitor_set_property;
+    gobject_class->get_property = mount_monitor_get_property;
+
+    g_object_class_install_property (gobject_class, PROP_BACKEND,
+                                     g_param_spec_int ("backend",
+                                                       "Backend",
+                                                       "Where mount changes come from, a MountBackend",
+                                                       MOUNT_BACKEND_AUTO, MOUNT_BACKEND_STATMOUNT,
+                                                       MOUNT_BACKEND_AUTO,
+                                                       G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
+                                                       G_PARAM_STATIC_STRINGS));
+
+    g_object_class_install_property (gobject_class, PROP_MOUNTINFO_PATH,
+                                     g_param_spec_string ("mountinfo-path",
+                                                          "Mountinfo path",
+                                                          "File read instead of /proc/self/mountinfo",
+                                                          NULL,
+                                                          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
+                                                          G_PARAM_STATIC_STRINGS));
+
+    install_metric_properties (gobject_class);
 
     signals[MOUNT_ADDED_SIGNAL] = g_signal_new ("mount-added",
                                                 G_OBJECT_CLASS_TYPE (klass),
@@ -494,11 +1940,12 @@ mount_monitor_class_init (MountMonitorClass *klass)
                                                 0,
                                                 NULL,
                                                 NULL,
-                                                g_cclosure_marshal_VOID__STRING,
+                                                NULL,
                                                 G_TYPE_NONE,
-                                                4,
+                                                6,
+                                                G_TYPE_STRING, G_TYPE_STRING,
                                                 G_TYPE_STRING, G_TYPE_STRING,
-                                                G_TYPE_STRING, G_TYPE_STRING);
+                                                G_TYPE_UINT64, G_TYPE_UINT64);
 
     signals[MOUNT_REMOVED_SIGNAL] = g_signal_new ("mount-removed",
                                                 G_OBJECT_CLASS_TYPE (klass),
@@ -506,9 +1953,64 @@ mount_monitor_class_init (MountMonitorClass *klass)
                                                 0,
                                                 NULL,
                                                 NULL,
-                                                g_cclosure_marshal_VOID__STRING,
+                                                NULL,
+                                                G_TYPE_NONE,
+                                                6,
+                                                G_TYPE_STRING, G_TYPE_STRING,
+                                                G_TYPE_STRING, G_TYPE_STRING,
+                                                G_TYPE_UINT64, G_TYPE_UINT64);
+
+    signals[MOUNTS_CHANGED_SIGNAL] = g_signal_new ("mounts-changed",
+                                                G_OBJECT_CLASS_TYPE (klass),
+                                                G_SIGNAL_RUN_LAST,
+                                                0,
+                                                NULL,
+                                                NULL,
+                                                NULL,
                                                 G_TYPE_NONE,
                                                 4,
+                                                G_TYPE_UINT64, G_TYPE_UINT64,
+                                                MOUNT_MONITOR_TYPE_DEVICE_INFO_ARRAY,
+                                                MOUNT_MONITOR_TYPE_DEVICE_INFO_ARRAY);
+
+    signals[SWAP_ADDED_SIGNAL] = g_signal_new ("swap-added",
+                                                G_OBJECT_CLASS_TYPE (klass),
+                                                G_SIGNAL_RUN_LAST,
+                                                0,
+                                                NULL,
+                                                NULL,
+                                                NULL,
+                                                G_TYPE_NONE,
+                                                6,
+                                                G_TYPE_STRING, G_TYPE_STRING,
+                                                G_TYPE_STRING, G_TYPE_STRING,
+                                                G_TYPE_STRING, G_TYPE_UINT64);
+
+    signals[SWAP_REMOVED_SIGNAL] = g_signal_new ("swap-removed",
+                                                G_OBJECT_CLASS_TYPE (klass),
+                                                G_SIGNAL_RUN_LAST,
+                                                0,
+                                                NULL,
+                                                NULL,
+                                                NULL,
+                                                G_TYPE_NONE,
+                                                6,
                                                 G_TYPE_STRING, G_TYPE_STRING,
-                                                G_TYPE_STRING, G_TYPE_STRING);
+                                                G_TYPE_STRING, G_TYPE_STRING,
+                                                G_TYPE_STRING, G_TYPE_UINT64);
+
+    signals[MOUNT_CHANGED_SIGNAL] = g_signal_new ("mount-changed",
+                                                G_OBJECT_CLASS_TYPE (klass),
+                                                G_SIGNAL_RUN_LAST,
+                                                0,
+                                                NULL,
+                                                NULL,
+                                                NULL,
+                                                G_TYPE_NONE,
+                                                4,
+                                                G_TYPE_UINT64, G_TYPE_UINT64,
+                                                G_TYPE_UINT64, MOUNT_MONITOR_TYPE_FIELD_MAP);
+
+    dbus_g_error_domain_register (MOUNT_MONITOR_ERROR, "org.freedesktop.MountMonitor.Error",
+                                  MOUNT_MONITOR_TYPE_ERROR);
 }
\ No newline at end of file
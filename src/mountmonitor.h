@@ -1,32 +1,124 @@
 #ifndef __MOUNT_MONITOR_H__
 #define __MOUNT_MONITOR_H__
-#include "mountinfo.h"
-#include <udisks/udisks.h>
+#include "mountnamespace.h"
+#include "mountworker.h"
+#include "mountmirror.h"
+#include "deviceindex.h"
+#include "eventring.h"
+#include "subscriptions.h"
+#include "metrics.h"
+#include "sharedtable.h"
+#include "journal.h"
 
+#define MOUNT_MONITOR_OBJECT_PATH "/org/freedesktop/MountMonitor"
+#define MOUNT_MONITOR_INTERFACE "org.freedesktop.MountMonitor.Base"
+
+/* Changes kept for GetChangesSince by default */
+#define MOUNT_MONITOR_DEFAULT_HISTORY_SIZE 1024
+
+/* An announced mount with what UDisks said about its device.  The strings
+ * below mount_path belong to identity, which is shared with the device
+ * cache and the other mounts of the device; all are NULL if UDisks didn't
+ * know the device.
+ */
 typedef struct _DeviceInfo DeviceInfo;
 struct _DeviceInfo {
+    guint64 ns_id;
     dev_t dev;
     gchar *mount_path;
-    gchar *drive_path;
-    gchar *serial;
-    gchar *uuid;
-    gchar *model;
-    gchar *vendor;
+    DeviceIdentity *identity;
+    const gchar *drive_path;
+    const gchar *serial;
+    const gchar *uuid;
+    const gchar *model;
+    const gchar *vendor;
+};
+
+/* An added mount waiting for its device info before MountAdded is sent */
+typedef struct _PendingMount PendingMount;
+struct _PendingMount {
+    MountInfo *mount;
+    gint64 deadline;
+    /* a mount that was there at startup: its device info is looked up,
+     * but it isn't announced */
+    gboolean quiet;
 };
 
+/* Changes of one namespace waiting for the next MountsChanged */
+typedef struct _MountBatch MountBatch;
+struct _MountBatch {
+    guint64 ns_id;
+    /* generation of the last change in the batch */
+    guint64 generation;
+    /* (serial, vendor, model, uuid) GValueArrays */
+    GPtrArray *added;
+    GPtrArray *removed;
+};
+
+/* Which D-Bus signals are sent for mount changes */
+typedef enum
+{
+    MOUNT_SIGNALS_PER_MOUNT = 1 << 0,   /* MountAdded / MountRemoved */
+    MOUNT_SIGNALS_BATCHED   = 1 << 1    /* MountsChanged */
+} MountSignalMode;
+
 typedef struct _MountMonitor MountMonitor;
 struct _MountMonitor
 {
     GObject parent_instance;
 
-    GIOChannel *mounts_channel;
-    GSource *mounts_watch_source;
+    MountBackend backend;
+    /* read instead of /proc/self/mountinfo if set, for testing */
+    gchar *mountinfo_path;
+
+    /* reads the namespaces on a thread of its own */
+    MountWorker *worker;
+    /* namespace ID -> MountMirror, from the namespace's baseline event on */
+    GHashTable *namespaces;
+    guint64 self_ns_id;
+    /* namespace ID -> GSList of the WatchNamespace calls waiting for its
+     * baseline */
+    GHashTable *pending_watches;
+
+    DeviceIndex *devices;
+    /* PendingMount queue in the order the mounts appeared */
+    GQueue *pending_mounts;
+    /* MountInfo -> its link in pending_mounts */
+    GHashTable *pending_by_mount;
+    guint resolve_source_id;
+    gboolean resolve_source_is_idle;
+
+    /* applied to every namespace, see mount_namespace_set_coalescing() */
+    guint coalesce_min_ms;
+    guint coalesce_max_ms;
+
+    MountSignalMode signal_mode;
+    /* namespace ID -> MountBatch for the next MountsChanged */
+    GHashTable *batches;
+
+    /* MountInfo -> DeviceInfo of every announced mount and swap */
+    GHashTable *device_infos;
 
-    GIOChannel *swaps_channel;
-    GSource *swaps_watch_source;
+    /* recent changes and the generation counter */
+    EventRing *history;
 
-    gboolean have_data;
-    GList *mounts;
+    /* where MountEvent goes to the subscribers; NULL until set */
+    DBusGConnection *connection;
+    DBusGProxy *bus_proxy;
+    SubscriptionTable *subscriptions;
+
+    /* main thread only; the worker's counts are copied in when read */
+    MountMetrics *metrics;
+
+    /* the mount table as local readers map it, NULL if memfds aren't
+     * available; rewritten once per main loop iteration with changes */
+    SharedTable *shared_table;
+    guint publish_source_id;
+
+    /* every announced change goes here as well if set; journal_batch_open
+     * tells whether records were added since the last BATCH_END */
+    MountJournal *journal;
+    gboolean journal_batch_open;
 };
 
 typedef struct _MountMonitorClass MountMonitorClass;
@@ -39,26 +131,165 @@ struct _MountMonitorClass
                             MountInfo         *mount);
     void (*mount_removed) (MountMonitor  *monitor,
                             MountInfo         *mount);
+    void (*mounts_changed) (MountMonitor *monitor,
+                            guint64       ns_id,
+                            guint64       generation,
+                            GPtrArray    *added,
+                            GPtrArray    *removed);
 };
 
+typedef enum
+{
+    MOUNT_MONITOR_ERROR_FAILED,
+    MOUNT_MONITOR_ERROR_NOT_FOUND,
+    MOUNT_MONITOR_ERROR_INVALID_ARGS
+} MountMonitorError;
+
+#define MOUNT_MONITOR_ERROR mount_monitor_error_quark ()
+#define MOUNT_MONITOR_TYPE_ERROR (mount_monitor_error_get_type ())
+
 enum
 {
     MOUNT_ADDED_SIGNAL,
     MOUNT_REMOVED_SIGNAL,
+    MOUNTS_CHANGED_SIGNAL,
+    SWAP_ADDED_SIGNAL,
+    SWAP_REMOVED_SIGNAL,
+    MOUNT_CHANGED_SIGNAL,
     LAST_SIGNAL,
 };
 
 
+/* a(ssss) */
+#define MOUNT_MONITOR_TYPE_DEVICE_INFO_ARRAY \
+    (dbus_g_type_get_collection ("GPtrArray", \
+                                 dbus_g_type_get_struct ("GValueArray", \
+                                                         G_TYPE_STRING, G_TYPE_STRING, \
+                                                         G_TYPE_STRING, G_TYPE_STRING, \
+                                                         G_TYPE_INVALID)))
+
+/* a(tstsssss): namespace ID, path, dev_t, "filesystem" or "swap", serial,
+ * vendor, model, uuid */
+#define MOUNT_MONITOR_TYPE_MOUNT_ARRAY \
+    (dbus_g_type_get_collection ("GPtrArray", \
+                                 dbus_g_type_get_struct ("GValueArray", \
+                                                         G_TYPE_UINT64, G_TYPE_STRING, \
+                                                         G_TYPE_UINT64, G_TYPE_STRING, \
+                                                         G_TYPE_STRING, G_TYPE_STRING, \
+                                                         G_TYPE_STRING, G_TYPE_STRING, \
+                                                         G_TYPE_INVALID)))
+
+/* a(tbtstsssss): generation, TRUE if added, then a mount as above */
+#define MOUNT_MONITOR_TYPE_CHANGE_ARRAY \
+    (dbus_g_type_get_collection ("GPtrArray", \
+                                 dbus_g_type_get_struct ("GValueArray", \
+                                                         G_TYPE_UINT64, G_TYPE_BOOLEAN, \
+                                                         G_TYPE_UINT64, G_TYPE_STRING, \
+                                                         G_TYPE_UINT64, G_TYPE_STRING, \
+                                                         G_TYPE_STRING, G_TYPE_STRING, \
+                                                         G_TYPE_STRING, G_TYPE_STRING, \
+                                                         G_TYPE_INVALID)))
+
+/* a(tttstssssss): namespace ID, mount ID, parent ID, path, dev_t, root,
+ * fstype, source, options, superblock options, propagation */
+#define MOUNT_MONITOR_TYPE_MOUNT_RECORD_ARRAY \
+    (dbus_g_type_get_collection ("GPtrArray", \
+                                 dbus_g_type_get_struct ("GValueArray", \
+                                                         G_TYPE_UINT64, G_TYPE_UINT64, \
+                                                         G_TYPE_UINT64, G_TYPE_STRING, \
+                                                         G_TYPE_UINT64, G_TYPE_STRING, \
+                                                         G_TYPE_STRING, G_TYPE_STRING, \
+                                                         G_TYPE_STRING, G_TYPE_STRING, \
+                                                         G_TYPE_STRING, G_TYPE_INVALID)))
+
+/* a{sv}: the fields of a mount that changed, see MountChanged */
+#define MOUNT_MONITOR_TYPE_FIELD_MAP \
+    (dbus_g_type_get_map ("GHashTable", G_TYPE_STRING, G_TYPE_VALUE))
+
+/* at: a MountHistogram, see mount_histogram_to_array() */
+#define MOUNT_MONITOR_TYPE_HISTOGRAM \
+    (dbus_g_type_get_collection ("GArray", G_TYPE_UINT64))
+
 #define MOUNT_MONITOR_TYPE         (mount_monitor_get_type ())
 #define MOUNT_MONITOR(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), MOUNT_MONITOR_TYPE, MountMonitor))
 #define IS_MOUNT_MONITOR(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), MOUNT_MONITOR_TYPE))
 
+GQuark               mount_monitor_error_quark        (void);
+GType                mount_monitor_error_get_type     (void) G_GNUC_CONST;
 GType                mount_monitor_get_type           (void) G_GNUC_CONST;
-MountMonitor  *mount_monitor_new                (void);
+MountMonitor  *mount_monitor_new                (MountBackend         backend,
+                                                              const gchar         *mountinfo_path);
+MountBackend         mount_monitor_get_backend        (MountMonitor  *monitor);
+void                 mount_monitor_set_signal_mode    (MountMonitor  *monitor,
+                                                              MountSignalMode      mode);
+void                 mount_monitor_set_history_size   (MountMonitor  *monitor,
+                                                              guint                size);
+void                 mount_monitor_set_coalescing     (MountMonitor  *monitor,
+                                                              guint                min_interval_ms,
+                                                              guint                max_latency_ms);
+MountMetrics        *mount_monitor_get_metrics        (MountMonitor  *monitor);
+void                 mount_monitor_set_connection     (MountMonitor  *monitor,
+                                                              DBusGConnection     *connection);
+void                 mount_monitor_load_snapshot      (MountMonitor  *monitor,
+                                                              const gchar         *path);
+gboolean             mount_monitor_save_snapshot      (MountMonitor  *monitor,
+                                                              const gchar         *path,
+                                                              GError             **error);
+gboolean             mount_monitor_set_journal        (MountMonitor  *monitor,
+                                                              const gchar         *path,
+                                                              guint64              max_size,
+                                                              guint                max_files,
+                                                              GError             **error);
+gboolean             mount_monitor_watch_namespace    (MountMonitor  *monitor,
+                                                              guint                pid,
+                                                              guint64             *out_ns_id,
+                                                              GError             **error);
+gboolean             mount_monitor_unwatch_namespace  (MountMonitor  *monitor,
+                                                              guint64              ns_id,
+                                                              GError             **error);
 GList               *mount_monitor_get_mounts_for_dev (MountMonitor  *monitor,
                                                               dev_t                dev);
 gboolean             mount_monitor_is_dev_in_use      (MountMonitor  *monitor,
                                                               dev_t                dev,
                                                               MountType     *out_type);
+gboolean             mount_monitor_dbus_get_mounts    (MountMonitor  *monitor,
+                                                              guint64             *out_generation,
+                                                              GPtrArray          **out_mounts,
+                                                              GError             **error);
+gboolean             mount_monitor_dbus_get_mounts_for_dev (MountMonitor  *monitor,
+                                                              guint64              dev,
+                                                              GPtrArray          **out_mounts,
+                                                              GError             **error);
+gboolean             mount_monitor_dbus_get_mounts_under (MountMonitor  *monitor,
+                                                              const gchar         *path,
+                                                              GPtrArray          **out_mounts,
+                                                              GError             **error);
+gboolean             mount_monitor_dbus_get_mount_subtree (MountMonitor  *monitor,
+                                                              guint64              ns_id,
+                                                              guint64              mount_id,
+                                                              GPtrArray          **out_mounts,
+                                                              GError             **error);
+gboolean             mount_monitor_dbus_is_dev_in_use (MountMonitor  *monitor,
+                                                              guint64              dev,
+                                                              gboolean            *out_in_use,
+                                                              gchar              **out_type,
+                                                              GError             **error);
+gboolean             mount_monitor_dbus_get_changes_since (MountMonitor  *monitor,
+                                                              guint64              since,
+                                                              guint64             *out_generation,
+                                                              gboolean            *out_snapshot,
+                                                              GPtrArray          **out_changes,
+                                                              GError             **error);
+gboolean             mount_monitor_dbus_watch_namespace (MountMonitor  *monitor,
+                                                              guint                pid,
+                                                              DBusGMethodInvocation *context);
+gboolean             mount_monitor_dbus_open_shared_table (MountMonitor  *monitor,
+                                                              DBusGMethodInvocation *context);
+gboolean             mount_monitor_dbus_subscribe     (MountMonitor  *monitor,
+                                                              GHashTable          *filter,
+                                                              DBusGMethodInvocation *context);
+gboolean             mount_monitor_dbus_unsubscribe   (MountMonitor  *monitor,
+                                                              guint                id,
+                                                              DBusGMethodInvocation *context);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,1416 @@
+#include "mountnamespace.h"
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/inotify.h>
+#include <gio/gio.h>
+#include "arena.h"
+
+/* Records per arena chunk */
+#define RECORD_ARENA_CHUNK 1024
+
+/* shared by the records of all namespaces */
+static MountArena *record_arena = NULL;
+
+/* Mount sources (block special files) resolved so far, at most this many */
+#define SOURCE_CACHE_MAX 1024
+
+typedef struct
+{
+    gboolean found;
+    dev_t dev;
+} SourceDev;
+
+/* source -> SourceDev, shared by all namespaces.  It is emptied the next
+ * time it is used after mount_namespace_invalidate_sources() was called,
+ * possibly from another thread.
+ */
+G_LOCK_DEFINE_STATIC (source_cache);
+static GHashTable *source_cache = NULL;
+static gint source_cache_serial = 0;
+static gint sources_serial = 0;
+
+static GHashTable *
+mount_table_new (void)
+{
+    return g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                  (GDestroyNotify) mount_info_unref, NULL);
+}
+
+static void
+mount_dev_entry_free (MountDevEntry *entry)
+{
+    g_list_free (entry->mounts);
+    g_free (entry);
+}
+
+/* FNV-1a, used to find the record of a mountinfo line; the line itself
+ * decides whether it is the same one */
+static guint64
+fingerprint (const gchar *data,
+             gsize        len)
+{
+    guint64 h = G_GUINT64_CONSTANT (0xcbf29ce484222325);
+    gsize n;
+
+    for (n = 0; n < len; n++)
+    {
+        h ^= (guchar) data[n];
+        h *= G_GUINT64_CONSTANT (0x100000001b3);
+    }
+
+    return h;
+}
+
+static void
+mount_record_free (MountRecord *record)
+{
+    if (record->mount != NULL)
+        mount_info_unref (record->mount);
+    g_free (record->line);
+    mount_arena_release (record_arena, record);
+}
+
+static guint
+mount_record_hash (gconstpointer key)
+{
+    const MountRecord *record = key;
+
+    return (guint) (record->fingerprint ^ (record->fingerprint >> 32));
+}
+
+/* Lines are compared in full, so a crafted mount path whose line has the
+ * fingerprint of another one can't pass for it */
+static gboolean
+mount_record_equal (gconstpointer a,
+                    gconstpointer b)
+{
+    const MountRecord *x = a;
+    const MountRecord *y = b;
+
+    if (x->fingerprint != y->fingerprint || x->line_len != y->line_len)
+        return FALSE;
+    if (x->line == NULL || y->line == NULL)
+        return x->line == y->line;
+    return memcmp (x->line, y->line, x->line_len) == 0;
+}
+
+static GHashTable *
+mount_record_table_new (void)
+{
+    return g_hash_table_new_full (mount_record_hash, mount_record_equal,
+                                  NULL, (GDestroyNotify) mount_record_free);
+}
+
+/* The record of line (or of kernel mount key if line is NULL) */
+static MountRecord *
+mount_namespace_lookup_record (GHashTable  *records,
+                               guint64      key,
+                               const gchar *line,
+                               gsize        line_len)
+{
+    MountRecord probe;
+
+    probe.fingerprint = key;
+    probe.line = (gchar *) line;
+    probe.line_len = line_len;
+
+    return g_hash_table_lookup (records, &probe);
+}
+
+/* Whether a line with details can be a new version of mount: the kernel
+ * reuses a mountinfo ID as soon as its mount is gone, but what a mount was
+ * made from never changes
+ */
+static gboolean
+mount_is_same_kernel_mount (MountInfo          *mount,
+                            dev_t               dev,
+                            const MountDetails *details)
+{
+    return mount->dev == dev &&
+           g_strcmp0 (mount->fstype, details->fstype) == 0 &&
+           g_strcmp0 (mount->source, details->source) == 0 &&
+           g_strcmp0 (mount->root, details->root) == 0;
+}
+
+/* Returns the mount a record stands for, creating it from details if
+ * needed.  With the mountinfo backend a line shares the mount of the
+ * known line with the same kernel mount ID, which makes it a new version
+ * of that mount, see mount_namespace_scan_file(); every other record has
+ * a mount of its own, so unrelated mounts at the same (dev, mount_point)
+ * stay apart.  Newly created mounts are also prepended to *added.  For
+ * swaps mount_point and source are the swap file or partition.
+ */
+static MountInfo *
+mount_namespace_ref_mount (MountNamespace     *ns,
+                           dev_t               dev,
+                           const gchar        *mount_point,
+                           MountType           type,
+                           const MountDetails *details,
+                           GList             **added)
+{
+    MountInfo *mount;
+    MountDevEntry *entry;
+    gboolean by_id;
+
+    by_id = type == MOUNT_TYPE_FILESYSTEM && details->unique_id == 0;
+    if (by_id)
+    {
+        mount = g_hash_table_lookup (ns->mounts_by_id, &details->mount_id);
+        if (mount != NULL && mount_is_same_kernel_mount (mount, dev, details))
+            goto out;
+    }
+
+    mount = _mount_info_new (dev, mount_point, type, details);
+    mount->ns_id = ns->id;
+    g_hash_table_add (ns->mounts, mount);
+    /* a recycled ID: the mount that had it is about to be retired */
+    if (by_id)
+        g_hash_table_replace (ns->mounts_by_id, &mount->mount_id, mount);
+
+    entry = g_hash_table_lookup (ns->mounts_by_dev, &mount->dev);
+    if (entry == NULL)
+    {
+        entry = g_new0 (MountDevEntry, 1);
+        entry->dev = mount->dev;
+        g_hash_table_insert (ns->mounts_by_dev, &entry->dev, entry);
+    }
+    entry->mounts = g_list_prepend (entry->mounts, mount);
+
+    *added = g_list_prepend (*added, mount);
+
+out:
+    mount->n_records++;
+    return mount_info_ref (mount);
+}
+
+/* Drops a record's hold on its mount.  When the last record referring to a
+ * mount goes away the mount leaves the tables and is prepended to *removed,
+ * which owns a reference.
+ */
+static void
+mount_namespace_unref_mount (MountNamespace *ns,
+                             MountInfo      *mount,
+                             GList         **removed)
+{
+    MountDevEntry *entry;
+
+    if (--mount->n_records > 0)
+        return;
+
+    entry = g_hash_table_lookup (ns->mounts_by_dev, &mount->dev);
+    if (entry != NULL)
+    {
+        entry->mounts = g_list_remove (entry->mounts, mount);
+        if (entry->mounts == NULL)
+            g_hash_table_remove (ns->mounts_by_dev, &mount->dev);
+    }
+
+    if (g_hash_table_lookup (ns->mounts_by_id, &mount->mount_id) == mount)
+        g_hash_table_remove (ns->mounts_by_id, &mount->mount_id);
+
+    *removed = g_list_prepend (*removed, mount_info_ref (mount));
+    g_hash_table_remove (ns->mounts, mount);
+}
+
+/* Forgets the devices of the mount sources resolved so far; to be called
+ * when block devices come or go.  May be called from any thread.
+ */
+void
+mount_namespace_invalidate_sources (void)
+{
+    g_atomic_int_inc (&sources_serial);
+}
+
+/* The block device of the special file source.  Both results are cached,
+ * so a source is looked at once until the sources are invalidated.
+ */
+static gboolean
+resolve_source_dev (const gchar *source,
+                    dev_t       *out_dev)
+{
+    struct stat statbuf;
+    SourceDev *cached;
+    gboolean found;
+    gint serial;
+
+    serial = g_atomic_int_get (&sources_serial);
+
+    G_LOCK (source_cache);
+    if (source_cache == NULL)
+        source_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    if (source_cache_serial != serial || g_hash_table_size (source_cache) >= SOURCE_CACHE_MAX)
+    {
+        g_hash_table_remove_all (source_cache);
+        source_cache_serial = serial;
+    }
+    cached = g_hash_table_lookup (source_cache, source);
+    if (cached != NULL)
+    {
+        found = cached->found;
+        *out_dev = cached->dev;
+        G_UNLOCK (source_cache);
+        return found;
+    }
+    G_UNLOCK (source_cache);
+
+    found = FALSE;
+    if (stat (source, &statbuf) != 0)
+        printf ("Error statting %s: %m\n", source);
+    else if (!S_ISBLK (statbuf.st_mode))
+        printf ("%s is not a block device\n", source);
+    else
+    {
+        *out_dev = statbuf.st_rdev;
+        found = TRUE;
+    }
+
+    cached = g_new0 (SourceDev, 1);
+    cached->found = found;
+    cached->dev = found ? *out_dev : 0;
+    G_LOCK (source_cache);
+    g_hash_table_replace (source_cache, g_strdup (source), cached);
+    G_UNLOCK (source_cache);
+
+    return found;
+}
+
+/* Works out the device of a mount.  Mounts of major 0 have an anonymous
+ * superblock device number and are only tracked for some filesystems:
+ *
+ *  - btrfs, whose real block device is taken from the (decoded) mount
+ *    source, see
+ *
+ *      https://bugzilla.redhat.com/show_bug.cgi?id=495152#c31
+ *      http://article.gmane.org/gmane.comp.file-systems.btrfs/2851
+ *
+ *  - overlay, zfs and nfs, which have no block device of their own; they
+ *    are tracked under the anonymous device, which is what stat() returns
+ *    as st_dev for the files on them.
+ */
+static gboolean
+resolve_mount_dev (guint        major_num,
+                   guint        minor_num,
+                   const gchar *fstype,
+                   const gchar *source,
+                   dev_t       *out_dev)
+{
+    if (major_num != 0)
+    {
+        *out_dev = makedev (major_num, minor_num);
+        return TRUE;
+    }
+
+    if (fstype == NULL)
+        return FALSE;
+
+    if (strcmp (fstype, "overlay") == 0 ||
+        strcmp (fstype, "zfs") == 0 ||
+        strcmp (fstype, "nfs") == 0 ||
+        strcmp (fstype, "nfs4") == 0)
+    {
+        *out_dev = makedev (major_num, minor_num);
+        return TRUE;
+    }
+
+    if (strcmp (fstype, "btrfs") != 0)
+        return FALSE;
+
+    if (source == NULL || !g_str_has_prefix (source, "/dev/"))
+        return FALSE;
+
+    return resolve_source_dev (source, out_dev);
+}
+
+/* Tokenizes and decodes one mountinfo line in place.  Returns FALSE for
+ * lines that don't describe a mount we track, which is decided from the
+ * numeric, fstype and source fields alone; only for the others are the
+ * paths and options decoded.  The strings returned point into line.
+ */
+static gboolean
+parse_mountinfo_line (gchar         *line,
+                      dev_t         *out_dev,
+                      const gchar  **out_mount_point,
+                      MountDetails  *details)
+{
+    MountParserEntry entry;
+
+    if (!mount_parser_parse_line (line, &entry))
+    {
+        printf ("Error parsing line '%s'\n", line);
+        return FALSE;
+    }
+
+    mount_parser_unescape_in_place ((gchar *) entry.source);
+    if (!resolve_mount_dev (entry.major, entry.minor, entry.fstype, entry.source, out_dev))
+        return FALSE;
+
+    *out_mount_point = mount_parser_unescape_in_place ((gchar *) entry.mount_point);
+    details->mount_id = entry.mount_id;
+    details->parent_id = entry.parent_id;
+    details->root = mount_parser_unescape_in_place ((gchar *) entry.root);
+    details->fstype = entry.fstype;
+    details->source = entry.source;
+    details->options = entry.options;
+    details->super_options = mount_parser_unescape_in_place ((gchar *) entry.super_options);
+    details->propagation = entry.optional_fields;
+    return TRUE;
+}
+
+/* /proc/swaps lists the swap file or partition in the first column:
+ *
+ *   Filename          Type        Size     Used  Priority
+ *   /dev/sda2         partition   8388604  0     -2
+ *
+ * line holds just that column, which is decoded in place.  Only swap
+ * partitions are tracked; their device is the one of the block special
+ * file.
+ */
+static gboolean
+parse_swaps_line (gchar        *line,
+                  dev_t        *out_dev,
+                  const gchar **out_filename)
+{
+    struct stat statbuf;
+
+    mount_parser_unescape_in_place (line);
+    if (stat (line, &statbuf) != 0 || !S_ISBLK (statbuf.st_mode))
+        return FALSE;
+
+    *out_dev = statbuf.st_rdev;
+    *out_filename = line;
+    return TRUE;
+}
+
+/* Starts tracking a record under key (a line fingerprint or a kernel
+ * mount ID); line is a copy of the line, which the record takes over, or
+ * NULL for a kernel mount.  mount_point is NULL for records that are
+ * filtered out.
+ */
+static MountRecord *
+mount_namespace_add_record (MountNamespace     *ns,
+                            GHashTable         *records,
+                            guint64             key,
+                            gchar              *line,
+                            gsize               line_len,
+                            dev_t               dev,
+                            const gchar        *mount_point,
+                            MountType           type,
+                            const MountDetails *details,
+                            GList             **added)
+{
+    MountRecord *record;
+
+    if (record_arena == NULL)
+        record_arena = mount_arena_new (sizeof (MountRecord), RECORD_ARENA_CHUNK);
+    record = mount_arena_alloc0 (record_arena);
+    record->fingerprint = key;
+    record->line = line;
+    record->line_len = line_len;
+    record->serial = ns->scan_serial;
+    g_hash_table_add (records, record);
+
+    if (mount_point != NULL)
+        record->mount = mount_namespace_ref_mount (ns, dev, mount_point, type, details, added);
+
+    return record;
+}
+
+static void
+mount_namespace_remove_record (MountNamespace *ns,
+                               GHashTable     *records,
+                               MountRecord    *record,
+                               GList         **removed)
+{
+    if (record->mount != NULL)
+        mount_namespace_unref_mount (ns, record->mount, removed);
+    g_hash_table_remove (records, record);
+}
+
+/* Whatever wasn't seen in the current scan is gone */
+static void
+mount_namespace_retire_records (MountNamespace *ns,
+                                GHashTable     *records,
+                                GList         **removed)
+{
+    GHashTableIter iter;
+    MountRecord *record;
+
+    g_hash_table_iter_init (&iter, records);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &record))
+    {
+        if (record->serial == ns->scan_serial)
+            continue;
+        if (record->mount != NULL)
+            mount_namespace_unref_mount (ns, record->mount, removed);
+        g_hash_table_iter_remove (&iter);
+    }
+}
+
+/* Puts new_mount in the place of mount, which keeps its records.  Only the
+ * tables are updated; the records are re-pointed by the caller.
+ */
+static void
+mount_namespace_replace_mount (MountNamespace *ns,
+                               MountInfo      *mount,
+                               MountInfo      *new_mount)
+{
+    MountDevEntry *entry;
+    GList *link;
+
+    new_mount->ns_id = ns->id;
+    new_mount->n_records = mount->n_records;
+
+    entry = g_hash_table_lookup (ns->mounts_by_dev, &mount->dev);
+    if (entry != NULL && (link = g_list_find (entry->mounts, mount)) != NULL)
+        link->data = new_mount;
+    if (g_hash_table_lookup (ns->mounts_by_id, &mount->mount_id) == mount)
+        g_hash_table_replace (ns->mounts_by_id, &new_mount->mount_id, new_mount);
+
+    g_hash_table_add (ns->mounts, mount_info_ref (new_mount));
+    g_hash_table_remove (ns->mounts, mount);
+}
+
+/* Applies the in-place changes found by a scan.  replacements maps each
+ * changed mount to its new version, with a reference; the changes are
+ * prepended to *changed.
+ */
+static void
+mount_namespace_apply_replacements (MountNamespace  *ns,
+                                    GHashTable      *replacements,
+                                    GList          **changed)
+{
+    GHashTableIter iter;
+    MountInfo *mount;
+    MountInfo *new_mount;
+    MountRecord *record;
+
+    if (g_hash_table_size (replacements) == 0)
+        return;
+
+    g_hash_table_iter_init (&iter, replacements);
+    while (g_hash_table_iter_next (&iter, (gpointer *) &mount, (gpointer *) &new_mount))
+    {
+        *changed = g_list_prepend (*changed,
+                                   mount_change_new (mount_info_ref (mount), mount_info_ref (new_mount),
+                                                     mount_info_diff (mount, new_mount)));
+        mount_namespace_replace_mount (ns, mount, new_mount);
+    }
+
+    /* one pass however many changed */
+    g_hash_table_iter_init (&iter, ns->records);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &record))
+    {
+        if (record->mount == NULL ||
+            (new_mount = g_hash_table_lookup (replacements, record->mount)) == NULL)
+            continue;
+        mount_info_unref (record->mount);
+        record->mount = mount_info_ref (new_mount);
+    }
+}
+
+/* Turns a kernel mount that was detached and attached again, as a move
+ * does, from a removal and an addition into a change.  Only for the
+ * statmount backend, whose unique IDs are never reused; the mountinfo
+ * backend finds its changes while scanning.  removed holds references,
+ * added doesn't.
+ */
+static void
+mount_namespace_pair_changes (MountNamespace  *ns,
+                              GList          **added,
+                              GList          **removed,
+                              GList          **changed)
+{
+    GHashTable *added_by_id;
+    MountInfo *mount;
+    MountInfo *other;
+    GList *link;
+    GList *next;
+    GList *l;
+
+    if (*added == NULL || *removed == NULL)
+        return;
+
+    added_by_id = g_hash_table_new (g_int64_hash, g_int64_equal);
+    for (l = *added; l != NULL; l = l->next)
+    {
+        mount = l->data;
+        if (mount->type == MOUNT_TYPE_FILESYSTEM)
+            g_hash_table_insert (added_by_id, &mount->unique_id, l);
+    }
+
+    for (l = *removed; l != NULL; l = next)
+    {
+        next = l->next;
+        mount = l->data;
+        if (mount->type != MOUNT_TYPE_FILESYSTEM ||
+            (link = g_hash_table_lookup (added_by_id, &mount->unique_id)) == NULL)
+            continue;
+        other = link->data;
+        if (other->dev != mount->dev || other->fstype != mount->fstype)
+            continue;
+
+        g_hash_table_remove (added_by_id, &mount->unique_id);
+        *changed = g_list_prepend (*changed,
+                                   mount_change_new (mount, mount_info_ref (other),
+                                                     mount_info_diff (mount, other)));
+        *added = g_list_delete_link (*added, link);
+        *removed = g_list_delete_link (*removed, l);
+    }
+
+    g_hash_table_unref (added_by_id);
+}
+
+/* Brings the tables up to date with the namespace's mountinfo file, or
+ * with /proc/swaps for MOUNT_TYPE_SWAP.
+ *
+ * The file is read into the shared parser's reused buffer.  Every line is
+ * fingerprinted to find its record; lines already known from the previous
+ * scan (byte for byte) only get their serial bumped, so tokenizing,
+ * allocation and table updates are limited to the lines that actually
+ * appeared or disappeared.  If the whole file is the same as last time
+ * nothing is touched at all.
+ *
+ * Mounts are identified by their kernel mount ID, not by where they
+ * are.  A new line for a mount that is already known under the same ID
+ * (a remount, a move, a propagation change) replaces the mount with a new
+ * version, which is prepended to *changed instead of *added; a mount
+ * unmounted and mounted again at the same place is a removal and an
+ * addition.
+ */
+static gboolean
+mount_namespace_scan_file (MountNamespace  *ns,
+                           MountType        type,
+                           GList          **added,
+                           GList          **removed,
+                           GList          **changed,
+                           GError         **error)
+{
+    GIOChannel *channel;
+    const gchar *path;
+    GHashTable *records;
+    gchar **last_contents;
+    gsize *last_length;
+    gchar *line;
+    gsize line_len;
+    MountRecord *record;
+    MountMetrics *metrics;
+    GHashTable *replacements;
+    gint64 start;
+    gint64 parse_start;
+    gint64 parse_ns;
+
+    *added = *removed = *changed = NULL;
+    metrics = ns->metrics;
+    start = parse_start = parse_ns = 0;
+
+    if (type == MOUNT_TYPE_SWAP)
+    {
+        channel = ns->swaps_channel;
+        path = "/proc/swaps";
+        records = ns->swap_records;
+        last_contents = &ns->swaps_contents;
+        last_length = &ns->swaps_length;
+    }
+    else
+    {
+        channel = ns->mounts_channel;
+        path = ns->mountinfo_path;
+        records = ns->records;
+        last_contents = &ns->mountinfo_contents;
+        last_length = &ns->mountinfo_length;
+    }
+
+    if (channel == NULL)
+    {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+                     "%s is not open", path);
+        return FALSE;
+    }
+
+    if (metrics != NULL)
+        start = mount_metrics_now_ns ();
+    if (!mount_parser_read_fd (ns->parser, g_io_channel_unix_get_fd (channel), error))
+    {
+        g_prefix_error (error, "Error reading %s: ", path);
+        return FALSE;
+    }
+    if (metrics != NULL)
+    {
+        gint64 now = mount_metrics_now_ns ();
+
+        mount_histogram_add (&metrics->read_time, now - start);
+        metrics->reloads++;
+        metrics->bytes_read += ns->parser->len;
+        start = now;
+    }
+
+    if (*last_contents != NULL &&
+        ns->parser->len == *last_length &&
+        memcmp (ns->parser->buf, *last_contents, *last_length) == 0)
+    {
+        if (metrics != NULL)
+            metrics->unchanged_reloads++;
+        return TRUE;
+    }
+    /* kept before the lines are tokenized in place */
+    *last_contents = g_realloc (*last_contents, ns->parser->len + 1);
+    memcpy (*last_contents, ns->parser->buf, ns->parser->len);
+    *last_length = ns->parser->len;
+    ns->scan_serial++;
+    /* MountInfo -> its new version */
+    replacements = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                          NULL, (GDestroyNotify) mount_info_unref);
+
+    while (mount_parser_next_line (ns->parser, &line, &line_len))
+    {
+        guint64 line_fingerprint;
+        gchar *line_copy;
+        const gchar *mount_point;
+        MountDetails details;
+        gboolean tracked;
+        dev_t dev;
+
+        if (line_len == 0)
+            continue;
+
+        if (type == MOUNT_TYPE_SWAP)
+        {
+            if (g_str_has_prefix (line, "Filename"))
+                continue;
+            /* only the file name, the usage columns change all the time */
+            line_len = strcspn (line, " \t");
+            line[line_len] = '\0';
+        }
+
+        if (metrics != NULL)
+            metrics->lines_scanned++;
+        line_fingerprint = fingerprint (line, line_len);
+        record = mount_namespace_lookup_record (records, line_fingerprint, line, line_len);
+        if (record != NULL)
+        {
+            record->serial = ns->scan_serial;
+            continue;
+        }
+
+        if (metrics != NULL)
+        {
+            metrics->lines_parsed++;
+            parse_start = mount_metrics_now_ns ();
+        }
+
+        /* parsing decodes the line in place */
+        line_copy = g_strndup (line, line_len);
+        memset (&details, 0, sizeof details);
+        if (type == MOUNT_TYPE_SWAP)
+        {
+            tracked = parse_swaps_line (line, &dev, &mount_point);
+            details.fstype = "swap";
+            details.source = mount_point;
+        }
+        else
+            tracked = parse_mountinfo_line (line, &dev, &mount_point, &details);
+
+        /* filtered lines are remembered too, so they are skipped next time */
+        if (tracked)
+        {
+            GList *last_added = *added;
+
+            record = mount_namespace_add_record (ns, records, line_fingerprint, line_copy, line_len,
+                                                 dev, mount_point, type, &details, added);
+            /* an existing mount under the same ID: its old line is about to
+             * be retired */
+            if (*added == last_added && type == MOUNT_TYPE_FILESYSTEM &&
+                !g_hash_table_contains (replacements, record->mount))
+            {
+                MountInfo *new_mount = _mount_info_new (dev, mount_point, type, &details);
+
+                if (mount_info_diff (record->mount, new_mount) != 0)
+                    g_hash_table_insert (replacements, record->mount, new_mount);
+                else
+                    mount_info_unref (new_mount);
+            }
+        }
+        else
+            mount_namespace_add_record (ns, records, line_fingerprint, line_copy, line_len,
+                                        0, NULL, type, NULL, added);
+
+        if (metrics != NULL)
+            parse_ns += mount_metrics_now_ns () - parse_start;
+    }
+
+    mount_namespace_retire_records (ns, records, removed);
+    mount_namespace_apply_replacements (ns, replacements, changed);
+    g_hash_table_unref (replacements);
+
+    /* the diff is everything after the read that wasn't parsing */
+    if (metrics != NULL)
+    {
+        mount_histogram_add (&metrics->parse_time, parse_ns);
+        mount_histogram_add (&metrics->diff_time, mount_metrics_now_ns () - start - parse_ns);
+    }
+
+    return TRUE;
+}
+
+/* Records the mount with the given kernel ID, if it still exists */
+static void
+mount_namespace_stat_kernel_mount (MountNamespace *ns,
+                                   guint64         mnt_id,
+                                   GList         **added)
+{
+    KernelMount kmount;
+    MountDetails details;
+    GError *error;
+    dev_t dev;
+
+    error = NULL;
+    if (!kernel_mount_source_stat (ns->kernel_mounts, mnt_id, &kmount, &error))
+    {
+        /* detached again before we got to it */
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+            printf ("Error getting mount %" G_GUINT64_FORMAT ": %s\n", mnt_id, error->message);
+        g_error_free (error);
+        return;
+    }
+
+    if (!resolve_mount_dev (kmount.major, kmount.minor, kmount.fstype, kmount.source, &dev))
+    {
+        mount_namespace_add_record (ns, ns->records, mnt_id, NULL, 0, 0, NULL,
+                                    MOUNT_TYPE_FILESYSTEM, NULL, added);
+        return;
+    }
+
+    details.mount_id = kmount.mountinfo_id;
+    details.parent_id = kmount.mountinfo_parent_id;
+    details.unique_id = mnt_id;
+    details.root = kmount.root;
+    details.fstype = kmount.fstype;
+    details.source = kmount.source;
+    details.options = kmount.options;
+    details.super_options = kmount.super_options;
+    details.propagation = kmount.propagation;
+    mount_namespace_add_record (ns, ns->records, mnt_id, NULL, 0, dev, kmount.mount_point,
+                                MOUNT_TYPE_FILESYSTEM, &details, added);
+}
+
+/* Full resync through listmount(): used for the baseline and whenever the
+ * fanotify queue overflowed.  Only mounts not known yet are statmount()ed.
+ */
+static gboolean
+mount_namespace_get_kernel_mounts (MountNamespace  *ns,
+                                   GList          **added,
+                                   GList          **removed,
+                                   GError         **error)
+{
+    GArray *ids;
+    MountRecord *record;
+    guint n;
+
+    *added = *removed = NULL;
+
+    ids = g_array_new (FALSE, FALSE, sizeof (guint64));
+    if (!kernel_mount_source_list (ns->kernel_mounts, ids, error))
+    {
+        g_array_unref (ids);
+        return FALSE;
+    }
+
+    ns->scan_serial++;
+    for (n = 0; n < ids->len; n++)
+    {
+        guint64 mnt_id = g_array_index (ids, guint64, n);
+
+        record = mount_namespace_lookup_record (ns->records, mnt_id, NULL, 0);
+        if (record != NULL)
+            record->serial = ns->scan_serial;
+        else
+            mount_namespace_stat_kernel_mount (ns, mnt_id, added);
+    }
+    g_array_unref (ids);
+
+    mount_namespace_retire_records (ns, ns->records, removed);
+
+    return TRUE;
+}
+
+typedef struct
+{
+    MountNamespace *ns;
+    GList *added;
+    GList *removed;
+    gboolean overflow;
+} KernelEventData;
+
+static void
+on_kernel_mount_event (KernelMountEvent  event,
+                       guint64           mnt_id,
+                       gpointer          user_data)
+{
+    KernelEventData *data = user_data;
+    MountRecord *record;
+
+    switch (event)
+    {
+    case KERNEL_MOUNT_ATTACHED:
+        if (mount_namespace_lookup_record (data->ns->records, mnt_id, NULL, 0) != NULL)
+            break;
+        mount_namespace_stat_kernel_mount (data->ns, mnt_id, &data->added);
+        break;
+
+    case KERNEL_MOUNT_DETACHED:
+        record = mount_namespace_lookup_record (data->ns->records, mnt_id, NULL, 0);
+        if (record != NULL)
+            mount_namespace_remove_record (data->ns, data->ns->records, record, &data->removed);
+        break;
+
+    case KERNEL_MOUNT_OVERFLOW:
+        data->overflow = TRUE;
+        break;
+    }
+}
+
+static gboolean
+mount_namespace_read_kernel_events (MountNamespace  *ns,
+                                    GList          **added,
+                                    GList          **removed,
+                                    GError         **error)
+{
+    KernelEventData data;
+    GList *more_added;
+    GList *more_removed;
+
+    data.ns = ns;
+    data.added = NULL;
+    data.removed = NULL;
+    data.overflow = FALSE;
+
+    if (!kernel_mount_source_read_events (ns->kernel_mounts, on_kernel_mount_event, &data, error))
+    {
+        *added = data.added;
+        *removed = data.removed;
+        return FALSE;
+    }
+
+    if (data.overflow)
+    {
+        if (!mount_namespace_get_kernel_mounts (ns, &more_added, &more_removed, error))
+        {
+            *added = data.added;
+            *removed = data.removed;
+            return FALSE;
+        }
+        data.added = g_list_concat (more_added, data.added);
+        data.removed = g_list_concat (more_removed, data.removed);
+    }
+
+    *added = data.added;
+    *removed = data.removed;
+    return TRUE;
+}
+
+static void
+reload_mounts (MountNamespace *ns,
+               MountType       type)
+{
+    GError *error;
+    GList *added;
+    GList *removed;
+    GList *changed;
+
+    error = NULL;
+    if (!mount_namespace_scan_file (ns, type, &added, &removed, &changed, &error))
+    {
+        printf ("Error getting mounts: %s (%s, %d)\n",
+                        error->message, g_quark_to_string (error->domain), error->code);
+        g_error_free (error);
+        return;
+    }
+
+    ns->changed_func (ns, added, removed, changed, ns->user_data);
+}
+
+static gboolean
+coalesced_reload (gpointer user_data)
+{
+    MountNamespace *ns = user_data;
+
+    g_source_unref (ns->coalesce_source);
+    ns->coalesce_source = NULL;
+    reload_mounts (ns, MOUNT_TYPE_FILESYSTEM);
+
+    return FALSE;
+}
+
+static void
+schedule_coalesced_reload (MountNamespace *ns)
+{
+    gint64 now;
+    gint64 deadline;
+    gint64 due;
+
+    now = g_get_monotonic_time ();
+    if (ns->coalesce_source == NULL)
+        ns->coalesce_first_event = now;
+    else
+    {
+        g_source_destroy (ns->coalesce_source);
+        g_source_unref (ns->coalesce_source);
+        if (ns->metrics != NULL)
+            ns->metrics->coalesced_events++;
+    }
+
+    due = now + (gint64) ns->coalesce_min_ms * 1000;
+    deadline = ns->coalesce_first_event + (gint64) ns->coalesce_max_ms * 1000;
+    if (due > deadline)
+        due = deadline;
+
+    ns->coalesce_source = g_timeout_source_new (MAX (due - now, 0) / 1000);
+    g_source_set_callback (ns->coalesce_source, coalesced_reload, ns, NULL);
+    g_source_attach (ns->coalesce_source, g_main_context_get_thread_default ());
+}
+
+static gboolean
+mounts_changed_event (GIOChannel *channel,
+                      GIOCondition cond,
+                      gpointer user_data)
+{
+    MountNamespace *ns = user_data;
+    if (cond & ~G_IO_ERR)
+        goto out;
+    if (ns->coalesce_min_ms > 0)
+        schedule_coalesced_reload (ns);
+    else
+        reload_mounts (ns, MOUNT_TYPE_FILESYSTEM);
+
+out:
+    return TRUE;
+}
+
+/* A regular file standing in for mountinfo was rewritten and closed */
+static gboolean
+file_changed_event (GIOChannel *channel,
+                    GIOCondition cond,
+                    gpointer user_data)
+{
+    MountNamespace *ns = user_data;
+    gchar buf[4096];
+
+    /* all that matters is that something happened */
+    while (read (g_io_channel_unix_get_fd (channel), buf, sizeof buf) > 0)
+        ;
+    return mounts_changed_event (channel, G_IO_ERR, user_data);
+}
+
+/* swapon/swapoff are rare enough not to need coalescing */
+static gboolean
+swaps_changed_event (GIOChannel *channel,
+                     GIOCondition cond,
+                     gpointer user_data)
+{
+    MountNamespace *ns = user_data;
+    if (cond & ~G_IO_ERR)
+        goto out;
+    reload_mounts (ns, MOUNT_TYPE_SWAP);
+
+out:
+    return TRUE;
+}
+
+/* The kernel reports exactly which mounts changed, so there is nothing to
+ * coalesce: every batch of events is applied as it comes.
+ */
+static gboolean
+kernel_mounts_event (GIOChannel *channel,
+                     GIOCondition cond,
+                     gpointer user_data)
+{
+    MountNamespace *ns = user_data;
+    GError *error;
+    GList *added;
+    GList *removed;
+    GList *changed;
+
+    if (ns->metrics != NULL)
+        ns->metrics->kernel_events++;
+
+    error = NULL;
+    if (!mount_namespace_read_kernel_events (ns, &added, &removed, &error))
+    {
+        printf ("Error reading mount events: %s\n", error->message);
+        g_error_free (error);
+    }
+    changed = NULL;
+    mount_namespace_pair_changes (ns, &added, &removed, &changed);
+    ns->changed_func (ns, added, removed, changed, ns->user_data);
+
+    return TRUE;
+}
+
+static gboolean
+mount_namespace_setup_kernel_mounts (MountNamespace *ns)
+{
+    GError *error;
+    gchar *ns_path;
+
+    error = NULL;
+    ns_path = ns->pid != 0 ? g_strdup_printf ("/proc/%u/ns/mnt", ns->pid) : NULL;
+    ns->kernel_mounts = kernel_mount_source_new (ns_path, &error);
+    g_free (ns_path);
+    if (ns->kernel_mounts == NULL)
+    {
+        printf ("listmount/statmount backend not available, using %s: %s\n",
+                ns->mountinfo_path, error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    ns->kernel_channel = g_io_channel_unix_new (kernel_mount_source_get_fd (ns->kernel_mounts));
+    ns->kernel_watch_source = g_io_create_watch (ns->kernel_channel, G_IO_IN);
+    g_source_set_callback (ns->kernel_watch_source, (GSourceFunc) kernel_mounts_event, ns, NULL);
+    g_source_attach (ns->kernel_watch_source, g_main_context_get_thread_default ());
+    g_source_unref (ns->kernel_watch_source);
+
+    return TRUE;
+}
+
+static gboolean
+mount_namespace_setup_mountinfo (MountNamespace  *ns,
+                                 GError         **error)
+{
+    ns->mounts_channel = g_io_channel_new_file (ns->mountinfo_path, "r", error);
+    if (ns->mounts_channel == NULL)
+        return FALSE;
+
+    ns->mounts_watch_source = g_io_create_watch (ns->mounts_channel, G_IO_ERR);
+    g_source_set_callback (ns->mounts_watch_source, (GSourceFunc) mounts_changed_event, ns, NULL);
+    g_source_attach (ns->mounts_watch_source, g_main_context_get_thread_default ());
+    g_source_unref (ns->mounts_watch_source);
+
+    return TRUE;
+}
+
+/* Regular files don't signal changes the way /proc does.  Only writes that
+ * end with close() are noticed, so the file has to be rewritten in place
+ * with a single open/write/close; a file renamed over it is not seen.
+ */
+static gboolean
+mount_namespace_setup_file_watch (MountNamespace  *ns,
+                                  GError         **error)
+{
+    int fd;
+    int errsv;
+
+    fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch (fd, ns->mountinfo_path, IN_CLOSE_WRITE) < 0)
+    {
+        errsv = errno;
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+                     "Error watching %s: %s", ns->mountinfo_path, g_strerror (errsv));
+        if (fd >= 0)
+            close (fd);
+        return FALSE;
+    }
+
+    ns->inotify_channel = g_io_channel_unix_new (fd);
+    g_io_channel_set_close_on_unref (ns->inotify_channel, TRUE);
+    ns->inotify_watch_source = g_io_create_watch (ns->inotify_channel, G_IO_IN);
+    g_source_set_callback (ns->inotify_watch_source, (GSourceFunc) file_changed_event, ns, NULL);
+    g_source_attach (ns->inotify_watch_source, g_main_context_get_thread_default ());
+    g_source_unref (ns->inotify_watch_source);
+
+    return TRUE;
+}
+
+/* /proc/swaps is the same in every namespace, so only our own one
+ * watches it.  Like mountinfo, it signals changes as an error condition.
+ */
+static void
+mount_namespace_setup_swaps (MountNamespace *ns)
+{
+    GError *error;
+
+    error = NULL;
+    ns->swaps_channel = g_io_channel_new_file ("/proc/swaps", "r", &error);
+    if (ns->swaps_channel == NULL)
+    {
+        printf ("No /proc/swaps file, not watching swaps: %s\n", error->message);
+        g_error_free (error);
+        return;
+    }
+
+    ns->swaps_watch_source = g_io_create_watch (ns->swaps_channel, G_IO_ERR);
+    g_source_set_callback (ns->swaps_watch_source, (GSourceFunc) swaps_changed_event, ns, NULL);
+    g_source_attach (ns->swaps_watch_source, g_main_context_get_thread_default ());
+    g_source_unref (ns->swaps_watch_source);
+}
+
+/* The initial set of mounts is not reported, so the first change event
+ * already has something to diff against.
+ */
+static void
+mount_namespace_load_baseline (MountNamespace *ns)
+{
+    GError *error;
+    GList *added;
+    GList *removed;
+    GList *changed;
+
+    error = NULL;
+    changed = NULL;
+    if (!(ns->backend == MOUNT_BACKEND_STATMOUNT ?
+          mount_namespace_get_kernel_mounts (ns, &added, &removed, &error) :
+          mount_namespace_scan_file (ns, MOUNT_TYPE_FILESYSTEM, &added, &removed, &changed, &error)))
+    {
+        printf ("Error getting mounts: %s (%s, %d)\n",
+                        error->message, g_quark_to_string (error->domain), error->code);
+        g_clear_error (&error);
+    }
+    else
+    {
+        g_list_free (added);
+        g_list_free_full (removed, (GDestroyNotify) mount_info_unref);
+        g_list_free_full (changed, (GDestroyNotify) mount_change_free);
+    }
+
+    if (ns->swaps_channel == NULL)
+        return;
+
+    if (!mount_namespace_scan_file (ns, MOUNT_TYPE_SWAP, &added, &removed, &changed, &error))
+    {
+        printf ("Error getting swaps: %s (%s, %d)\n",
+                        error->message, g_quark_to_string (error->domain), error->code);
+        g_error_free (error);
+        return;
+    }
+
+    g_list_free (added);
+    g_list_free_full (removed, (GDestroyNotify) mount_info_unref);
+    g_list_free_full (changed, (GDestroyNotify) mount_change_free);
+}
+
+/* The namespace is identified by the inode of its ns/mnt file, which is
+ * what lsns and /proc/<pid>/ns/mnt links show.  pid 0 means our own.
+ */
+gboolean
+mount_namespace_get_id_for_pid (guint     pid,
+                                guint64  *out_id,
+                                GError  **error)
+{
+    gchar *path;
+    struct stat statbuf;
+    int errsv;
+
+    path = pid != 0 ? g_strdup_printf ("/proc/%u/ns/mnt", pid) : g_strdup ("/proc/self/ns/mnt");
+    if (stat (path, &statbuf) != 0)
+    {
+        errsv = errno;
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+                     "Error statting %s: %s", path, g_strerror (errsv));
+        g_free (path);
+        return FALSE;
+    }
+    g_free (path);
+
+    *out_id = statbuf.st_ino;
+    return TRUE;
+}
+
+static MountNamespace *
+mount_namespace_alloc (guint64                    id,
+                       guint                      pid,
+                       gchar                     *mountinfo_path,
+                       MountParser               *parser,
+                       MountNamespaceChangedFunc  changed_func,
+                       gpointer                   user_data)
+{
+    MountNamespace *ns;
+
+    ns = g_new0 (MountNamespace, 1);
+    ns->id = id;
+    ns->pid = pid;
+    ns->mountinfo_path = mountinfo_path;
+    ns->parser = parser;
+    ns->changed_func = changed_func;
+    ns->user_data = user_data;
+    ns->mounts = mount_table_new ();
+    ns->mounts_by_id = g_hash_table_new (g_int64_hash, g_int64_equal);
+    ns->mounts_by_dev = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                               NULL, (GDestroyNotify) mount_dev_entry_free);
+    ns->records = mount_record_table_new ();
+    ns->swap_records = mount_record_table_new ();
+
+    return ns;
+}
+
+/* Starts watching the mount namespace of pid (0 for our own) and loads its
+ * current mounts.  changed_func is called from the main loop for every
+ * change after that.  The parser is borrowed and must outlive the
+ * namespace.
+ */
+MountNamespace *
+mount_namespace_new (guint                      pid,
+                     MountBackend               backend,
+                     MountParser               *parser,
+                     MountNamespaceChangedFunc  changed_func,
+                     gpointer                   user_data,
+                     GError                   **error)
+{
+    MountNamespace *ns;
+    guint64 id;
+
+    if (!mount_namespace_get_id_for_pid (pid, &id, error))
+        return NULL;
+
+    ns = mount_namespace_alloc (id, pid,
+                                pid != 0 ? g_strdup_printf ("/proc/%u/mountinfo", pid)
+                                         : g_strdup ("/proc/self/mountinfo"),
+                                parser, changed_func, user_data);
+
+    if (backend != MOUNT_BACKEND_MOUNTINFO &&
+        mount_namespace_setup_kernel_mounts (ns))
+    {
+        ns->backend = MOUNT_BACKEND_STATMOUNT;
+    }
+    else
+    {
+        ns->backend = MOUNT_BACKEND_MOUNTINFO;
+        if (!mount_namespace_setup_mountinfo (ns, error))
+        {
+            mount_namespace_free (ns);
+            return NULL;
+        }
+    }
+
+    if (pid == 0)
+        mount_namespace_setup_swaps (ns);
+
+    mount_namespace_load_baseline (ns);
+
+    return ns;
+}
+
+/* Reads the mount table from any mountinfo-style file instead of /proc,
+ * always with the mountinfo backend and without swaps.  The file is watched
+ * with inotify; mount_namespace_reload() rescans it right away.  Used to
+ * replay synthetic tables, e.g. by the benchmark and the latency harness.
+ */
+MountNamespace *
+mount_namespace_new_for_file (const gchar               *mountinfo_path,
+                              MountParser               *parser,
+                              MountNamespaceChangedFunc  changed_func,
+                              gpointer                   user_data,
+                              GError                   **error)
+{
+    MountNamespace *ns;
+
+    ns = mount_namespace_alloc (0, 0, g_strdup (mountinfo_path), parser, changed_func, user_data);
+    ns->backend = MOUNT_BACKEND_MOUNTINFO;
+    if (!mount_namespace_setup_mountinfo (ns, error) ||
+        !mount_namespace_setup_file_watch (ns, error))
+    {
+        mount_namespace_free (ns);
+        return NULL;
+    }
+
+    mount_namespace_load_baseline (ns);
+
+    return ns;
+}
+
+/* Rescans the mountinfo file right away, as on a change notification, and
+ * reports the differences to changed_func before returning
+ */
+void
+mount_namespace_reload (MountNamespace *ns)
+{
+    reload_mounts (ns, MOUNT_TYPE_FILESYSTEM);
+}
+
+void
+mount_namespace_free (MountNamespace *ns)
+{
+    if (ns == NULL)
+        return;
+
+    if (ns->mounts_watch_source != NULL)
+        g_source_destroy (ns->mounts_watch_source);
+    if (ns->mounts_channel != NULL)
+        g_io_channel_unref (ns->mounts_channel);
+    if (ns->kernel_watch_source != NULL)
+        g_source_destroy (ns->kernel_watch_source);
+    if (ns->kernel_channel != NULL)
+        g_io_channel_unref (ns->kernel_channel);
+    kernel_mount_source_free (ns->kernel_mounts);
+    if (ns->inotify_watch_source != NULL)
+        g_source_destroy (ns->inotify_watch_source);
+    if (ns->inotify_channel != NULL)
+        g_io_channel_unref (ns->inotify_channel);
+    if (ns->coalesce_source != NULL)
+    {
+        g_source_destroy (ns->coalesce_source);
+        g_source_unref (ns->coalesce_source);
+    }
+    if (ns->swaps_watch_source != NULL)
+        g_source_destroy (ns->swaps_watch_source);
+    if (ns->swaps_channel != NULL)
+        g_io_channel_unref (ns->swaps_channel);
+
+    g_hash_table_unref (ns->swap_records);
+    g_hash_table_unref (ns->records);
+    g_hash_table_unref (ns->mounts_by_dev);
+    g_hash_table_unref (ns->mounts_by_id);
+    g_hash_table_unref (ns->mounts);
+    g_free (ns->mountinfo_contents);
+    g_free (ns->swaps_contents);
+    g_free (ns->mountinfo_path);
+    g_free (ns);
+}
+
+/* Returns the mounts and swaps of dev, owned by the namespace */
+GList *
+mount_namespace_get_mounts_for_dev (MountNamespace *ns,
+                                    dev_t           dev)
+{
+    MountDevEntry *entry;
+    gint64 key = dev;
+
+    entry = g_hash_table_lookup (ns->mounts_by_dev, &key);
+    return entry != NULL ? entry->mounts : NULL;
+}
+
+guint64
+mount_namespace_get_id (MountNamespace *ns)
+{
+    return ns->id;
+}
+
+MountBackend
+mount_namespace_get_backend (MountNamespace *ns)
+{
+    return ns->backend;
+}
+
+/* With a non-zero min_interval_ms, change notifications are merged into a
+ * single reload that runs once no further notification has arrived for
+ * min_interval_ms, but never later than max_latency_ms after the first one.
+ */
+void
+mount_namespace_set_coalescing (MountNamespace *ns,
+                                guint           min_interval_ms,
+                                guint           max_latency_ms)
+{
+    ns->coalesce_min_ms = min_interval_ms;
+    ns->coalesce_max_ms = MAX (min_interval_ms, max_latency_ms);
+}
+
+/* Where scans and events are counted from now on; borrowed, NULL to stop */
+void
+mount_namespace_set_metrics (MountNamespace *ns,
+                             MountMetrics   *metrics)
+{
+    ns->metrics = metrics;
+}
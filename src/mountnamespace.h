@@ -0,0 +1,139 @@
+#ifndef __MOUNT_NAMESPACE_H__
+#define __MOUNT_NAMESPACE_H__
+#include "mountinfo.h"
+#include "mountparser.h"
+#include "kernelmounts.h"
+#include "metrics.h"
+
+typedef struct _MountDevEntry MountDevEntry;
+struct _MountDevEntry {
+    dev_t dev;
+    GList *mounts;
+};
+
+/* One line of the namespace's mountinfo file (or of /proc/swaps) as seen
+ * by the last scan, or one kernel mount with the statmount backend
+ */
+typedef struct _MountRecord MountRecord;
+struct _MountRecord {
+    /* line fingerprint, or the kernel's unique mount ID */
+    guint64 fingerprint;
+    /* a copy of the line, which the fingerprint only finds; NULL for
+     * kernel mounts */
+    gchar *line;
+    gsize line_len;
+    guint serial;
+    /* NULL for lines that are filtered out */
+    MountInfo *mount;
+};
+
+/* Where mount changes come from */
+typedef enum
+{
+    MOUNT_BACKEND_AUTO,         /* statmount if the kernel supports it */
+    MOUNT_BACKEND_MOUNTINFO,    /* poll and re-read /proc/<pid>/mountinfo */
+    MOUNT_BACKEND_STATMOUNT     /* fanotify mount events + statmount() */
+} MountBackend;
+
+typedef struct _MountNamespace MountNamespace;
+
+/* Called with the mounts that appeared and disappeared since the last
+ * scan, and the MountChange of those that were moved or changed in place
+ * (which are in neither of the other lists); the callee takes over all
+ * three lists, removed holds a reference to each mount.
+ */
+typedef void (*MountNamespaceChangedFunc) (MountNamespace *ns,
+                                           GList          *added,
+                                           GList          *removed,
+                                           GList          *changed,
+                                           gpointer        user_data);
+
+/* The mount table of one mount namespace, watched from the thread-default
+ * main context.  Each namespace keeps its own tables and watches, so
+ * namespaces can come and go without touching the others; the parser is
+ * shared between all of them.  Our own namespace also tracks the active
+ * swap partitions.
+ */
+struct _MountNamespace
+{
+    /* inode number of the namespace's ns/mnt file */
+    guint64 id;
+    /* 0 for our own namespace */
+    guint pid;
+    gchar *mountinfo_path;
+
+    MountBackend backend;
+    MountParser *parser;
+    MountNamespaceChangedFunc changed_func;
+    gpointer user_data;
+
+    GIOChannel *mounts_channel;
+    GSource *mounts_watch_source;
+
+    KernelMountSource *kernel_mounts;
+    GIOChannel *kernel_channel;
+    GSource *kernel_watch_source;
+
+    /* regular mountinfo files are watched with inotify instead */
+    GIOChannel *inotify_channel;
+    GSource *inotify_watch_source;
+
+    /* coalescing of mountinfo change bursts, disabled when min is 0 */
+    guint coalesce_min_ms;
+    guint coalesce_max_ms;
+    GSource *coalesce_source;
+    gint64 coalesce_first_event;
+
+    /* borrowed, NULL if nothing is counted */
+    MountMetrics *metrics;
+
+    /* only our own namespace watches /proc/swaps, which is global */
+    GIOChannel *swaps_channel;
+    GSource *swaps_watch_source;
+
+    /* the files as of the last scan, NULL before the first one */
+    gchar *mountinfo_contents;
+    gsize mountinfo_length;
+    gchar *swaps_contents;
+    gsize swaps_length;
+    guint scan_serial;
+    /* set of MountRecord, by line or by kernel mount ID */
+    GHashTable *records;
+    /* set of MountRecord, by swap file name */
+    GHashTable *swap_records;
+    /* set of the MountInfo of mounts and swaps, owns a reference to each */
+    GHashTable *mounts;
+    /* mountinfo ID -> MountInfo, with the mountinfo backend */
+    GHashTable *mounts_by_id;
+    /* dev_t -> MountDevEntry listing every mount of that device */
+    GHashTable *mounts_by_dev;
+};
+
+MountNamespace *mount_namespace_new             (guint                      pid,
+                                                 MountBackend               backend,
+                                                 MountParser               *parser,
+                                                 MountNamespaceChangedFunc  changed_func,
+                                                 gpointer                   user_data,
+                                                 GError                   **error);
+MountNamespace *mount_namespace_new_for_file    (const gchar               *mountinfo_path,
+                                                 MountParser               *parser,
+                                                 MountNamespaceChangedFunc  changed_func,
+                                                 gpointer                   user_data,
+                                                 GError                   **error);
+void            mount_namespace_free            (MountNamespace            *ns);
+void            mount_namespace_reload          (MountNamespace            *ns);
+guint64         mount_namespace_get_id          (MountNamespace            *ns);
+MountBackend    mount_namespace_get_backend     (MountNamespace            *ns);
+void            mount_namespace_set_coalescing  (MountNamespace            *ns,
+                                                 guint                      min_interval_ms,
+                                                 guint                      max_latency_ms);
+void            mount_namespace_set_metrics     (MountNamespace            *ns,
+                                                 MountMetrics              *metrics);
+void            mount_namespace_invalidate_sources (void);
+GList          *mount_namespace_get_mounts_for_dev (MountNamespace         *ns,
+                                                 dev_t                      dev);
+gboolean        mount_namespace_get_id_for_pid  (guint                      pid,
+                                                 guint64                   *out_id,
+                                                 GError                   **error);
+
+#endif
@@ -0,0 +1,237 @@
+#include "mountparser.h"
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#define MOUNT_PARSER_MIN_BUF_SIZE (64 * 1024)
+
+MountParser *
+mount_parser_new (void)
+{
+    return g_new0 (MountParser, 1);
+}
+
+void
+mount_parser_free (MountParser *parser)
+{
+    if (parser == NULL)
+        return;
+    g_free (parser->buf);
+    g_free (parser);
+}
+
+/* Reads the file behind fd from offset 0.  The buffer only ever grows, so
+ * once it has reached the size of the file no further allocation happens.
+ */
+gboolean
+mount_parser_read_fd (MountParser  *parser,
+                      int           fd,
+                      GError      **error)
+{
+    ssize_t n;
+
+    parser->len = 0;
+    parser->pos = 0;
+
+    for (;;)
+    {
+        /* keep room for a page-sized read plus the terminating NUL */
+        if (parser->buf_size - parser->len < 4096 + 1)
+        {
+            parser->buf_size = MAX (parser->buf_size * 2, MOUNT_PARSER_MIN_BUF_SIZE);
+            parser->buf = g_realloc (parser->buf, parser->buf_size);
+        }
+
+        n = pread (fd, parser->buf + parser->len,
+                   parser->buf_size - parser->len - 1, parser->len);
+        if (n < 0)
+        {
+            int errsv = errno;
+            if (errsv == EINTR)
+                continue;
+            g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+                         "%s", g_strerror (errsv));
+            parser->len = 0;
+            parser->buf[0] = '\0';
+            return FALSE;
+        }
+        if (n == 0)
+            break;
+        parser->len += n;
+    }
+
+    parser->buf[parser->len] = '\0';
+    return TRUE;
+}
+
+/* Returns the next line of the buffer, NUL-terminated in place */
+gboolean
+mount_parser_next_line (MountParser  *parser,
+                        gchar       **out_line,
+                        gsize        *out_len)
+{
+    gchar *line;
+    gchar *end;
+
+    if (parser->pos >= parser->len)
+        return FALSE;
+
+    line = parser->buf + parser->pos;
+    end = memchr (line, '\n', parser->len - parser->pos);
+    if (end != NULL)
+    {
+        *end = '\0';
+        parser->pos = end - parser->buf + 1;
+    }
+    else
+    {
+        end = parser->buf + parser->len;
+        parser->pos = parser->len;
+    }
+
+    *out_line = line;
+    *out_len = end - line;
+    return TRUE;
+}
+
+static gchar *
+next_field (gchar **cursor)
+{
+    gchar *start;
+    gchar *end;
+
+    start = *cursor;
+    if (start == NULL || *start == '\0')
+        return NULL;
+
+    end = strchr (start, ' ');
+    if (end != NULL)
+    {
+        *end = '\0';
+        *cursor = end + 1;
+    }
+    else
+    {
+        *cursor = NULL;
+    }
+
+    return start;
+}
+
+static gboolean
+parse_uint (const gchar *s,
+            guint       *out)
+{
+    guint v = 0;
+
+    if (s == NULL || *s == '\0')
+        return FALSE;
+
+    for (; *s != '\0'; s++)
+    {
+        if (*s < '0' || *s > '9')
+            return FALSE;
+        v = v * 10 + (*s - '0');
+    }
+
+    *out = v;
+    return TRUE;
+}
+
+/* Splits a mountinfo line into its fields by overwriting the separators.
+ * See Documentation/filesystems/proc.txt for the format:
+ *
+ *   36 35 98:0 /mnt1 /mnt2 rw,noatime master:1 - ext3 /dev/root rw,errors=continue
+ */
+gboolean
+mount_parser_parse_line (gchar            *line,
+                         MountParserEntry *entry)
+{
+    gchar *cursor;
+    gchar *field;
+    gchar *minor;
+
+    cursor = line;
+
+    if (!parse_uint (next_field (&cursor), &entry->mount_id))
+        return FALSE;
+    if (!parse_uint (next_field (&cursor), &entry->parent_id))
+        return FALSE;
+
+    field = next_field (&cursor);
+    if (field == NULL || (minor = strchr (field, ':')) == NULL)
+        return FALSE;
+    *minor++ = '\0';
+    if (!parse_uint (field, &entry->major) || !parse_uint (minor, &entry->minor))
+        return FALSE;
+
+    entry->root = next_field (&cursor);
+    entry->mount_point = next_field (&cursor);
+    entry->options = next_field (&cursor);
+    if (entry->options == NULL)
+        return FALSE;
+
+    /* the optional fields go up to the separator; they are put back
+     * together into one */
+    entry->optional_fields = "";
+    for (;;)
+    {
+        field = next_field (&cursor);
+        if (field == NULL)
+            return FALSE;
+        if (strcmp (field, "-") == 0)
+            break;
+        if (*entry->optional_fields == '\0')
+            entry->optional_fields = field;
+        else
+            field[-1] = ' ';
+    }
+
+    entry->fstype = next_field (&cursor);
+    entry->source = next_field (&cursor);
+    entry->super_options = next_field (&cursor);
+
+    return entry->super_options != NULL;
+}
+
+/* Decodes the octal escapes used by the kernel (\040 for space etc.) */
+gchar *
+mount_parser_unescape (const gchar *field)
+{
+    if (strchr (field, '\\') == NULL)
+        return g_strdup (field);
+    return g_strcompress (field);
+}
+
+/* Like mount_parser_unescape(), but decodes field where it is, which works
+ * because every escape is longer than the character it stands for.  Meant
+ * for the fields of a line in the parser's buffer, to keep from copying
+ * them.  Returns field.
+ */
+gchar *
+mount_parser_unescape_in_place (gchar *field)
+{
+    gchar *in;
+    gchar *out;
+
+    in = strchr (field, '\\');
+    if (in == NULL)
+        return field;
+
+    for (out = in; *in != '\0'; in++)
+    {
+        if (in[0] == '\\' &&
+            in[1] >= '0' && in[1] <= '3' &&
+            in[2] >= '0' && in[2] <= '7' &&
+            in[3] >= '0' && in[3] <= '7')
+        {
+            *out++ = ((in[1] - '0') << 6) | ((in[2] - '0') << 3) | (in[3] - '0');
+            in += 3;
+        }
+        else
+            *out++ = *in;
+    }
+    *out = '\0';
+
+    return field;
+}
@@ -0,0 +1,54 @@
+#ifndef __MOUNT_PARSER_H__
+#define __MOUNT_PARSER_H__
+#include <glib.h>
+
+/* Fields of one /proc/self/mountinfo line.  The strings point into the
+ * parser's buffer and are still encoded (a space is \040 and so on); use
+ * mount_parser_unescape() when a copy has to be kept, or decode them in the
+ * buffer with mount_parser_unescape_in_place().  They are only valid until
+ * the next mount_parser_read_fd().
+ */
+typedef struct _MountParserEntry MountParserEntry;
+struct _MountParserEntry
+{
+    guint mount_id;
+    guint parent_id;
+    guint major;
+    guint minor;
+    const gchar *root;
+    const gchar *mount_point;
+    const gchar *options;
+    /* the optional fields (shared:N, master:N, ...) separated by spaces,
+     * empty if there are none */
+    const gchar *optional_fields;
+    const gchar *fstype;
+    const gchar *source;
+    const gchar *super_options;
+};
+
+/* Reads a whole mountinfo-style file into a buffer that is kept and reused
+ * across reads, and hands out its lines without copying them.
+ */
+typedef struct _MountParser MountParser;
+struct _MountParser
+{
+    gchar *buf;
+    gsize buf_size;
+    gsize len;
+    gsize pos;
+};
+
+MountParser *mount_parser_new       (void);
+void         mount_parser_free      (MountParser      *parser);
+gboolean     mount_parser_read_fd   (MountParser      *parser,
+                                     int               fd,
+                                     GError          **error);
+gboolean     mount_parser_next_line (MountParser      *parser,
+                                     gchar           **out_line,
+                                     gsize            *out_len);
+gboolean     mount_parser_parse_line (gchar            *line,
+                                      MountParserEntry *entry);
+gchar       *mount_parser_unescape  (const gchar      *field);
+gchar       *mount_parser_unescape_in_place (gchar       *field);
+
+#endif
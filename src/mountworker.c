@@ -0,0 +1,468 @@
+#include "mountworker.h"
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <glib-unix.h>
+
+typedef struct
+{
+    MountWorker *worker;
+    guint pid;
+    const gchar *mountinfo_path;
+    MountBackend backend;
+    /* answered with an event instead of waking the caller */
+    gboolean async;
+    guint64 request_id;
+
+    guint64 ns_id;
+    MountBackend out_backend;
+    GError *error;
+
+    GMutex lock;
+    GCond cond;
+    gboolean done;
+} WatchCommand;
+
+typedef struct
+{
+    MountWorker *worker;
+    guint64 ns_id;
+    guint coalesce_min_ms;
+    guint coalesce_max_ms;
+} WorkerCommand;
+
+/* Runs func on the worker thread.  Unlike g_main_context_invoke() this
+ * never runs it right away in the caller, which could otherwise happen
+ * while the worker's context isn't owned yet.
+ */
+static void
+mount_worker_invoke (MountWorker    *worker,
+                     GSourceFunc     func,
+                     gpointer        data,
+                     GDestroyNotify  notify)
+{
+    GSource *source;
+
+    source = g_idle_source_new ();
+    g_source_set_callback (source, func, data, notify);
+    g_source_attach (source, worker->context);
+    g_source_unref (source);
+}
+
+void
+mount_worker_event_free (MountWorkerEvent *event)
+{
+    g_list_free_full (event->added, (GDestroyNotify) mount_info_unref);
+    g_list_free_full (event->removed, (GDestroyNotify) mount_info_unref);
+    g_list_free_full (event->changed, (GDestroyNotify) mount_change_free);
+    g_clear_error (&event->error);
+    g_slice_free (MountWorkerEvent, event);
+}
+
+/* Worker side: hands the event over and makes sure the owner wakes up */
+static void
+mount_worker_push (MountWorker      *worker,
+                   MountWorkerEvent *event)
+{
+    guint64 one = 1;
+
+    spsc_queue_push (worker->events, event);
+
+    if (g_atomic_int_compare_and_exchange (&worker->wakeup_pending, FALSE, TRUE) &&
+        write (worker->wakeup_fd, &one, sizeof one) < 0)
+        printf ("Error waking up the main thread: %m\n");
+}
+
+static void
+mount_worker_post (MountWorker          *worker,
+                   MountWorkerEventType  type,
+                   guint64               ns_id,
+                   GList                *added,
+                   GList                *removed,
+                   GList                *changed)
+{
+    MountWorkerEvent *event;
+
+    event = g_slice_new0 (MountWorkerEvent);
+    event->type = type;
+    event->ns_id = ns_id;
+    event->added = added;
+    event->removed = removed;
+    event->changed = changed;
+    mount_worker_push (worker, event);
+}
+
+/* Worker side: brings the table sizes, which can only be counted here, up
+ * to date and hands a copy of the metrics to the owner
+ */
+static void
+mount_worker_publish_metrics (MountWorker *worker)
+{
+    GHashTableIter iter;
+    MountNamespace *ns;
+    guint64 records;
+
+    records = 0;
+    g_hash_table_iter_init (&iter, worker->namespaces);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &ns))
+        records += g_hash_table_size (ns->records) + g_hash_table_size (ns->swap_records);
+    worker->metrics->records = records;
+
+    g_mutex_lock (&worker->metrics_lock);
+    *worker->published_metrics = *worker->metrics;
+    g_mutex_unlock (&worker->metrics_lock);
+}
+
+static void
+on_namespace_changed (MountNamespace *ns,
+                      GList          *added,
+                      GList          *removed,
+                      GList          *changed,
+                      gpointer        user_data)
+{
+    MountWorker *worker = user_data;
+
+    mount_worker_publish_metrics (worker);
+
+    /* scans that found nothing new don't bother the owner */
+    if (added == NULL && removed == NULL && changed == NULL)
+        return;
+
+    /* the namespace may drop them before the owner gets to them */
+    g_list_foreach (added, (GFunc) mount_info_ref, NULL);
+    mount_worker_post (worker, MOUNT_WORKER_EVENT_CHANGED, ns->id, added, removed, changed);
+}
+
+static void
+mount_worker_post_baseline (MountWorker    *worker,
+                            MountNamespace *ns,
+                            guint64         request_id)
+{
+    MountWorkerEvent *event;
+    GHashTableIter iter;
+    MountInfo *mount;
+
+    event = g_slice_new0 (MountWorkerEvent);
+    event->type = MOUNT_WORKER_EVENT_BASELINE;
+    event->ns_id = ns->id;
+    event->request_id = request_id;
+    g_hash_table_iter_init (&iter, ns->mounts);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &mount))
+        event->added = g_list_prepend (event->added, mount_info_ref (mount));
+
+    mount_worker_push (worker, event);
+    mount_worker_publish_metrics (worker);
+}
+
+static gboolean
+do_watch (gpointer user_data)
+{
+    WatchCommand *cmd = user_data;
+    MountWorker *worker = cmd->worker;
+    MountNamespace *ns;
+    MountNamespace *known;
+
+    if (cmd->mountinfo_path != NULL)
+        ns = mount_namespace_new_for_file (cmd->mountinfo_path, worker->parser,
+                                           on_namespace_changed, worker, &cmd->error);
+    else
+        ns = mount_namespace_new (cmd->pid, cmd->backend, worker->parser,
+                                  on_namespace_changed, worker, &cmd->error);
+
+    if (ns != NULL)
+    {
+        known = g_hash_table_lookup (worker->namespaces, &ns->id);
+        if (known != NULL)
+        {
+            mount_namespace_free (ns);
+            ns = known;
+        }
+        else
+        {
+            mount_namespace_set_coalescing (ns, worker->coalesce_min_ms, worker->coalesce_max_ms);
+            mount_namespace_set_metrics (ns, worker->metrics);
+            g_hash_table_insert (worker->namespaces, &ns->id, ns);
+        }
+        /* goes into the queue before the owner is told the result */
+        mount_worker_post_baseline (worker, ns, cmd->request_id);
+        cmd->ns_id = ns->id;
+        cmd->out_backend = mount_namespace_get_backend (ns);
+    }
+
+    if (cmd->async)
+    {
+        if (cmd->error != NULL)
+        {
+            MountWorkerEvent *event;
+
+            event = g_slice_new0 (MountWorkerEvent);
+            event->type = MOUNT_WORKER_EVENT_WATCH_FAILED;
+            event->request_id = cmd->request_id;
+            event->error = cmd->error;
+            cmd->error = NULL;
+            mount_worker_push (worker, event);
+        }
+        return G_SOURCE_REMOVE;
+    }
+
+    g_mutex_lock (&cmd->lock);
+    cmd->done = TRUE;
+    g_cond_signal (&cmd->cond);
+    g_mutex_unlock (&cmd->lock);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+do_unwatch (gpointer user_data)
+{
+    WorkerCommand *cmd = user_data;
+
+    g_hash_table_remove (cmd->worker->namespaces, &cmd->ns_id);
+    mount_worker_publish_metrics (cmd->worker);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+do_set_coalescing (gpointer user_data)
+{
+    WorkerCommand *cmd = user_data;
+    MountWorker *worker = cmd->worker;
+    GHashTableIter iter;
+    MountNamespace *ns;
+
+    worker->coalesce_min_ms = cmd->coalesce_min_ms;
+    worker->coalesce_max_ms = cmd->coalesce_max_ms;
+
+    g_hash_table_iter_init (&iter, worker->namespaces);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &ns))
+        mount_namespace_set_coalescing (ns, worker->coalesce_min_ms, worker->coalesce_max_ms);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+do_quit (gpointer user_data)
+{
+    MountWorker *worker = user_data;
+
+    g_main_loop_quit (worker->loop);
+    return G_SOURCE_REMOVE;
+}
+
+static gpointer
+mount_worker_thread (gpointer user_data)
+{
+    MountWorker *worker = user_data;
+
+    g_main_context_push_thread_default (worker->context);
+    g_main_loop_run (worker->loop);
+    /* their sources are attached to the worker's context */
+    g_hash_table_remove_all (worker->namespaces);
+    g_main_context_pop_thread_default (worker->context);
+
+    return NULL;
+}
+
+static gboolean
+on_wakeup (gint         fd,
+           GIOCondition condition,
+           gpointer     user_data)
+{
+    MountWorker *worker = user_data;
+    guint64 count;
+
+    if (read (fd, &count, sizeof count) < 0 && errno != EAGAIN)
+        printf ("Error reading the worker's wakeup counter: %m\n");
+    mount_worker_dispatch (worker);
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* Starts the worker thread.  event_func is called from the thread-default
+ * main context of the caller, which is the only thread that may use the
+ * worker.
+ */
+MountWorker *
+mount_worker_new (MountWorkerEventFunc  event_func,
+                  gpointer              user_data)
+{
+    MountWorker *worker;
+
+    worker = g_new0 (MountWorker, 1);
+    worker->metrics = mount_metrics_new ();
+    worker->published_metrics = mount_metrics_new ();
+    g_mutex_init (&worker->metrics_lock);
+    worker->event_func = event_func;
+    worker->user_data = user_data;
+    worker->parser = mount_parser_new ();
+    worker->namespaces = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                                NULL, (GDestroyNotify) mount_namespace_free);
+    worker->events = spsc_queue_new ();
+
+    worker->wakeup_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (worker->wakeup_fd < 0)
+        g_error ("Error creating the worker's eventfd: %m");
+    worker->wakeup_source = g_unix_fd_source_new (worker->wakeup_fd, G_IO_IN);
+    g_source_set_callback (worker->wakeup_source, (GSourceFunc) on_wakeup, worker, NULL);
+    g_source_attach (worker->wakeup_source, g_main_context_get_thread_default ());
+
+    worker->context = g_main_context_new ();
+    worker->loop = g_main_loop_new (worker->context, FALSE);
+    worker->thread = g_thread_new ("mount-worker", mount_worker_thread, worker);
+
+    return worker;
+}
+
+/* Stops the thread and drops the namespaces and any undelivered events */
+void
+mount_worker_free (MountWorker *worker)
+{
+    MountWorkerEvent *event;
+
+    if (worker == NULL)
+        return;
+
+    mount_worker_invoke (worker, do_quit, worker, NULL);
+    g_thread_join (worker->thread);
+
+    g_source_destroy (worker->wakeup_source);
+    g_source_unref (worker->wakeup_source);
+    close (worker->wakeup_fd);
+    while (spsc_queue_pop (worker->events, (gpointer *) &event))
+        mount_worker_event_free (event);
+    spsc_queue_free (worker->events);
+
+    g_hash_table_unref (worker->namespaces);
+    mount_parser_free (worker->parser);
+    mount_metrics_free (worker->metrics);
+    mount_metrics_free (worker->published_metrics);
+    g_mutex_clear (&worker->metrics_lock);
+    g_main_loop_unref (worker->loop);
+    g_main_context_unref (worker->context);
+    g_free (worker);
+}
+
+/* Starts watching the mount namespace of pid (0 for our own, which may be
+ * read from mountinfo_path instead, see mount_namespace_new_for_file()),
+ * waiting for the worker to load it.  The namespace's current mounts come
+ * as a MOUNT_WORKER_EVENT_BASELINE event, which has already been queued
+ * when this returns.  Watching a namespace twice just queues that again.
+ */
+gboolean
+mount_worker_watch_namespace (MountWorker   *worker,
+                              guint          pid,
+                              const gchar   *mountinfo_path,
+                              MountBackend   backend,
+                              guint64       *out_ns_id,
+                              MountBackend  *out_backend,
+                              GError       **error)
+{
+    WatchCommand cmd = { 0 };
+
+    cmd.worker = worker;
+    cmd.pid = pid;
+    cmd.mountinfo_path = mountinfo_path;
+    cmd.backend = backend;
+    g_mutex_init (&cmd.lock);
+    g_cond_init (&cmd.cond);
+
+    mount_worker_invoke (worker, do_watch, &cmd, NULL);
+
+    g_mutex_lock (&cmd.lock);
+    while (!cmd.done)
+        g_cond_wait (&cmd.cond, &cmd.lock);
+    g_mutex_unlock (&cmd.lock);
+    g_mutex_clear (&cmd.lock);
+    g_cond_clear (&cmd.cond);
+
+    if (cmd.error != NULL)
+    {
+        g_propagate_error (error, cmd.error);
+        return FALSE;
+    }
+
+    *out_ns_id = cmd.ns_id;
+    if (out_backend != NULL)
+        *out_backend = cmd.out_backend;
+    return TRUE;
+}
+
+/* Like mount_worker_watch_namespace(), but returns right away.  The
+ * answer is the BASELINE event, or a WATCH_FAILED one, that carries
+ * request_id, which should not be 0.
+ */
+void
+mount_worker_watch_namespace_async (MountWorker  *worker,
+                                    guint         pid,
+                                    MountBackend  backend,
+                                    guint64       request_id)
+{
+    WatchCommand *cmd;
+
+    cmd = g_new0 (WatchCommand, 1);
+    cmd->worker = worker;
+    cmd->pid = pid;
+    cmd->backend = backend;
+    cmd->async = TRUE;
+    cmd->request_id = request_id;
+    mount_worker_invoke (worker, do_watch, cmd, g_free);
+}
+
+/* Stops watching a namespace; events of it may still be queued */
+void
+mount_worker_unwatch_namespace (MountWorker *worker,
+                                guint64      ns_id)
+{
+    WorkerCommand *cmd;
+
+    cmd = g_new0 (WorkerCommand, 1);
+    cmd->worker = worker;
+    cmd->ns_id = ns_id;
+    mount_worker_invoke (worker, do_unwatch, cmd, g_free);
+}
+
+/* See mount_namespace_set_coalescing(); applies to every namespace,
+ * including those watched later
+ */
+void
+mount_worker_set_coalescing (MountWorker *worker,
+                             guint        min_interval_ms,
+                             guint        max_latency_ms)
+{
+    WorkerCommand *cmd;
+
+    cmd = g_new0 (WorkerCommand, 1);
+    cmd->worker = worker;
+    cmd->coalesce_min_ms = min_interval_ms;
+    cmd->coalesce_max_ms = max_latency_ms;
+    mount_worker_invoke (worker, do_set_coalescing, cmd, g_free);
+}
+
+/* Owner side: passes every queued event to event_func.  Runs on its own
+ * when the worker posts; call it directly to catch up right away.
+ */
+void
+mount_worker_dispatch (MountWorker *worker)
+{
+    MountWorkerEvent *event;
+
+    /* cleared first, so anything posted from now on wakes us again */
+    g_atomic_int_set (&worker->wakeup_pending, FALSE);
+    while (spsc_queue_pop (worker->events, (gpointer *) &event))
+        worker->event_func (worker, event, worker->user_data);
+}
+
+/* Owner side: copies what the worker counted, as of its last scan, into
+ * metrics
+ */
+void
+mount_worker_collect_metrics (MountWorker  *worker,
+                              MountMetrics *metrics)
+{
+    g_mutex_lock (&worker->metrics_lock);
+    mount_metrics_copy_scans (metrics, worker->published_metrics);
+    g_mutex_unlock (&worker->metrics_lock);
+}
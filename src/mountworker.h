@@ -0,0 +1,103 @@
+#ifndef __MOUNT_WORKER_H__
+#define __MOUNT_WORKER_H__
+#include "mountnamespace.h"
+#include "spscqueue.h"
+
+typedef enum
+{
+    /* the mounts a namespace had when it started being watched, not to be
+     * announced */
+    MOUNT_WORKER_EVENT_BASELINE,
+    /* the result of a scan, as passed to MountNamespaceChangedFunc */
+    MOUNT_WORKER_EVENT_CHANGED,
+    /* a namespace asked for with mount_worker_watch_namespace_async()
+     * couldn't be read; error says why */
+    MOUNT_WORKER_EVENT_WATCH_FAILED
+} MountWorkerEventType;
+
+/* Handed from the worker to the owner's thread.  added and removed hold
+ * a reference to each mount, changed is a list of MountChange.
+ */
+typedef struct _MountWorkerEvent MountWorkerEvent;
+struct _MountWorkerEvent
+{
+    MountWorkerEventType type;
+    guint64 ns_id;
+    GList *added;
+    GList *removed;
+    GList *changed;
+    /* the request_id of mount_worker_watch_namespace_async() a BASELINE or
+     * WATCH_FAILED event answers, 0 otherwise */
+    guint64 request_id;
+    GError *error;
+};
+
+typedef struct _MountWorker MountWorker;
+
+/* Called in the owner's main context; the callee takes over the event */
+typedef void (*MountWorkerEventFunc) (MountWorker      *worker,
+                                      MountWorkerEvent *event,
+                                      gpointer          user_data);
+
+/* Watches, reads and diffs the mount namespaces on a thread of its own, so
+ * that big reloads don't hold up the D-Bus thread and bus traffic doesn't
+ * delay change detection.  The namespaces and the parser live on the
+ * worker thread only.  Their changes come back through a lock-free
+ * single-producer/single-consumer queue, and an eventfd wakes the owner's
+ * main context when it may be asleep.
+ */
+struct _MountWorker
+{
+    GThread *thread;
+    GMainContext *context;
+    GMainLoop *loop;
+
+    /* worker thread only */
+    MountParser *parser;
+    /* namespace ID -> MountNamespace */
+    GHashTable *namespaces;
+    guint coalesce_min_ms;
+    guint coalesce_max_ms;
+    /* what the namespaces count */
+    MountMetrics *metrics;
+
+    /* a copy of metrics as of the last scan, for the owner */
+    GMutex metrics_lock;
+    MountMetrics *published_metrics;
+
+    /* worker -> owner */
+    SpscQueue *events;
+    int wakeup_fd;
+    /* set by the worker once it signalled wakeup_fd, cleared by the owner
+     * before it drains the queue */
+    gint wakeup_pending;
+    GSource *wakeup_source;
+    MountWorkerEventFunc event_func;
+    gpointer user_data;
+};
+
+MountWorker *mount_worker_new             (MountWorkerEventFunc   event_func,
+                                           gpointer               user_data);
+void         mount_worker_free            (MountWorker           *worker);
+gboolean     mount_worker_watch_namespace (MountWorker           *worker,
+                                           guint                  pid,
+                                           const gchar           *mountinfo_path,
+                                           MountBackend           backend,
+                                           guint64               *out_ns_id,
+                                           MountBackend          *out_backend,
+                                           GError               **error);
+void         mount_worker_watch_namespace_async (MountWorker     *worker,
+                                           guint                  pid,
+                                           MountBackend           backend,
+                                           guint64                request_id);
+void         mount_worker_unwatch_namespace (MountWorker         *worker,
+                                           guint64                ns_id);
+void         mount_worker_set_coalescing  (MountWorker           *worker,
+                                           guint                  min_interval_ms,
+                                           guint                  max_latency_ms);
+void         mount_worker_dispatch        (MountWorker           *worker);
+void         mount_worker_collect_metrics (MountWorker           *worker,
+                                           MountMetrics          *metrics);
+void         mount_worker_event_free      (MountWorkerEvent      *event);
+
+#endif
@@ -0,0 +1,177 @@
+#include "pathindex.h"
+#include <string.h>
+
+static PathIndexNode *
+path_index_node_new (PathIndexNode *parent,
+                     const gchar   *name)
+{
+    PathIndexNode *node;
+
+    node = g_new0 (PathIndexNode, 1);
+    node->parent = parent;
+    node->name = g_strdup (name);
+
+    return node;
+}
+
+static void
+path_index_node_free (PathIndexNode *node)
+{
+    if (node->children != NULL)
+        g_hash_table_unref (node->children);
+    g_list_free (node->items);
+    g_free (node->name);
+    g_free (node);
+}
+
+PathIndex *
+path_index_new (void)
+{
+    PathIndex *index;
+
+    index = g_new0 (PathIndex, 1);
+    index->root = path_index_node_new (NULL, NULL);
+
+    return index;
+}
+
+void
+path_index_free (PathIndex *index)
+{
+    if (index == NULL)
+        return;
+
+    path_index_node_free (index->root);
+    g_free (index);
+}
+
+/* Returns the node of path, NULL if there is none and create isn't set.
+ * Repeated and trailing slashes don't count.
+ */
+static PathIndexNode *
+path_index_find (PathIndex   *index,
+                 const gchar *path,
+                 gboolean     create)
+{
+    PathIndexNode *node;
+    PathIndexNode *child;
+    gchar *copy;
+    gchar *name;
+    gchar *next;
+
+    node = index->root;
+    copy = g_strdup (path);
+    for (name = copy; node != NULL && name != NULL; name = next)
+    {
+        while (*name == '/')
+            name++;
+        if (*name == '\0')
+            break;
+        next = strchr (name, '/');
+        if (next != NULL)
+            *next++ = '\0';
+
+        child = node->children != NULL ? g_hash_table_lookup (node->children, name) : NULL;
+        if (child == NULL && create)
+        {
+            child = path_index_node_new (node, name);
+            if (node->children == NULL)
+                node->children = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                        NULL, (GDestroyNotify) path_index_node_free);
+            g_hash_table_insert (node->children, child->name, child);
+        }
+        node = child;
+    }
+    g_free (copy);
+
+    return node;
+}
+
+void
+path_index_insert (PathIndex   *index,
+                   const gchar *path,
+                   gpointer     item)
+{
+    PathIndexNode *node;
+
+    node = path_index_find (index, path, TRUE);
+    node->items = g_list_prepend (node->items, item);
+    index->n_items++;
+}
+
+/* Drops item from path, and the nodes that lead to nothing any more */
+void
+path_index_remove (PathIndex   *index,
+                   const gchar *path,
+                   gpointer     item)
+{
+    PathIndexNode *node;
+    PathIndexNode *parent;
+    GList *link;
+
+    node = path_index_find (index, path, FALSE);
+    if (node == NULL || (link = g_list_find (node->items, item)) == NULL)
+        return;
+    node->items = g_list_delete_link (node->items, link);
+    index->n_items--;
+
+    while (node != index->root && node->items == NULL && node->children == NULL)
+    {
+        parent = node->parent;
+        g_hash_table_remove (parent->children, node->name);
+        if (g_hash_table_size (parent->children) == 0)
+        {
+            g_hash_table_unref (parent->children);
+            parent->children = NULL;
+        }
+        node = parent;
+    }
+}
+
+/* The items at exactly path; free the list with g_list_free() */
+GList *
+path_index_lookup (PathIndex   *index,
+                   const gchar *path)
+{
+    PathIndexNode *node;
+
+    node = path_index_find (index, path, FALSE);
+    return node != NULL ? g_list_copy (node->items) : NULL;
+}
+
+static void
+path_index_collect (PathIndexNode  *node,
+                    GList         **items)
+{
+    GHashTableIter iter;
+    PathIndexNode *child;
+    GList *l;
+
+    for (l = node->items; l != NULL; l = l->next)
+        *items = g_list_prepend (*items, l->data);
+
+    if (node->children == NULL)
+        return;
+    g_hash_table_iter_init (&iter, node->children);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &child))
+        path_index_collect (child, items);
+}
+
+/* The items at path or below it, in no particular order; free the list
+ * with g_list_free()
+ */
+GList *
+path_index_lookup_under (PathIndex   *index,
+                         const gchar *path)
+{
+    PathIndexNode *node;
+    GList *items;
+
+    node = path_index_find (index, path, FALSE);
+    if (node == NULL)
+        return NULL;
+
+    items = NULL;
+    path_index_collect (node, &items);
+    return items;
+}
@@ -0,0 +1,42 @@
+#ifndef __PATH_INDEX_H__
+#define __PATH_INDEX_H__
+#include <glib.h>
+
+typedef struct _PathIndexNode PathIndexNode;
+struct _PathIndexNode
+{
+    PathIndexNode *parent;
+    /* one path component, NULL for the root */
+    gchar *name;
+    /* component -> PathIndexNode, NULL while there are none */
+    GHashTable *children;
+    /* the items at exactly this path */
+    GList *items;
+};
+
+/* Items (mounts) by absolute path, as a tree of path components.  Every
+ * node has an item at or below it, nodes are dropped as soon as that is
+ * no longer the case, so everything at or below a path is found by
+ * visiting only the nodes leading to the items returned.
+ */
+typedef struct _PathIndex PathIndex;
+struct _PathIndex
+{
+    PathIndexNode *root;
+    guint n_items;
+};
+
+PathIndex *path_index_new          (void);
+void       path_index_free         (PathIndex   *index);
+void       path_index_insert       (PathIndex   *index,
+                                    const gchar *path,
+                                    gpointer     item);
+void       path_index_remove       (PathIndex   *index,
+                                    const gchar *path,
+                                    gpointer     item);
+GList     *path_index_lookup       (PathIndex   *index,
+                                    const gchar *path);
+GList     *path_index_lookup_under (PathIndex   *index,
+                                    const gchar *path);
+
+#endif
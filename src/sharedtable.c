@@ -0,0 +1,263 @@
+#include "sharedtable.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <glib/gstdio.h>
+
+/* Not every libc header ships these without _GNU_SOURCE */
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC         0x0001U
+#define MFD_ALLOW_SEALING   0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS         1033
+#define F_SEAL_SHRINK       0x0002
+#endif
+#ifndef F_SEAL_GROW
+#define F_SEAL_GROW         0x0004
+#endif
+#ifndef F_SEAL_FUTURE_WRITE
+#define F_SEAL_FUTURE_WRITE 0x0010
+#endif
+
+/* Size of the first region; it doubles whenever the table outgrows it */
+#define SHARED_TABLE_INITIAL_SIZE (64 * 1024)
+
+/* Maps a new memfd of size bytes holding an empty table.  Readers map it
+ * as it is, so it is sealed against shrinking, which would make them
+ * fault.  Once our own mapping exists it is also sealed against growing
+ * and against new writers, so a reader can't reopen its descriptor
+ * writable through /proc; a bigger table goes into a new memfd.
+ */
+static gboolean
+shared_table_map (SharedTable  *table,
+                  gsize         size,
+                  GError      **error)
+{
+    SharedTableHeader *header;
+    gchar *data;
+    int errsv;
+    int fd;
+
+    fd = syscall (SYS_memfd_create, "mountmonitor-table", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0)
+    {
+        errsv = errno;
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+                     "Error creating the shared table: %s", g_strerror (errsv));
+        return FALSE;
+    }
+
+    data = MAP_FAILED;
+    if (ftruncate (fd, size) != 0 ||
+        fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK) != 0 ||
+        (data = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED ||
+        fcntl (fd, F_ADD_SEALS, F_SEAL_GROW | F_SEAL_FUTURE_WRITE) != 0)
+    {
+        errsv = errno;
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+                     "Error setting up the shared table: %s", g_strerror (errsv));
+        if (data != MAP_FAILED)
+            munmap (data, size);
+        close (fd);
+        return FALSE;
+    }
+
+    /* a fresh memfd is zeroed, which is an empty string table as well */
+    header = (SharedTableHeader *) data;
+    header->magic = SHARED_TABLE_MAGIC;
+    header->version = SHARED_TABLE_VERSION;
+    header->size = size;
+    header->mounts_offset = sizeof *header;
+    header->strings_offset = sizeof *header;
+    header->strings_len = 1;
+
+    table->fd = fd;
+    table->data = data;
+    table->size = size;
+
+    return TRUE;
+}
+
+static void
+shared_table_unmap (SharedTable *table)
+{
+    if (table->data == NULL)
+        return;
+
+    munmap (table->data, table->size);
+    close (table->fd);
+    table->data = NULL;
+    table->fd = -1;
+}
+
+SharedTable *
+shared_table_new (GError **error)
+{
+    SharedTable *table;
+
+    table = g_new0 (SharedTable, 1);
+    table->fd = -1;
+    if (!shared_table_map (table, SHARED_TABLE_INITIAL_SIZE, error))
+    {
+        g_free (table);
+        return NULL;
+    }
+
+    table->mounts = g_array_new (FALSE, TRUE, sizeof (SharedTableMount));
+    table->strings = g_byte_array_new ();
+    table->offsets = g_hash_table_new (g_str_hash, g_str_equal);
+
+    return table;
+}
+
+void
+shared_table_free (SharedTable *table)
+{
+    if (table == NULL)
+        return;
+
+    shared_table_unmap (table);
+    g_hash_table_unref (table->offsets);
+    g_byte_array_unref (table->strings);
+    g_array_unref (table->mounts);
+    g_free (table);
+}
+
+/* Starts building the next version of the table */
+void
+shared_table_begin (SharedTable *table)
+{
+    g_array_set_size (table->mounts, 0);
+    g_byte_array_set_size (table->strings, 0);
+    g_hash_table_remove_all (table->offsets);
+    g_byte_array_append (table->strings, (const guint8 *) "", 1);
+}
+
+/* Returns the offset of str, adding it once; NULL is the empty string */
+static guint32
+shared_table_add_string (SharedTable *table,
+                         const gchar *str)
+{
+    gpointer offset;
+
+    if (str == NULL || *str == '\0')
+        return 0;
+
+    if (g_hash_table_lookup_extended (table->offsets, str, NULL, &offset))
+        return GPOINTER_TO_UINT (offset);
+
+    offset = GUINT_TO_POINTER (table->strings->len);
+    g_byte_array_append (table->strings, (const guint8 *) str, strlen (str) + 1);
+    g_hash_table_insert (table->offsets, (gpointer) str, offset);
+
+    return GPOINTER_TO_UINT (offset);
+}
+
+/* Adds a mount to the table being built.  The strings are borrowed until
+ * shared_table_publish().
+ */
+void
+shared_table_add (SharedTable          *table,
+                  guint64               ns_id,
+                  guint64               dev,
+                  guint64               mount_id,
+                  guint64               parent_id,
+                  SharedTableMountType  type,
+                  const gchar          *path,
+                  const gchar          *fstype,
+                  const gchar          *source,
+                  const gchar          *options,
+                  const gchar          *uuid,
+                  const gchar          *serial,
+                  const gchar          *vendor,
+                  const gchar          *model)
+{
+    SharedTableMount mount;
+
+    memset (&mount, 0, sizeof mount);
+    mount.ns_id = ns_id;
+    mount.dev = dev;
+    mount.mount_id = mount_id;
+    mount.parent_id = parent_id;
+    mount.type = type;
+    mount.path = shared_table_add_string (table, path);
+    mount.fstype = shared_table_add_string (table, fstype);
+    mount.source = shared_table_add_string (table, source);
+    mount.options = shared_table_add_string (table, options);
+    mount.uuid = shared_table_add_string (table, uuid);
+    mount.serial = shared_table_add_string (table, serial);
+    mount.vendor = shared_table_add_string (table, vendor);
+    mount.model = shared_table_add_string (table, model);
+    g_array_append_val (table->mounts, mount);
+}
+
+/* Replaces the published table with the one built since
+ * shared_table_begin().  If it doesn't fit, it goes into a new region and
+ * the old one is marked superseded.
+ */
+gboolean
+shared_table_publish (SharedTable  *table,
+                      guint64       generation,
+                      GError      **error)
+{
+    SharedTableHeader *header;
+    SharedTable old;
+    gsize mounts_len;
+    gsize needed;
+    gsize size;
+
+    mounts_len = table->mounts->len * sizeof (SharedTableMount);
+    needed = sizeof (SharedTableHeader) + mounts_len + table->strings->len;
+    if (needed > table->size)
+    {
+        for (size = table->size * 2; size < needed; size *= 2)
+            ;
+        old = *table;
+        if (!shared_table_map (table, size, error))
+            return FALSE;
+
+        header = (SharedTableHeader *) old.data;
+        g_atomic_int_inc (&header->sequence);
+        header->superseded = TRUE;
+        g_atomic_int_inc (&header->sequence);
+        shared_table_unmap (&old);
+    }
+
+    header = (SharedTableHeader *) table->data;
+    /* odd: readers that overlap with this start over */
+    g_atomic_int_inc (&header->sequence);
+    header->generation = generation;
+    header->n_mounts = table->mounts->len;
+    header->mounts_offset = sizeof *header;
+    header->strings_offset = sizeof *header + mounts_len;
+    header->strings_len = table->strings->len;
+    memcpy (table->data + header->mounts_offset, table->mounts->data, mounts_len);
+    memcpy (table->data + header->strings_offset, table->strings->data, table->strings->len);
+    g_atomic_int_inc (&header->sequence);
+
+    return TRUE;
+}
+
+/* Returns a new read-only descriptor of the region, for a reader */
+int
+shared_table_open_fd (SharedTable  *table,
+                      GError      **error)
+{
+    gchar *path;
+    int errsv;
+    int fd;
+
+    path = g_strdup_printf ("/proc/self/fd/%d", table->fd);
+    fd = g_open (path, O_RDONLY | O_CLOEXEC, 0);
+    errsv = errno;
+    g_free (path);
+    if (fd < 0)
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+                     "Error opening the shared table: %s", g_strerror (errsv));
+
+    return fd;
+}
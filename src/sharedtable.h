@@ -0,0 +1,100 @@
+#ifndef __SHARED_TABLE_H__
+#define __SHARED_TABLE_H__
+#include <glib.h>
+
+/* The layout of the shared mount table is used by the daemon and by
+ * libmountmonitor, so it has nothing but fixed-size fields in host byte
+ * order.  The region starts with the header, followed by the mounts and
+ * then the strings, which the mounts refer to by offset; each string ends
+ * with a NUL, offset 0 is the empty string.
+ *
+ * The header's sequence is a seqlock: the daemon makes it odd before it
+ * changes anything and even again once it is done.  A reader copies what
+ * it needs while the sequence is even and starts over if the sequence
+ * changed meanwhile.  Once the table has outgrown the region the daemon
+ * moves to a new one and sets superseded in the old one; readers then
+ * ask for the new one with OpenSharedTable.
+ */
+#define SHARED_TABLE_MAGIC 0x54534d4d   /* "MMST" */
+#define SHARED_TABLE_VERSION 1
+
+typedef struct _SharedTableHeader SharedTableHeader;
+struct _SharedTableHeader
+{
+    guint32 magic;
+    guint32 version;
+    gint sequence;
+    guint32 superseded;
+    /* of the whole region, which never shrinks */
+    guint64 size;
+    /* of the last change included, as in GetMounts */
+    guint64 generation;
+    guint32 n_mounts;
+    guint32 mounts_offset;
+    guint32 strings_offset;
+    guint32 strings_len;
+};
+
+typedef enum
+{
+    SHARED_TABLE_FILESYSTEM,
+    SHARED_TABLE_SWAP
+} SharedTableMountType;
+
+typedef struct _SharedTableMount SharedTableMount;
+struct _SharedTableMount
+{
+    guint64 ns_id;
+    guint64 dev;
+    guint64 mount_id;
+    guint64 parent_id;
+    guint32 type;
+    guint32 path;
+    guint32 fstype;
+    guint32 source;
+    guint32 options;
+    guint32 uuid;
+    guint32 serial;
+    guint32 vendor;
+    guint32 model;
+    guint32 padding;
+};
+
+/* Daemon side: the memfd the table is published in */
+typedef struct _SharedTable SharedTable;
+struct _SharedTable
+{
+    int fd;
+    gchar *data;
+    gsize size;
+
+    /* the table being built by shared_table_add() */
+    GArray *mounts;
+    GByteArray *strings;
+    GHashTable *offsets;
+};
+
+SharedTable *shared_table_new     (GError           **error);
+void         shared_table_free    (SharedTable       *table);
+void         shared_table_begin   (SharedTable       *table);
+void         shared_table_add     (SharedTable       *table,
+                                   guint64            ns_id,
+                                   guint64            dev,
+                                   guint64            mount_id,
+                                   guint64            parent_id,
+                                   SharedTableMountType type,
+                                   const gchar       *path,
+                                   const gchar       *fstype,
+                                   const gchar       *source,
+                                   const gchar       *options,
+                                   const gchar       *uuid,
+                                   const gchar       *serial,
+                                   const gchar       *vendor,
+                                   const gchar       *model);
+gboolean     shared_table_publish (SharedTable       *table,
+                                   guint64            generation,
+                                   GError           **error);
+int          shared_table_open_fd (SharedTable       *table,
+                                   GError           **error);
+
+#endif
@@ -0,0 +1,247 @@
+#include "snapshot.h"
+#include <string.h>
+
+#define BOOT_ID_PATH "/proc/sys/kernel/random/boot_id"
+
+/* Fills boot_id, zero-padded; an unreadable boot ID is all zeroes, which
+ * matches no snapshot */
+static void
+read_boot_id (gchar boot_id[40])
+{
+    gchar *contents;
+
+    memset (boot_id, 0, 40);
+    if (!g_file_get_contents (BOOT_ID_PATH, &contents, NULL, NULL))
+        return;
+    g_strstrip (contents);
+    strncpy (boot_id, contents, 39);
+    g_free (contents);
+}
+
+/* Returns the offset of str in the string table, adding it once */
+static guint32
+add_string (GByteArray  *strings,
+            GHashTable  *offsets,
+            const gchar *str)
+{
+    gpointer offset;
+
+    if (str == NULL)
+        return MOUNT_SNAPSHOT_NO_STRING;
+
+    if (g_hash_table_lookup_extended (offsets, str, NULL, &offset))
+        return GPOINTER_TO_UINT (offset);
+
+    offset = GUINT_TO_POINTER (strings->len);
+    g_byte_array_append (strings, (const guint8 *) str, strlen (str) + 1);
+    g_hash_table_insert (offsets, (gpointer) str, offset);
+
+    return GPOINTER_TO_UINT (offset);
+}
+
+/* Writes the MountSnapshotEntry list entries of namespace ns_id to path,
+ * replacing it atomically.  Identities shared by several mounts are
+ * written once.
+ */
+gboolean
+mount_snapshot_save (const gchar  *path,
+                     guint64       ns_id,
+                     GList        *entries,
+                     GError      **error)
+{
+    MountSnapshotHeader header;
+    GArray *identities;
+    GArray *mounts;
+    GByteArray *strings;
+    GHashTable *offsets;
+    GHashTable *identity_index;
+    GByteArray *data;
+    gpointer index;
+    gboolean ret;
+    GList *l;
+
+    identities = g_array_new (FALSE, TRUE, sizeof (MountSnapshotIdentity));
+    mounts = g_array_new (FALSE, TRUE, sizeof (MountSnapshotMount));
+    strings = g_byte_array_new ();
+    offsets = g_hash_table_new (g_str_hash, g_str_equal);
+    identity_index = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    for (l = entries; l != NULL; l = l->next)
+    {
+        MountSnapshotEntry *entry = l->data;
+        MountSnapshotMount mount;
+
+        if (!g_hash_table_lookup_extended (identity_index, entry->identity, NULL, &index))
+        {
+            MountSnapshotIdentity identity;
+
+            identity.dev = entry->identity->dev;
+            identity.uuid = add_string (strings, offsets, entry->identity->uuid);
+            identity.drive_path = add_string (strings, offsets, entry->identity->drive_path);
+            identity.serial = add_string (strings, offsets, entry->identity->serial);
+            identity.vendor = add_string (strings, offsets, entry->identity->vendor);
+            identity.model = add_string (strings, offsets, entry->identity->model);
+            identity.complete = entry->identity->complete;
+            index = GUINT_TO_POINTER (identities->len);
+            g_array_append_val (identities, identity);
+            g_hash_table_insert (identity_index, entry->identity, index);
+        }
+
+        memset (&mount, 0, sizeof mount);
+        mount.dev = entry->dev;
+        mount.mount_id = entry->mount_id;
+        mount.path = add_string (strings, offsets, entry->path);
+        mount.identity = GPOINTER_TO_UINT (index);
+        mount.type = entry->type;
+        g_array_append_val (mounts, mount);
+    }
+    /* so that every offset is followed by a NUL within the table */
+    g_byte_array_append (strings, (const guint8 *) "", 1);
+
+    memset (&header, 0, sizeof header);
+    memcpy (header.magic, MOUNT_SNAPSHOT_MAGIC, sizeof header.magic);
+    header.version = MOUNT_SNAPSHOT_VERSION;
+    header.n_identities = identities->len;
+    header.n_mounts = mounts->len;
+    header.strings_len = strings->len;
+    header.ns_id = ns_id;
+    read_boot_id (header.boot_id);
+
+    data = g_byte_array_sized_new (sizeof header +
+                                   identities->len * sizeof (MountSnapshotIdentity) +
+                                   mounts->len * sizeof (MountSnapshotMount) +
+                                   strings->len);
+    g_byte_array_append (data, (const guint8 *) &header, sizeof header);
+    g_byte_array_append (data, (const guint8 *) identities->data,
+                         identities->len * sizeof (MountSnapshotIdentity));
+    g_byte_array_append (data, (const guint8 *) mounts->data,
+                         mounts->len * sizeof (MountSnapshotMount));
+    g_byte_array_append (data, strings->data, strings->len);
+
+    ret = g_file_set_contents (path, (const gchar *) data->data, data->len, error);
+
+    g_byte_array_unref (data);
+    g_hash_table_unref (identity_index);
+    g_hash_table_unref (offsets);
+    g_byte_array_unref (strings);
+    g_array_unref (mounts);
+    g_array_unref (identities);
+
+    return ret;
+}
+
+/* Maps the snapshot at path.  Fails if it is truncated, of another version
+ * or from before the last reboot.
+ */
+MountSnapshot *
+mount_snapshot_load (const gchar  *path,
+                     GError      **error)
+{
+    MountSnapshot *snapshot;
+    const MountSnapshotHeader *header;
+    GMappedFile *file;
+    gchar boot_id[40];
+    const gchar *data;
+    gsize expected;
+    gsize len;
+    guint n;
+
+    file = g_mapped_file_new (path, FALSE, error);
+    if (file == NULL)
+        return NULL;
+
+    data = g_mapped_file_get_contents (file);
+    len = g_mapped_file_get_length (file);
+    header = (const MountSnapshotHeader *) data;
+    if (len < sizeof *header ||
+        memcmp (header->magic, MOUNT_SNAPSHOT_MAGIC, sizeof header->magic) != 0 ||
+        header->version != MOUNT_SNAPSHOT_VERSION)
+    {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                     "%s is not a version %d snapshot", path, MOUNT_SNAPSHOT_VERSION);
+        g_mapped_file_unref (file);
+        return NULL;
+    }
+
+    expected = sizeof *header +
+               (gsize) header->n_identities * sizeof (MountSnapshotIdentity) +
+               (gsize) header->n_mounts * sizeof (MountSnapshotMount) +
+               header->strings_len;
+    if (len != expected || header->strings_len == 0 || data[len - 1] != '\0')
+    {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                     "Snapshot %s is truncated", path);
+        g_mapped_file_unref (file);
+        return NULL;
+    }
+
+    read_boot_id (boot_id);
+    if (boot_id[0] == '\0' || memcmp (header->boot_id, boot_id, sizeof boot_id) != 0)
+    {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                     "Snapshot %s is from another boot", path);
+        g_mapped_file_unref (file);
+        return NULL;
+    }
+
+    snapshot = g_new0 (MountSnapshot, 1);
+    snapshot->file = file;
+    snapshot->header = header;
+    snapshot->identities = (const MountSnapshotIdentity *) (data + sizeof *header);
+    snapshot->mounts = (const MountSnapshotMount *) (snapshot->identities + header->n_identities);
+    snapshot->strings = (const gchar *) (snapshot->mounts + header->n_mounts);
+
+    /* the identity indexes are the only thing left that could point outside */
+    for (n = 0; n < header->n_mounts; n++)
+    {
+        if (snapshot->mounts[n].identity >= header->n_identities)
+        {
+            g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                         "Snapshot %s is corrupt", path);
+            mount_snapshot_free (snapshot);
+            return NULL;
+        }
+    }
+
+    return snapshot;
+}
+
+void
+mount_snapshot_free (MountSnapshot *snapshot)
+{
+    if (snapshot == NULL)
+        return;
+
+    g_mapped_file_unref (snapshot->file);
+    g_free (snapshot);
+}
+
+/* The string at offset, NULL for MOUNT_SNAPSHOT_NO_STRING or an offset
+ * outside the table */
+const gchar *
+mount_snapshot_get_string (MountSnapshot *snapshot,
+                           guint32        offset)
+{
+    if (offset >= snapshot->header->strings_len)
+        return NULL;
+    return snapshot->strings + offset;
+}
+
+/* Returns a new DeviceIdentity with the contents of identity index */
+DeviceIdentity *
+mount_snapshot_get_identity (MountSnapshot *snapshot,
+                             guint          index)
+{
+    const MountSnapshotIdentity *stored = &snapshot->identities[index];
+    DeviceIdentity *identity;
+
+    identity = device_identity_new (stored->dev);
+    identity->uuid = g_strdup (mount_snapshot_get_string (snapshot, stored->uuid));
+    identity->drive_path = g_strdup (mount_snapshot_get_string (snapshot, stored->drive_path));
+    identity->serial = g_strdup (mount_snapshot_get_string (snapshot, stored->serial));
+    identity->vendor = g_strdup (mount_snapshot_get_string (snapshot, stored->vendor));
+    identity->model = g_strdup (mount_snapshot_get_string (snapshot, stored->model));
+    identity->complete = stored->complete;
+
+    return identity;
+}
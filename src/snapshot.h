@@ -0,0 +1,90 @@
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+#include "mountinfo.h"
+#include "devicecache.h"
+
+#define MOUNT_SNAPSHOT_MAGIC "MMSNAP\r\n"
+#define MOUNT_SNAPSHOT_VERSION 1
+/* an offset that stands for a NULL string */
+#define MOUNT_SNAPSHOT_NO_STRING G_MAXUINT32
+
+/* The file is laid out as the header, the identities, the mounts and the
+ * string table, all in host byte order, so it can be used where it is
+ * mapped.  Strings are offsets into the table, which ends with a NUL.
+ */
+typedef struct _MountSnapshotHeader MountSnapshotHeader;
+struct _MountSnapshotHeader
+{
+    gchar magic[8];
+    guint32 version;
+    guint32 n_identities;
+    guint32 n_mounts;
+    guint32 strings_len;
+    /* the namespace the mounts are from */
+    guint64 ns_id;
+    /* /proc/sys/kernel/random/boot_id when written; device numbers and
+     * mount IDs mean nothing after a reboot */
+    gchar boot_id[40];
+};
+
+typedef struct _MountSnapshotIdentity MountSnapshotIdentity;
+struct _MountSnapshotIdentity
+{
+    guint64 dev;
+    guint32 uuid;
+    guint32 drive_path;
+    guint32 serial;
+    guint32 vendor;
+    guint32 model;
+    guint32 complete;
+};
+
+typedef struct _MountSnapshotMount MountSnapshotMount;
+struct _MountSnapshotMount
+{
+    guint64 dev;
+    guint64 mount_id;
+    guint32 path;
+    /* index into the identities */
+    guint32 identity;
+    guint32 type;
+    guint32 padding;
+};
+
+/* One announced mount as it goes into a snapshot; nothing is owned */
+typedef struct _MountSnapshotEntry MountSnapshotEntry;
+struct _MountSnapshotEntry
+{
+    MountType type;
+    dev_t dev;
+    guint64 mount_id;
+    const gchar *path;
+    DeviceIdentity *identity;
+};
+
+/* A snapshot file mapped into memory.  It has been checked to be complete
+ * and from the running boot, so every offset in it can be followed.
+ */
+typedef struct _MountSnapshot MountSnapshot;
+struct _MountSnapshot
+{
+    GMappedFile *file;
+    const MountSnapshotHeader *header;
+    const MountSnapshotIdentity *identities;
+    const MountSnapshotMount *mounts;
+    const gchar *strings;
+};
+
+gboolean        mount_snapshot_save         (const gchar    *path,
+                                             guint64         ns_id,
+                                             GList          *entries,
+                                             GError        **error);
+MountSnapshot  *mount_snapshot_load         (const gchar    *path,
+                                             GError        **error);
+void            mount_snapshot_free         (MountSnapshot  *snapshot);
+const gchar    *mount_snapshot_get_string   (MountSnapshot  *snapshot,
+                                             guint32         offset);
+DeviceIdentity *mount_snapshot_get_identity (MountSnapshot  *snapshot,
+                                             guint           index);
+
+#endif
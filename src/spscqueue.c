@@ -0,0 +1,86 @@
+#include "spscqueue.h"
+
+SpscQueue *
+spsc_queue_new (void)
+{
+    SpscQueue *queue;
+    SpscNode *dummy;
+
+    queue = g_new0 (SpscQueue, 1);
+    dummy = g_new0 (SpscNode, 1);
+    queue->tail = queue->head = queue->first = queue->tail_copy = dummy;
+
+    return queue;
+}
+
+/* Only once neither side uses the queue any more; items still in it are
+ * not freed
+ */
+void
+spsc_queue_free (SpscQueue *queue)
+{
+    SpscNode *node;
+    SpscNode *next;
+
+    if (queue == NULL)
+        return;
+
+    for (node = queue->first; node != NULL; node = next)
+    {
+        next = node->next;
+        g_free (node);
+    }
+    g_free (queue);
+}
+
+/* Producer side: a node the consumer is done with, or a new one */
+static SpscNode *
+spsc_queue_alloc_node (SpscQueue *queue)
+{
+    SpscNode *node;
+
+    if (queue->first == queue->tail_copy)
+        queue->tail_copy = g_atomic_pointer_get (&queue->tail);
+
+    if (queue->first != queue->tail_copy)
+    {
+        node = queue->first;
+        queue->first = node->next;
+        return node;
+    }
+
+    return g_new (SpscNode, 1);
+}
+
+/* Producer side */
+void
+spsc_queue_push (SpscQueue *queue,
+                 gpointer   data)
+{
+    SpscNode *node;
+
+    node = spsc_queue_alloc_node (queue);
+    node->data = data;
+    node->next = NULL;
+    /* publishes data and next together with the link */
+    g_atomic_pointer_set (&queue->head->next, node);
+    queue->head = node;
+}
+
+/* Consumer side.  Returns FALSE if the queue is empty. */
+gboolean
+spsc_queue_pop (SpscQueue *queue,
+                gpointer  *out_data)
+{
+    SpscNode *next;
+
+    next = g_atomic_pointer_get (&queue->tail->next);
+    if (next == NULL)
+        return FALSE;
+
+    *out_data = next->data;
+    /* next becomes the dummy; the old one goes back to the producer */
+    g_atomic_pointer_set (&queue->tail, next);
+
+    return TRUE;
+}
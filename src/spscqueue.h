@@ -0,0 +1,38 @@
+#ifndef __SPSC_QUEUE_H__
+#define __SPSC_QUEUE_H__
+#include <glib.h>
+
+typedef struct _SpscNode SpscNode;
+struct _SpscNode
+{
+    SpscNode *next;
+    gpointer data;
+};
+
+/* Unbounded lock-free FIFO for exactly one producer thread and one consumer
+ * thread.  The consumer keeps a dummy node in front of the items; nodes it
+ * has passed are recycled by the producer, so a steady stream of items
+ * doesn't allocate.  Pushing never blocks and never fails.
+ */
+typedef struct _SpscQueue SpscQueue;
+struct _SpscQueue
+{
+    /* consumer side: the dummy node, whose next is the oldest item */
+    SpscNode *tail;
+
+    /* producer side: the newest node */
+    SpscNode *head;
+    /* the oldest node not freed yet; those before tail can be reused */
+    SpscNode *first;
+    /* the producer's last look at tail */
+    SpscNode *tail_copy;
+};
+
+SpscQueue *spsc_queue_new  (void);
+void       spsc_queue_free (SpscQueue  *queue);
+void       spsc_queue_push (SpscQueue  *queue,
+                            gpointer    data);
+gboolean   spsc_queue_pop  (SpscQueue  *queue,
+                            gpointer   *out_data);
+
+#endif
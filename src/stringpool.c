@@ -0,0 +1,78 @@
+#include "stringpool.h"
+#include <string.h>
+
+typedef struct _PoolString PoolString;
+struct _PoolString
+{
+    guint ref_count;
+    gchar str[];
+};
+
+#define POOL_STRING(str) ((PoolString *) ((gchar *) (str) - G_STRUCT_OFFSET (PoolString, str)))
+
+StringPool *
+string_pool_new (void)
+{
+    StringPool *pool;
+
+    pool = g_new0 (StringPool, 1);
+    pool->strings = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+
+    return pool;
+}
+
+void
+string_pool_free (StringPool *pool)
+{
+    if (pool == NULL)
+        return;
+
+    g_hash_table_unref (pool->strings);
+    g_free (pool);
+}
+
+/* Returns the pool's copy of str with a new reference to it; NULL stays
+ * NULL.  Interned strings can be compared by pointer.
+ */
+const gchar *
+string_pool_intern (StringPool  *pool,
+                    const gchar *str)
+{
+    PoolString *entry;
+    gsize len;
+
+    if (str == NULL)
+        return NULL;
+
+    entry = g_hash_table_lookup (pool->strings, str);
+    if (entry == NULL)
+    {
+        len = strlen (str) + 1;
+        entry = g_malloc (sizeof (PoolString) + len);
+        entry->ref_count = 0;
+        memcpy (entry->str, str, len);
+        g_hash_table_insert (pool->strings, entry->str, entry);
+        pool->n_bytes += len;
+    }
+    entry->ref_count++;
+
+    return entry->str;
+}
+
+/* Drops a reference taken by string_pool_intern() */
+void
+string_pool_release (StringPool  *pool,
+                     const gchar *str)
+{
+    PoolString *entry;
+
+    if (str == NULL)
+        return;
+
+    entry = POOL_STRING (str);
+    if (--entry->ref_count > 0)
+        return;
+
+    pool->n_bytes -= strlen (str) + 1;
+    g_hash_table_remove (pool->strings, str);
+}
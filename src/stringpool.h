@@ -0,0 +1,26 @@
+#ifndef __STRING_POOL_H__
+#define __STRING_POOL_H__
+#include <glib.h>
+
+/* Reference counted interning of the strings of the mount tables: equal
+ * mount paths, fstypes and sources are stored once, however many mounts,
+ * namespaces and reloads they turn up in.  A string is freed when its last
+ * reference is released.  Not thread-safe.
+ */
+typedef struct _StringPool StringPool;
+struct _StringPool
+{
+    /* the string -> its PoolString */
+    GHashTable *strings;
+    /* bytes taken by the strings themselves */
+    gsize n_bytes;
+};
+
+StringPool  *string_pool_new     (void);
+void         string_pool_free    (StringPool  *pool);
+const gchar *string_pool_intern  (StringPool  *pool,
+                                  const gchar *str);
+void         string_pool_release (StringPool  *pool,
+                                  const gchar *str);
+
+#endif
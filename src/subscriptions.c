@@ -0,0 +1,317 @@
+#include "subscriptions.h"
+#include <string.h>
+
+static void
+subscription_free (Subscription *sub)
+{
+    g_free (sub->owner);
+    g_free (sub->path_prefix);
+    g_free (sub->fstype);
+    g_free (sub->uuid);
+    g_slice_free (Subscription, sub);
+}
+
+SubscriptionTable *
+subscription_table_new (void)
+{
+    SubscriptionTable *table;
+
+    table = g_new0 (SubscriptionTable, 1);
+    table->by_id = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                          NULL, (GDestroyNotify) subscription_free);
+    table->by_dev = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, NULL);
+    table->by_uuid = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    table->by_fstype = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    table->by_path = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    return table;
+}
+
+static void
+free_bucket (gpointer key,
+             gpointer value,
+             gpointer user_data)
+{
+    g_list_free (value);
+}
+
+void
+subscription_table_free (SubscriptionTable *table)
+{
+    GHashTable *buckets[4];
+    guint n;
+
+    if (table == NULL)
+        return;
+
+    buckets[0] = table->by_dev;
+    buckets[1] = table->by_uuid;
+    buckets[2] = table->by_fstype;
+    buckets[3] = table->by_path;
+    for (n = 0; n < G_N_ELEMENTS (buckets); n++)
+    {
+        g_hash_table_foreach (buckets[n], free_bucket, NULL);
+        g_hash_table_unref (buckets[n]);
+    }
+    g_list_free (table->match_all);
+    g_hash_table_unref (table->by_id);
+    g_free (table);
+}
+
+/* The buckets sub is filed in and its key there, NULL if it has no
+ * criteria at all
+ */
+static GHashTable *
+subscription_table_get_buckets (SubscriptionTable  *table,
+                                Subscription       *sub,
+                                gconstpointer      *out_key)
+{
+    if (sub->has_dev)
+    {
+        *out_key = &sub->dev;
+        return table->by_dev;
+    }
+    if (sub->uuid != NULL)
+    {
+        *out_key = sub->uuid;
+        return table->by_uuid;
+    }
+    if (sub->fstype != NULL)
+    {
+        *out_key = sub->fstype;
+        return table->by_fstype;
+    }
+    if (sub->path_prefix != NULL)
+    {
+        *out_key = sub->path_prefix;
+        return table->by_path;
+    }
+    return NULL;
+}
+
+/* Stores list under key, which the buckets don't own yet */
+static void
+set_bucket (SubscriptionTable *table,
+            GHashTable        *buckets,
+            gconstpointer      key,
+            GList             *list)
+{
+    gpointer key_copy;
+
+    if (list == NULL)
+    {
+        g_hash_table_remove (buckets, key);
+        return;
+    }
+
+    if (buckets == table->by_dev)
+    {
+        key_copy = g_new (guint64, 1);
+        *(guint64 *) key_copy = *(const guint64 *) key;
+    }
+    else
+        key_copy = g_strdup (key);
+    /* keeps the key already there and frees the copy */
+    g_hash_table_insert (buckets, key_copy, list);
+}
+
+/* "/mnt/data/" -> "/mnt/data"; the root stays "/" */
+static gchar *
+normalize_path_prefix (const gchar *path)
+{
+    gsize len;
+
+    len = strlen (path);
+    while (len > 1 && path[len - 1] == '/')
+        len--;
+
+    return g_strndup (path, len);
+}
+
+/* Returns the ID of the new subscription, never 0.  An empty path prefix
+ * counts as unset; the others have to be absolute.
+ */
+guint
+subscription_table_add (SubscriptionTable        *table,
+                        const gchar              *owner,
+                        const SubscriptionFilter *filter)
+{
+    Subscription *sub;
+    GHashTable *buckets;
+    gconstpointer key;
+
+    sub = g_slice_new0 (Subscription);
+    do
+        sub->id = ++table->last_id;
+    while (sub->id == 0 || g_hash_table_contains (table->by_id, GUINT_TO_POINTER (sub->id)));
+    sub->owner = g_strdup (owner);
+    if (filter->path_prefix != NULL && filter->path_prefix[0] != '\0')
+        sub->path_prefix = normalize_path_prefix (filter->path_prefix);
+    sub->fstype = g_strdup (filter->fstype);
+    sub->has_dev = filter->has_dev;
+    sub->dev = filter->dev;
+    sub->uuid = g_strdup (filter->uuid);
+
+    g_hash_table_insert (table->by_id, GUINT_TO_POINTER (sub->id), sub);
+
+    buckets = subscription_table_get_buckets (table, sub, &key);
+    if (buckets == NULL)
+        table->match_all = g_list_prepend (table->match_all, sub);
+    else
+        set_bucket (table, buckets, key,
+                    g_list_prepend (g_hash_table_lookup (buckets, key), sub));
+
+    return sub->id;
+}
+
+static void
+subscription_table_unfile (SubscriptionTable *table,
+                           Subscription      *sub)
+{
+    GHashTable *buckets;
+    gconstpointer key;
+
+    buckets = subscription_table_get_buckets (table, sub, &key);
+    if (buckets == NULL)
+        table->match_all = g_list_remove (table->match_all, sub);
+    else
+        set_bucket (table, buckets, key,
+                    g_list_remove (g_hash_table_lookup (buckets, key), sub));
+}
+
+/* Removes subscription id if it belongs to owner, or to anyone if owner
+ * is NULL
+ */
+gboolean
+subscription_table_remove (SubscriptionTable *table,
+                           guint              id,
+                           const gchar       *owner)
+{
+    Subscription *sub;
+
+    sub = g_hash_table_lookup (table->by_id, GUINT_TO_POINTER (id));
+    if (sub == NULL || (owner != NULL && strcmp (sub->owner, owner) != 0))
+        return FALSE;
+
+    subscription_table_unfile (table, sub);
+    g_hash_table_remove (table->by_id, GUINT_TO_POINTER (id));
+
+    return TRUE;
+}
+
+/* Drops everything owner subscribed to, for when it left the bus */
+guint
+subscription_table_remove_owner (SubscriptionTable *table,
+                                 const gchar       *owner)
+{
+    GHashTableIter iter;
+    Subscription *sub;
+    guint n;
+
+    n = 0;
+    g_hash_table_iter_init (&iter, table->by_id);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &sub))
+    {
+        if (strcmp (sub->owner, owner) != 0)
+            continue;
+        subscription_table_unfile (table, sub);
+        g_hash_table_iter_remove (&iter);
+        n++;
+    }
+
+    return n;
+}
+
+guint
+subscription_table_size (SubscriptionTable *table)
+{
+    return g_hash_table_size (table->by_id);
+}
+
+/* prefix is normalized, so "/mnt/data" covers "/mnt/data/x" but not
+ * "/mnt/database"
+ */
+static gboolean
+path_has_prefix (const gchar *path,
+                 const gchar *prefix)
+{
+    gsize len;
+
+    if (strcmp (prefix, "/") == 0)
+        return path[0] == '/';
+
+    len = strlen (prefix);
+    return strncmp (path, prefix, len) == 0 && (path[len] == '\0' || path[len] == '/');
+}
+
+static gboolean
+subscription_matches (Subscription            *sub,
+                      const SubscriptionEvent *event)
+{
+    if (sub->has_dev && sub->dev != (guint64) event->dev)
+        return FALSE;
+    if (sub->uuid != NULL && g_strcmp0 (sub->uuid, event->uuid) != 0)
+        return FALSE;
+    if (sub->fstype != NULL && g_strcmp0 (sub->fstype, event->fstype) != 0)
+        return FALSE;
+    if (sub->path_prefix != NULL && (event->path == NULL || !path_has_prefix (event->path, sub->path_prefix)))
+        return FALSE;
+    return TRUE;
+}
+
+static void
+match_list (GList                   *list,
+            const SubscriptionEvent *event,
+            SubscriptionMatchFunc    func,
+            gpointer                 user_data)
+{
+    for (; list != NULL; list = list->next)
+    {
+        if (subscription_matches (list->data, event))
+            func (list->data, user_data);
+    }
+}
+
+/* Calls func once for every subscription event matches.  The subscriptions
+ * must not be changed from func.
+ */
+void
+subscription_table_match (SubscriptionTable       *table,
+                          const SubscriptionEvent *event,
+                          SubscriptionMatchFunc    func,
+                          gpointer                 user_data)
+{
+    guint64 dev;
+
+    if (g_hash_table_size (table->by_id) == 0)
+        return;
+
+    dev = event->dev;
+    match_list (g_hash_table_lookup (table->by_dev, &dev), event, func, user_data);
+    if (event->uuid != NULL && event->uuid[0] != '\0')
+        match_list (g_hash_table_lookup (table->by_uuid, event->uuid), event, func, user_data);
+    if (event->fstype != NULL)
+        match_list (g_hash_table_lookup (table->by_fstype, event->fstype), event, func, user_data);
+
+    /* the path itself and each of its ancestors up to "/" */
+    if (event->path != NULL && event->path[0] == '/' && g_hash_table_size (table->by_path) != 0)
+    {
+        gchar *path = normalize_path_prefix (event->path);
+        gchar *slash;
+
+        for (;;)
+        {
+            match_list (g_hash_table_lookup (table->by_path, path), event, func, user_data);
+            if (strcmp (path, "/") == 0)
+                break;
+            slash = strrchr (path, '/');
+            if (slash == path)
+                slash[1] = '\0';
+            else
+                *slash = '\0';
+        }
+        g_free (path);
+    }
+
+    match_list (table->match_all, event, func, user_data);
+}
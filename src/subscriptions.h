@@ -0,0 +1,85 @@
+#ifndef __SUBSCRIPTIONS_H__
+#define __SUBSCRIPTIONS_H__
+#include <glib.h>
+#include <sys/types.h>
+
+/* What a client wants to hear about.  Unset criteria (NULL strings,
+ * has_dev FALSE) match anything; the others must all match.
+ */
+typedef struct _SubscriptionFilter SubscriptionFilter;
+struct _SubscriptionFilter
+{
+    /* the mount point itself or anything below it */
+    const gchar *path_prefix;
+    const gchar *fstype;
+    gboolean has_dev;
+    dev_t dev;
+    const gchar *uuid;
+};
+
+typedef struct _Subscription Subscription;
+struct _Subscription
+{
+    guint id;
+    /* unique bus name of the subscriber */
+    gchar *owner;
+    /* normalized, without a trailing slash unless it is "/" */
+    gchar *path_prefix;
+    gchar *fstype;
+    gboolean has_dev;
+    guint64 dev;
+    gchar *uuid;
+};
+
+/* One mount change as seen by the matcher */
+typedef struct _SubscriptionEvent SubscriptionEvent;
+struct _SubscriptionEvent
+{
+    const gchar *path;
+    const gchar *fstype;
+    dev_t dev;
+    /* NULL if unknown */
+    const gchar *uuid;
+};
+
+typedef void (*SubscriptionMatchFunc) (Subscription *sub,
+                                       gpointer      user_data);
+
+/* All subscriptions, compiled for matching: each one is filed under its
+ * most selective criterion (dev_t, then UUID, then fstype, then path
+ * prefix), so an event only looks at the few subscriptions filed under its
+ * own dev_t, UUID, fstype and the ancestors of its path, plus those without
+ * any criteria.
+ */
+typedef struct _SubscriptionTable SubscriptionTable;
+struct _SubscriptionTable
+{
+    guint last_id;
+    /* id -> Subscription, owns them */
+    GHashTable *by_id;
+    /* criterion -> GList of Subscription */
+    GHashTable *by_dev;
+    GHashTable *by_uuid;
+    GHashTable *by_fstype;
+    GHashTable *by_path;
+    /* subscriptions without criteria */
+    GList *match_all;
+};
+
+SubscriptionTable *subscription_table_new          (void);
+void               subscription_table_free         (SubscriptionTable        *table);
+guint              subscription_table_add          (SubscriptionTable        *table,
+                                                    const gchar              *owner,
+                                                    const SubscriptionFilter *filter);
+gboolean           subscription_table_remove       (SubscriptionTable        *table,
+                                                    guint                     id,
+                                                    const gchar              *owner);
+guint              subscription_table_remove_owner (SubscriptionTable        *table,
+                                                    const gchar              *owner);
+guint              subscription_table_size         (SubscriptionTable        *table);
+void               subscription_table_match        (SubscriptionTable        *table,
+                                                    const SubscriptionEvent  *event,
+                                                    SubscriptionMatchFunc     func,
+                                                    gpointer                  user_data);
+
+#endif
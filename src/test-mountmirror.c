@@ -0,0 +1,217 @@
+/* Tests of the main thread's mirror of a namespace, fed by a MountNamespace
+ * that reads a mountinfo table from a temporary file.  Each test rewrites
+ * the file in place and reloads, the way the worker would on a /proc
+ * change notification, then checks the mirror's queries.
+ */
+#include "mountmirror.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+typedef struct
+{
+    gchar *path;
+    MountParser *parser;
+    MountNamespace *ns;
+    MountMirror *mirror;
+} Fixture;
+
+/* Applies a change the way the monitor's worker event handler does */
+static void
+on_changed (MountNamespace *ns,
+            GList          *added,
+            GList          *removed,
+            GList          *changed,
+            gpointer        user_data)
+{
+    Fixture *fixture = user_data;
+    GList *l;
+
+    for (l = removed; l != NULL; l = l->next)
+        mount_mirror_remove (fixture->mirror, MOUNT_INFO (l->data));
+    for (l = changed; l != NULL; l = l->next)
+        mount_mirror_remove (fixture->mirror, ((MountChange *) l->data)->old_mount);
+    for (l = changed; l != NULL; l = l->next)
+        mount_mirror_add (fixture->mirror, ((MountChange *) l->data)->new_mount);
+    for (l = added; l != NULL; l = l->next)
+        mount_mirror_add (fixture->mirror, MOUNT_INFO (l->data));
+
+    g_list_free (added);
+    g_list_free_full (removed, (GDestroyNotify) mount_info_unref);
+    g_list_free_full (changed, (GDestroyNotify) mount_change_free);
+}
+
+/* In place, the namespace keeps reading through the fd it opened */
+static void
+write_table (Fixture     *fixture,
+             const gchar *contents)
+{
+    gsize len = strlen (contents);
+    int fd;
+
+    fd = open (fixture->path, O_WRONLY | O_TRUNC | O_CLOEXEC);
+    g_assert_cmpint (fd, >=, 0);
+    g_assert_cmpint (write (fd, contents, len), ==, (gssize) len);
+    close (fd);
+}
+
+static void
+fixture_set_up (Fixture     *fixture,
+                const gchar *contents)
+{
+    GHashTableIter iter;
+    MountInfo *mount;
+    GError *error = NULL;
+    int fd;
+
+    fd = g_file_open_tmp ("test-mountmirror-XXXXXX", &fixture->path, &error);
+    g_assert_no_error (error);
+    close (fd);
+    write_table (fixture, contents);
+
+    fixture->parser = mount_parser_new ();
+    fixture->ns = mount_namespace_new_for_file (fixture->path, fixture->parser,
+                                                on_changed, fixture, &error);
+    g_assert_no_error (error);
+
+    fixture->mirror = mount_mirror_new (mount_namespace_get_id (fixture->ns));
+    g_hash_table_iter_init (&iter, fixture->ns->mounts);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &mount))
+        mount_mirror_add (fixture->mirror, mount);
+}
+
+static void
+fixture_tear_down (Fixture *fixture)
+{
+    mount_mirror_free (fixture->mirror);
+    mount_namespace_free (fixture->ns);
+    mount_parser_free (fixture->parser);
+    g_unlink (fixture->path);
+    g_free (fixture->path);
+}
+
+/* Fills in the IDs of the subtree of mount_id, returns how many */
+static guint
+subtree_ids (MountMirror *mirror,
+             guint64      mount_id,
+             guint64     *out_ids,
+             guint        max_ids)
+{
+    GList *subtree;
+    GList *l;
+    guint n;
+
+    subtree = mount_mirror_get_subtree (mirror, mount_id);
+    n = 0;
+    for (l = subtree; l != NULL && n < max_ids; l = l->next)
+        out_ids[n++] = MOUNT_INFO (l->data)->mount_id;
+    g_list_free (subtree);
+
+    return n;
+}
+
+#define TABLE_ROOT \
+    "1 1 8:1 / / rw,relatime shared:1 - ext4 /dev/sda1 rw\n"
+
+/* /data unmounted and mounted again, with a child, between two scans:
+ * the same devices and paths under new IDs
+ */
+static void
+test_remount_same_path (void)
+{
+    Fixture fixture = { 0 };
+    guint64 ids[4];
+    GList *under;
+    GList *l;
+
+    fixture_set_up (&fixture,
+                    TABLE_ROOT
+                    "30 1 8:2 / /data rw,relatime shared:2 - ext4 /dev/sda2 rw\n"
+                    "31 30 8:3 / /data/sub rw,relatime - ext4 /dev/sda3 rw\n");
+    g_assert_cmpuint (subtree_ids (fixture.mirror, 30, ids, G_N_ELEMENTS (ids)), ==, 2);
+
+    write_table (&fixture,
+                 TABLE_ROOT
+                 "40 1 8:2 / /data rw,noatime shared:2 - ext4 /dev/sda2 rw\n"
+                 "41 40 8:3 / /data/sub rw,relatime - ext4 /dev/sda3 rw\n");
+    mount_namespace_reload (fixture.ns);
+
+    g_assert_null (mount_mirror_get_mount_by_id (fixture.mirror, 30));
+    g_assert_null (mount_mirror_get_mount_by_id (fixture.mirror, 31));
+    g_assert_cmpuint (subtree_ids (fixture.mirror, 40, ids, G_N_ELEMENTS (ids)), ==, 2);
+    g_assert_cmpuint (ids[0], ==, 40);
+    g_assert_cmpuint (ids[1], ==, 41);
+    g_assert_cmpstr (mount_mirror_get_mount_by_id (fixture.mirror, 40)->options, ==, "rw,noatime");
+
+    under = mount_mirror_get_mounts_under (fixture.mirror, "/data");
+    g_assert_cmpuint (g_list_length (under), ==, 2);
+    for (l = under; l != NULL; l = l->next)
+    {
+        MountInfo *mount = MOUNT_INFO (l->data);
+
+        if (strcmp (mount->mount_path, "/data") == 0)
+        {
+            g_assert_cmpuint (mount->mount_id, ==, 40);
+            g_assert_cmpuint (mount->parent_id, ==, 1);
+        }
+        else
+        {
+            g_assert_cmpuint (mount->mount_id, ==, 41);
+            g_assert_cmpuint (mount->parent_id, ==, 40);
+        }
+    }
+    g_list_free (under);
+
+    fixture_tear_down (&fixture);
+}
+
+/* The same device bind mounted twice on /data: two mounts, one on the
+ * other
+ */
+static void
+test_stacked_mounts (void)
+{
+    Fixture fixture = { 0 };
+    guint64 ids[4];
+    GList *under;
+
+    fixture_set_up (&fixture,
+                    TABLE_ROOT
+                    "30 1 8:2 / /data rw,relatime shared:2 - ext4 /dev/sda2 rw\n");
+
+    write_table (&fixture,
+                 TABLE_ROOT
+                 "30 1 8:2 / /data rw,relatime shared:2 - ext4 /dev/sda2 rw\n"
+                 "32 30 8:2 / /data rw,relatime shared:2 - ext4 /dev/sda2 rw\n");
+    mount_namespace_reload (fixture.ns);
+
+    g_assert_cmpuint (subtree_ids (fixture.mirror, 30, ids, G_N_ELEMENTS (ids)), ==, 2);
+    g_assert_cmpuint (ids[1], ==, 32);
+    under = mount_mirror_get_mounts_under (fixture.mirror, "/data");
+    g_assert_cmpuint (g_list_length (under), ==, 2);
+    g_list_free (under);
+
+    /* the upper one goes away again */
+    write_table (&fixture,
+                 TABLE_ROOT
+                 "30 1 8:2 / /data rw,relatime shared:2 - ext4 /dev/sda2 rw\n");
+    mount_namespace_reload (fixture.ns);
+
+    g_assert_nonnull (mount_mirror_get_mount_by_id (fixture.mirror, 30));
+    g_assert_null (mount_mirror_get_mount_by_id (fixture.mirror, 32));
+    g_assert_cmpuint (subtree_ids (fixture.mirror, 30, ids, G_N_ELEMENTS (ids)), ==, 1);
+
+    fixture_tear_down (&fixture);
+}
+
+int
+main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/mountmirror/remount-same-path", test_remount_same_path);
+    g_test_add_func ("/mountmirror/stacked-mounts", test_stacked_mounts);
+
+    return g_test_run ();
+}
@@ -0,0 +1,31 @@
+#ifndef __HARNESS_H__
+#define __HARNESS_H__
+#include <stdio.h>
+#include <glib.h>
+#include <sys/sysmacros.h>
+
+/* What mock-udisks exports and latency-client mounts have to agree on.
+ * Device n is the block device HARNESS_DEV_MAJOR:n with the filesystem
+ * UUID harness_uuid(n), on its own drive.
+ */
+#define HARNESS_DEV_MAJOR 259
+#define HARNESS_UUID_FORMAT "00000000-0000-4000-8000-%012u"
+
+static inline gchar *
+harness_uuid (guint n)
+{
+    return g_strdup_printf (HARNESS_UUID_FORMAT, n);
+}
+
+/* Returns the device number a UUID was made for, or -1 */
+static inline gint
+harness_device_from_uuid (const gchar *uuid)
+{
+    guint n;
+
+    if (sscanf (uuid, HARNESS_UUID_FORMAT, &n) != 1)
+        return -1;
+    return n;
+}
+
+#endif
@@ -0,0 +1,489 @@
+/* Drives scripted mount churn through the monitor's mountinfo file and
+ * measures how long each change takes to come back as MountAdded or
+ * MountRemoved.  The clock starts right before the file is rewritten,
+ * which stands in for the mount syscall, and stops when the signal is
+ * dispatched here.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <gio/gio.h>
+#include "harness.h"
+
+static gchar *opt_mountinfo = NULL;
+static gint opt_devices = 64;
+static gint opt_iterations = 200;
+static gint opt_bursts = 20;
+static gint opt_burst_size = 32;
+static gint opt_timeout_ms = 5000;
+
+static GOptionEntry entries[] =
+{
+    { "mountinfo", 0, 0, G_OPTION_ARG_FILENAME, &opt_mountinfo,
+      "The file the monitor was started with --mountinfo", "FILE" },
+    { "devices", 'n', 0, G_OPTION_ARG_INT, &opt_devices,
+      "Devices exported by mock-udisks (default 64)", "N" },
+    { "iterations", 'i', 0, G_OPTION_ARG_INT, &opt_iterations,
+      "Single mount/unmount round trips (default 200)", "I" },
+    { "bursts", 0, 0, G_OPTION_ARG_INT, &opt_bursts,
+      "Bulk mount/unmount rounds (default 20)", "R" },
+    { "burst-size", 0, 0, G_OPTION_ARG_INT, &opt_burst_size,
+      "Devices mounted or unmounted at once per round (default 32)", "K" },
+    { "timeout-ms", 0, 0, G_OPTION_ARG_INT, &opt_timeout_ms,
+      "Give up on a signal after MS milliseconds (default 5000)", "MS" },
+    { NULL }
+};
+
+#define HISTOGRAM_BUCKETS 32
+
+typedef struct _Histogram Histogram;
+struct _Histogram
+{
+    const gchar *name;
+    GArray *samples_ns;
+};
+
+typedef struct _Harness Harness;
+struct _Harness
+{
+    GDBusConnection *connection;
+    gchar *base;
+    GString *contents;
+
+    gboolean *mounted;
+    /* when the change of a device was written, 0 if none is outstanding */
+    gint64 *written_at;
+    gboolean *expect_added;
+    guint n_outstanding;
+    gint64 last_arrival;
+    gboolean timed_out;
+
+    /* where the current phase's latencies go */
+    Histogram *added;
+    Histogram *removed;
+    guint64 unexpected;
+    guint64 lost;
+};
+
+static gint64
+now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static Histogram *
+histogram_new (const gchar *name)
+{
+    Histogram *hist;
+
+    hist = g_new0 (Histogram, 1);
+    hist->name = name;
+    hist->samples_ns = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+    return hist;
+}
+
+static void
+histogram_free (Histogram *hist)
+{
+    g_array_free (hist->samples_ns, TRUE);
+    g_free (hist);
+}
+
+static gint
+compare_int64 (gconstpointer a,
+               gconstpointer b)
+{
+    gint64 x = *(const gint64 *) a;
+    gint64 y = *(const gint64 *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static gdouble
+percentile_us (GArray  *sorted,
+               gdouble  p)
+{
+    return g_array_index (sorted, gint64, (guint) (p * (sorted->len - 1) + 0.5)) / 1000.0;
+}
+
+/* Percentiles plus a log2 histogram in microseconds */
+static void
+histogram_print (Histogram *hist)
+{
+    GArray *sorted = hist->samples_ns;
+    guint counts[HISTOGRAM_BUCKETS] = { 0 };
+    guint max_count;
+    guint first;
+    guint last;
+    guint n;
+
+    printf ("\n%s: %u samples", hist->name, sorted->len);
+    if (sorted->len == 0)
+    {
+        printf ("\n");
+        return;
+    }
+    g_array_sort (sorted, compare_int64);
+    printf (", p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us\n",
+            percentile_us (sorted, 0.50), percentile_us (sorted, 0.90),
+            percentile_us (sorted, 0.99), g_array_index (sorted, gint64, sorted->len - 1) / 1000.0);
+
+    for (n = 0; n < sorted->len; n++)
+    {
+        guint64 us = g_array_index (sorted, gint64, n) / 1000;
+        guint bucket = 0;
+
+        while (us > 1 && bucket < HISTOGRAM_BUCKETS - 1)
+        {
+            us >>= 1;
+            bucket++;
+        }
+        counts[bucket]++;
+    }
+
+    max_count = 0;
+    first = HISTOGRAM_BUCKETS;
+    last = 0;
+    for (n = 0; n < HISTOGRAM_BUCKETS; n++)
+    {
+        if (counts[n] == 0)
+            continue;
+        max_count = MAX (max_count, counts[n]);
+        first = MIN (first, n);
+        last = n;
+    }
+    for (n = first; n <= last; n++)
+    {
+        gchar *bar = g_strnfill (counts[n] * 50 / max_count, '#');
+
+        printf ("  %9" G_GUINT64_FORMAT " - %9" G_GUINT64_FORMAT " us %7u %s\n",
+                n == 0 ? 0 : G_GUINT64_CONSTANT (1) << n, G_GUINT64_CONSTANT (1) << (n + 1),
+                counts[n], bar);
+        g_free (bar);
+    }
+}
+
+static void
+on_signal (GDBusConnection *connection,
+           const gchar     *sender_name,
+           const gchar     *object_path,
+           const gchar     *interface_name,
+           const gchar     *signal_name,
+           GVariant        *parameters,
+           gpointer         user_data)
+{
+    Harness *harness = user_data;
+    const gchar *serial, *vendor, *model, *uuid;
+    guint64 ns_id, generation;
+    gboolean added;
+    gint64 now;
+    gint64 latency;
+    gint dev;
+
+    now = now_ns ();
+    if (strcmp (signal_name, "MountAdded") == 0)
+        added = TRUE;
+    else if (strcmp (signal_name, "MountRemoved") == 0)
+        added = FALSE;
+    else
+        return;
+
+    g_variant_get (parameters, "(&s&s&s&stt)", &serial, &vendor, &model, &uuid, &ns_id, &generation);
+    dev = harness_device_from_uuid (uuid);
+    if (dev < 0 || dev >= opt_devices || harness->written_at[dev] == 0 ||
+        harness->expect_added[dev] != added)
+    {
+        harness->unexpected++;
+        return;
+    }
+
+    latency = now - harness->written_at[dev];
+    g_array_append_val ((added ? harness->added : harness->removed)->samples_ns, latency);
+    harness->written_at[dev] = 0;
+    harness->n_outstanding--;
+    harness->last_arrival = now;
+}
+
+/* Rewrites the file in place, which is what the monitor's inotify watch
+ * expects: base contents followed by one line per mounted device
+ */
+static gboolean
+harness_write (Harness  *harness,
+               GError  **error)
+{
+    gssize written;
+    gint n;
+    int fd;
+
+    g_string_assign (harness->contents, harness->base);
+    for (n = 0; n < opt_devices; n++)
+    {
+        if (harness->mounted[n])
+            g_string_append_printf (harness->contents,
+                                    "%d 1 %d:%d / /mnt/harness%d rw,relatime shared:%d - ext4 /dev/harness%d rw\n",
+                                    1000 + n, HARNESS_DEV_MAJOR, n, n, 1000 + n, n);
+    }
+
+    fd = open (opt_mountinfo, O_WRONLY | O_TRUNC | O_CLOEXEC);
+    if (fd < 0)
+    {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                     "Error opening %s: %s", opt_mountinfo, g_strerror (errno));
+        return FALSE;
+    }
+    written = write (fd, harness->contents->str, harness->contents->len);
+    if (written != (gssize) harness->contents->len)
+    {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                     "Error writing %s: %s", opt_mountinfo, g_strerror (errno));
+        close (fd);
+        return FALSE;
+    }
+    close (fd);
+
+    return TRUE;
+}
+
+static gboolean
+on_timeout (gpointer user_data)
+{
+    Harness *harness = user_data;
+
+    harness->timed_out = TRUE;
+    return G_SOURCE_REMOVE;
+}
+
+/* Flips the devices first..first+count-1 with a single write and waits
+ * for all of their signals.  Returns the time from the write to the last
+ * signal.
+ */
+static gint64
+harness_change (Harness  *harness,
+                gint      first,
+                gint      count,
+                gboolean  mount,
+                GError  **error)
+{
+    gint64 start;
+    guint timeout_id;
+    gint n;
+
+    start = now_ns ();
+    for (n = first; n < first + count; n++)
+    {
+        harness->mounted[n % opt_devices] = mount;
+        harness->expect_added[n % opt_devices] = mount;
+        harness->written_at[n % opt_devices] = start;
+    }
+    harness->n_outstanding = count;
+
+    if (!harness_write (harness, error))
+        return -1;
+
+    harness->timed_out = FALSE;
+    timeout_id = g_timeout_add (opt_timeout_ms, on_timeout, harness);
+    while (harness->n_outstanding > 0 && !harness->timed_out)
+        g_main_context_iteration (NULL, TRUE);
+    if (!harness->timed_out)
+        g_source_remove (timeout_id);
+
+    if (harness->n_outstanding > 0)
+    {
+        harness->lost += harness->n_outstanding;
+        for (n = 0; n < opt_devices; n++)
+            harness->written_at[n] = 0;
+        harness->n_outstanding = 0;
+        return -1;
+    }
+
+    return harness->last_arrival - start;
+}
+
+static gboolean
+wait_for_name (GDBusConnection  *connection,
+               const gchar      *name,
+               GError          **error)
+{
+    gint64 deadline;
+
+    deadline = g_get_monotonic_time () + (gint64) opt_timeout_ms * 1000;
+    while (g_get_monotonic_time () < deadline)
+    {
+        GVariant *reply;
+        gboolean has_owner;
+
+        reply = g_dbus_connection_call_sync (connection, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+                                             "org.freedesktop.DBus", "NameHasOwner",
+                                             g_variant_new ("(s)", name), G_VARIANT_TYPE ("(b)"),
+                                             G_DBUS_CALL_FLAGS_NONE, -1, NULL, error);
+        if (reply == NULL)
+            return FALSE;
+        g_variant_get (reply, "(b)", &has_owner);
+        g_variant_unref (reply);
+        if (has_owner)
+            return TRUE;
+        g_usleep (50 * 1000);
+    }
+
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT, "%s didn't show up on the bus", name);
+    return FALSE;
+}
+
+int
+main (int argc, char **argv)
+{
+    GOptionContext *context;
+    GError *error = NULL;
+    Harness harness = { 0 };
+    Histogram *single_added, *single_removed, *burst_added, *burst_removed;
+    GArray *throughput;
+    gint64 elapsed;
+    gint64 start;
+    gint i;
+    int ret = 1;
+
+    context = g_option_context_new ("- measure mount to signal latency of mountmonitor");
+    g_option_context_add_main_entries (context, entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+        printf ("%s\n", error->message);
+        return 1;
+    }
+    g_option_context_free (context);
+    if (opt_mountinfo == NULL || opt_devices < 1 || opt_iterations < 0 || opt_bursts < 0 ||
+        opt_burst_size < 1 || opt_burst_size > opt_devices)
+    {
+        printf ("--mountinfo is required, --burst-size must be between 1 and --devices\n");
+        return 1;
+    }
+
+    if (!g_file_get_contents (opt_mountinfo, &harness.base, NULL, &error))
+        goto out;
+    harness.contents = g_string_new (NULL);
+    harness.mounted = g_new0 (gboolean, opt_devices);
+    harness.expect_added = g_new0 (gboolean, opt_devices);
+    harness.written_at = g_new0 (gint64, opt_devices);
+
+    harness.connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, &error);
+    if (harness.connection == NULL)
+        goto out;
+    g_dbus_connection_signal_subscribe (harness.connection, "org.freedesktop.MountMonitor",
+                                        "org.freedesktop.MountMonitor.Base", NULL,
+                                        "/org/freedesktop/MountMonitor", NULL,
+                                        G_DBUS_SIGNAL_FLAGS_NONE, on_signal, &harness, NULL);
+    if (!wait_for_name (harness.connection, "org.freedesktop.MountMonitor", &error))
+        goto out;
+
+    single_added = histogram_new ("single mount -> MountAdded");
+    single_removed = histogram_new ("single unmount -> MountRemoved");
+    burst_added = histogram_new ("burst mount -> MountAdded");
+    burst_removed = histogram_new ("burst unmount -> MountRemoved");
+    throughput = g_array_new (FALSE, FALSE, sizeof (gdouble));
+
+    /* the first change also waits for the monitor's UDisks client */
+    harness.added = histogram_new ("warm-up");
+    harness.removed = harness.added;
+    if (harness_change (&harness, 0, 1, TRUE, &error) < 0 ||
+        harness_change (&harness, 0, 1, FALSE, &error) < 0)
+    {
+        if (error == NULL)
+            g_set_error (&error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT, "No signal from the monitor during warm-up");
+        histogram_free (harness.added);
+        goto out_hist;
+    }
+    histogram_free (harness.added);
+
+    harness.added = single_added;
+    harness.removed = single_removed;
+    start = now_ns ();
+    for (i = 0; i < opt_iterations; i++)
+    {
+        if (harness_change (&harness, i, 1, TRUE, &error) < 0 && error != NULL)
+            goto out_hist;
+        if (harness_change (&harness, i, 1, FALSE, &error) < 0 && error != NULL)
+            goto out_hist;
+    }
+    elapsed = now_ns () - start;
+
+    harness.added = burst_added;
+    harness.removed = burst_removed;
+    for (i = 0; i < opt_bursts; i++)
+    {
+        gint64 t;
+        gdouble rate;
+
+        t = harness_change (&harness, i * opt_burst_size, opt_burst_size, TRUE, &error);
+        if (t < 0 && error != NULL)
+            goto out_hist;
+        if (t > 0)
+        {
+            rate = opt_burst_size * 1e9 / t;
+            g_array_append_val (throughput, rate);
+        }
+        t = harness_change (&harness, i * opt_burst_size, opt_burst_size, FALSE, &error);
+        if (t < 0 && error != NULL)
+            goto out_hist;
+        if (t > 0)
+        {
+            rate = opt_burst_size * 1e9 / t;
+            g_array_append_val (throughput, rate);
+        }
+    }
+
+    printf ("%d devices, %d single round trips, %d bursts of %d\n",
+            opt_devices, opt_iterations, opt_bursts, opt_burst_size);
+    if (opt_iterations > 0)
+        printf ("single: %.0f changes/s\n", 2 * opt_iterations * 1e9 / elapsed);
+    if (throughput->len > 0)
+    {
+        gdouble sum = 0, min = G_MAXDOUBLE, max = 0;
+        guint n;
+
+        for (n = 0; n < throughput->len; n++)
+        {
+            gdouble v = g_array_index (throughput, gdouble, n);
+
+            sum += v;
+            min = MIN (min, v);
+            max = MAX (max, v);
+        }
+        printf ("burst: %.0f signals/s mean, %.0f min, %.0f max\n", sum / throughput->len, min, max);
+    }
+    histogram_print (single_added);
+    histogram_print (single_removed);
+    histogram_print (burst_added);
+    histogram_print (burst_removed);
+    printf ("\n%" G_GUINT64_FORMAT " signals lost, %" G_GUINT64_FORMAT " unexpected\n",
+            harness.lost, harness.unexpected);
+    ret = harness.lost == 0 ? 0 : 1;
+
+out_hist:
+    histogram_free (single_added);
+    histogram_free (single_removed);
+    histogram_free (burst_added);
+    histogram_free (burst_removed);
+    g_array_free (throughput, TRUE);
+out:
+    if (error != NULL)
+    {
+        printf ("latency-client: %s\n", error->message);
+        g_error_free (error);
+    }
+    if (harness.connection != NULL)
+        g_object_unref (harness.connection);
+    if (harness.contents != NULL)
+        g_string_free (harness.contents, TRUE);
+    g_free (harness.mounted);
+    g_free (harness.expect_added);
+    g_free (harness.written_at);
+    g_free (harness.base);
+
+    return ret;
+}
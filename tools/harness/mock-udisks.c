@@ -0,0 +1,159 @@
+/* Stand-in for udisksd: exports N drives with one block device each
+ * through an org.freedesktop.UDisks2 object manager, enough for the
+ * monitor's device index to resolve the harness's fake mounts.
+ */
+#include <stdio.h>
+#include <signal.h>
+#include <glib-unix.h>
+#include <udisks/udisks.h>
+#include "harness.h"
+
+static gint opt_devices = 64;
+static gchar *opt_ready_file = NULL;
+
+static GOptionEntry entries[] =
+{
+    { "devices", 'n', 0, G_OPTION_ARG_INT, &opt_devices,
+      "Drives and blocks to export (default 64)", "N" },
+    { "ready-file", 0, 0, G_OPTION_ARG_FILENAME, &opt_ready_file,
+      "Create FILE once the bus name is owned", "FILE" },
+    { NULL }
+};
+
+static void
+export_device (GDBusObjectManagerServer *manager,
+               guint                     n)
+{
+    UDisksObjectSkeleton *object;
+    UDisksDrive *drive;
+    UDisksBlock *block;
+    gchar *drive_path;
+    gchar *block_path;
+    gchar *str;
+
+    drive_path = g_strdup_printf ("/org/freedesktop/UDisks2/drives/harness%u", n);
+    object = udisks_object_skeleton_new (drive_path);
+    drive = udisks_drive_skeleton_new ();
+    str = g_strdup_printf ("HARNESS%08u", n);
+    udisks_drive_set_serial (drive, str);
+    g_free (str);
+    udisks_drive_set_vendor (drive, "Harness");
+    udisks_drive_set_model (drive, "Fake Disk");
+    udisks_object_skeleton_set_drive (object, drive);
+    g_dbus_object_manager_server_export (manager, G_DBUS_OBJECT_SKELETON (object));
+    g_object_unref (drive);
+    g_object_unref (object);
+
+    block_path = g_strdup_printf ("/org/freedesktop/UDisks2/block_devices/harness%u", n);
+    object = udisks_object_skeleton_new (block_path);
+    block = udisks_block_skeleton_new ();
+    str = g_strdup_printf ("/dev/harness%u", n);
+    udisks_block_set_device (block, str);
+    udisks_block_set_preferred_device (block, str);
+    g_free (str);
+    udisks_block_set_device_number (block, makedev (HARNESS_DEV_MAJOR, n));
+    str = harness_uuid (n);
+    udisks_block_set_id_uuid (block, str);
+    g_free (str);
+    udisks_block_set_id_type (block, "ext4");
+    udisks_block_set_id_usage (block, "filesystem");
+    udisks_block_set_drive (block, drive_path);
+    udisks_object_skeleton_set_block (object, block);
+    g_dbus_object_manager_server_export (manager, G_DBUS_OBJECT_SKELETON (object));
+    g_object_unref (block);
+    g_object_unref (object);
+
+    g_free (block_path);
+    g_free (drive_path);
+}
+
+static void
+on_name_acquired (GDBusConnection *connection,
+                  const gchar     *name,
+                  gpointer         user_data)
+{
+    GError *error = NULL;
+
+    printf ("mock-udisks: exporting %d devices as %s\n", opt_devices, name);
+    if (opt_ready_file != NULL && !g_file_set_contents (opt_ready_file, "", 0, &error))
+    {
+        printf ("mock-udisks: %s\n", error->message);
+        g_error_free (error);
+    }
+}
+
+static void
+on_name_lost (GDBusConnection *connection,
+              const gchar     *name,
+              gpointer         user_data)
+{
+    printf ("mock-udisks: can't own %s\n", name);
+    g_main_loop_quit (user_data);
+}
+
+static gboolean
+on_sigterm (gpointer user_data)
+{
+    g_main_loop_quit (user_data);
+    return G_SOURCE_REMOVE;
+}
+
+int
+main (int argc, char **argv)
+{
+    GOptionContext *context;
+    GError *error = NULL;
+    GMainLoop *loop;
+    GDBusConnection *connection;
+    GDBusObjectManagerServer *manager;
+    UDisksObjectSkeleton *object;
+    UDisksManager *udisks_manager;
+    guint owner_id;
+    gint n;
+
+    context = g_option_context_new ("- export fake drives as org.freedesktop.UDisks2");
+    g_option_context_add_main_entries (context, entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+        printf ("%s\n", error->message);
+        return 1;
+    }
+    g_option_context_free (context);
+
+    /* the harness points the system bus at its private bus */
+    connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+    if (connection == NULL)
+    {
+        printf ("mock-udisks: %s\n", error->message);
+        return 1;
+    }
+
+    manager = g_dbus_object_manager_server_new ("/org/freedesktop/UDisks2");
+
+    object = udisks_object_skeleton_new ("/org/freedesktop/UDisks2/Manager");
+    udisks_manager = udisks_manager_skeleton_new ();
+    udisks_manager_set_version (udisks_manager, "2.0.0-harness");
+    udisks_object_skeleton_set_manager (object, udisks_manager);
+    g_dbus_object_manager_server_export (manager, G_DBUS_OBJECT_SKELETON (object));
+    g_object_unref (udisks_manager);
+    g_object_unref (object);
+
+    for (n = 0; n < opt_devices; n++)
+        export_device (manager, n);
+    g_dbus_object_manager_server_set_connection (manager, connection);
+
+    loop = g_main_loop_new (NULL, FALSE);
+    owner_id = g_bus_own_name_on_connection (connection, "org.freedesktop.UDisks2",
+                                             G_BUS_NAME_OWNER_FLAGS_NONE,
+                                             on_name_acquired, on_name_lost, loop, NULL);
+    g_unix_signal_add (SIGTERM, on_sigterm, loop);
+    g_unix_signal_add (SIGINT, on_sigterm, loop);
+    g_main_loop_run (loop);
+
+    g_bus_unown_name (owner_id);
+    g_object_unref (manager);
+    g_object_unref (connection);
+    g_main_loop_unref (loop);
+
+    return 0;
+}
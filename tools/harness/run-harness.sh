@@ -0,0 +1,54 @@
+#! /bin/sh
+# End-to-end latency harness.  Starts a private dbus-daemon standing in for
+# both the session and the system bus, mock-udisks with HARNESS_DEVICES fake
+# drives on it, and mountmonitor reading a mountinfo file under our control;
+# then latency-client churns that file and reports how long the signals
+# take.  No real disks, udisksd or system bus are needed.
+#
+# Extra arguments are passed to latency-client, e.g. --iterations=1000.
+
+srcdir=$(dirname "$0")
+builddir=${HARNESS_BUILDDIR:-.}
+monitor=${MOUNTMONITOR:-$builddir/../../src/mountmonitor}
+devices=${HARNESS_DEVICES:-64}
+
+tmp=$(mktemp -d) || exit 1
+bus_pid=
+mock_pid=
+monitor_pid=
+
+cleanup ()
+{
+    [ -n "$monitor_pid" ] && kill "$monitor_pid" 2>/dev/null
+    [ -n "$mock_pid" ] && kill "$mock_pid" 2>/dev/null
+    [ -n "$bus_pid" ] && kill "$bus_pid" 2>/dev/null
+    rm -rf "$tmp"
+}
+trap cleanup EXIT
+trap 'exit 1' INT TERM
+
+dbus-daemon --config-file="$srcdir/harness-bus.conf" --fork \
+    --print-address=3 --print-pid=4 3>"$tmp/address" 4>"$tmp/pid" || exit 1
+bus_pid=$(cat "$tmp/pid")
+DBUS_SESSION_BUS_ADDRESS=$(head -n 1 "$tmp/address")
+DBUS_SYSTEM_BUS_ADDRESS=$DBUS_SESSION_BUS_ADDRESS
+export DBUS_SESSION_BUS_ADDRESS DBUS_SYSTEM_BUS_ADDRESS
+
+"$builddir/mock-udisks" --devices="$devices" --ready-file="$tmp/udisks-ready" &
+mock_pid=$!
+tries=0
+while [ ! -e "$tmp/udisks-ready" ]; do
+    tries=$((tries + 1))
+    if [ $tries -gt 100 ]; then
+        echo "mock-udisks didn't come up" >&2
+        exit 1
+    fi
+    sleep 0.1
+done
+
+# something that is never announced, like the root filesystem
+echo "1 0 253:0 / / rw,relatime shared:1 - ext4 /dev/root rw" > "$tmp/mountinfo"
+"$monitor" --backend=mountinfo --signals=per-mount --mountinfo="$tmp/mountinfo" &
+monitor_pid=$!
+
+"$builddir/latency-client" --mountinfo="$tmp/mountinfo" --devices="$devices" "$@"
@@ -1,19 +1,59 @@
 #! /usr/bin/python
 
+import sys
 import dbus
 import gobject
 import dbus.mainloop.glib
 
-def MountAdded(serial, vendor, model, uuid):
-    print("MountAdded serial:%s vendor:%s model:%s uuid:%s" % (serial, vendor, model, uuid))
+def MountAdded(serial, vendor, model, uuid, ns_id, generation):
+    print("[%d] MountAdded ns:%d serial:%s vendor:%s model:%s uuid:%s" % (generation, ns_id, serial, vendor, model, uuid))
 
-def MountRemoved(serial, vendor, model, uuid):
-    print("MountRemoved serial:%s vendor:%s model:%s uuid:%s" % (serial, vendor, model, uuid))
+def MountRemoved(serial, vendor, model, uuid, ns_id, generation):
+    print("[%d] MountRemoved ns:%d serial:%s vendor:%s model:%s uuid:%s" % (generation, ns_id, serial, vendor, model, uuid))
+
+def SwapAdded(serial, vendor, model, uuid, filename, generation):
+    print("[%d] SwapAdded %s serial:%s vendor:%s model:%s uuid:%s" % (generation, filename, serial, vendor, model, uuid))
+
+def SwapRemoved(serial, vendor, model, uuid, filename, generation):
+    print("[%d] SwapRemoved %s serial:%s vendor:%s model:%s uuid:%s" % (generation, filename, serial, vendor, model, uuid))
+
+def MountsChanged(ns_id, generation, added, removed):
+    for (serial, vendor, model, uuid) in added:
+        MountAdded(serial, vendor, model, uuid, ns_id, generation)
+    for (serial, vendor, model, uuid) in removed:
+        MountRemoved(serial, vendor, model, uuid, ns_id, generation)
+
+def MountEvent(subscription, generation, added, ns_id, path, dev, type, serial, vendor, model, uuid, fstype):
+    print("[%d] %s %s ns:%d path:%s dev:%d:%d fstype:%s serial:%s vendor:%s model:%s uuid:%s" %
+          (generation, "Added" if added else "Removed", type, ns_id, path,
+           dev >> 8 & 0xfff, (dev & 0xff) | (dev >> 12 & ~0xff), fstype, serial, vendor, model, uuid))
+
+batched = "--batched" in sys.argv
+# --path=PREFIX, --fstype=TYPE, --uuid=UUID: only receive matching changes, as MountEvent
+filter = {}
+for arg in sys.argv[1:]:
+    for key in ("path", "fstype", "uuid"):
+        if arg.startswith("--%s=" % key):
+            filter["path-prefix" if key == "path" else key] = dbus.String(arg.split("=", 1)[1])
+pids = [int(arg) for arg in sys.argv[1:] if arg.isdigit()]
 
 dbus.mainloop.glib.DBusGMainLoop(set_as_default=True)
 bus = dbus.SessionBus()
 obj = bus.get_object("org.freedesktop.MountMonitor", "/org/freedesktop/MountMonitor")
 interface = dbus.Interface(obj, "org.freedesktop.MountMonitor.Base")
-interface.connect_to_signal("MountAdded", MountAdded)
-interface.connect_to_signal("MountRemoved", MountRemoved)
+for pid in pids:
+    print("Watching namespace %d of pid %d" % (interface.WatchNamespace(dbus.UInt32(pid)), pid))
+if filter:
+    bus.add_signal_receiver(MountEvent, "MountEvent", "org.freedesktop.MountMonitor.Base",
+                            path="/org/freedesktop/MountMonitor")
+    print("Subscription %d" % interface.Subscribe(dbus.Dictionary(filter, signature="sv")))
+    gobject.MainLoop().run()
+    sys.exit(0)
+if batched:
+    interface.connect_to_signal("MountsChanged", MountsChanged)
+else:
+    interface.connect_to_signal("MountAdded", MountAdded)
+    interface.connect_to_signal("MountRemoved", MountRemoved)
+interface.connect_to_signal("SwapAdded", SwapAdded)
+interface.connect_to_signal("SwapRemoved", SwapRemoved)
 gobject.MainLoop().run()